@@ -0,0 +1,391 @@
+#include "modconv.hpp"
+#include "generator.hpp"
+#include "common.hpp"
+#include "MOD.hpp"
+#include "util/mapped_file.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Results nothing else reads end up here so the optimiser can't drop the work that produced them
+volatile u64 gSink = 0;
+
+struct BenchOptions {
+	double mMinSeconds = 0.25; // Every benchmark repeats until it has run for at least this long
+	generator::Settings mSynthetic;
+	std::string mFilter;       // Only run benchmarks whose name contains this
+};
+
+BenchOptions gOptions;
+
+/**
+ * @brief Times a benchmark and prints its throughput.
+ * @param input The name of the input the benchmark runs on.
+ * @param name The name of the benchmark.
+ * @param bytes The bytes processed by one iteration, 0 to leave out MB/s.
+ * @param elements The elements processed by one iteration, 0 to leave out elements/s.
+ * @param setup Prepares an iteration, not timed.
+ * @param run The code being measured.
+ */
+void measure(const std::string& input, const std::string& name, std::size_t bytes, std::size_t elements, const std::function<void()>& setup,
+             const std::function<void()>& run)
+{
+	if (!gOptions.mFilter.empty() && name.find(gOptions.mFilter) == std::string::npos) {
+		return;
+	}
+
+	double total   = 0;
+	double best    = INFINITY;
+	u32 iterations = 0;
+	while (total < gOptions.mMinSeconds || iterations < 3) {
+		setup();
+
+		const Clock::time_point start = Clock::now();
+		run();
+		const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		total += elapsed;
+		best = std::min(best, elapsed);
+		iterations++;
+	}
+
+	const double mean = total / iterations;
+	std::cout << std::left << std::setw(20) << input.substr(0, 19) << std::setw(40) << name.substr(0, 39) << std::right << std::setw(8)
+	          << iterations << std::fixed << std::setprecision(1) << std::setw(12) << mean * 1e6 << std::setw(12) << best * 1e6;
+
+	if (bytes != 0) {
+		std::cout << std::setw(12) << std::setprecision(1) << (bytes / mean) / (1024.0 * 1024.0);
+	} else {
+		std::cout << std::setw(12) << "-";
+	}
+
+	if (elements != 0) {
+		std::cout << std::setw(16) << std::setprecision(0) << elements / mean;
+	} else {
+		std::cout << std::setw(16) << "-";
+	}
+
+	std::cout << std::defaultfloat << std::endl;
+}
+
+void measure(const std::string& input, const std::string& name, std::size_t bytes, std::size_t elements, const std::function<void()>& run)
+{
+	measure(input, name, bytes, elements, []() { }, run);
+}
+
+// A library call that fails would otherwise be timed as a fast no-op, so it stops the model's benchmarks instead
+void check(const modconv::Status& status, const std::string& operation)
+{
+	if (!status) {
+		throw std::runtime_error(operation + " failed: " + status.mMessage);
+	}
+}
+
+std::size_t fileSize(const fs::path& path)
+{
+	std::error_code ec;
+	const std::uintmax_t size = fs::file_size(path, ec);
+	return ec ? 0 : static_cast<std::size_t>(size);
+}
+
+// Runs every benchmark on one model
+void benchModel(const std::string& input, const std::vector<u8>& data)
+{
+	using EChunkType = MOD::EChunkType;
+
+	const fs::path scratch = fs::temp_directory_path() / "modconv_bench";
+	fs::create_directories(scratch);
+
+	// MOD::read only indexes the chunks, decoding them is measured separately
+	{
+		MOD mod;
+		measure(input, "MOD::read", data.size(), 0, [&]() { mod.reset(); }, [&]() {
+			util::span_reader reader(data);
+			mod.read(reader);
+		});
+
+		// How loading from a file mapping works, the chunks point straight into it
+		measure(input, "MOD::read (borrowed)", data.size(), 0, [&]() { mod.reset(); }, [&]() { mod.read(data, nullptr); });
+
+		measure(input, "MOD::read + decodeAll", data.size(), 0, [&]() { mod.reset(); }, [&]() {
+			util::span_reader reader(data);
+			mod.read(reader);
+			mod.decodeAll();
+		});
+	}
+
+	MOD model;
+	util::span_reader modelReader(data);
+	model.read(modelReader);
+
+	// Decoding a chunk type is where readGenericChunk and the other chunk readers run
+	for (const MOD::ChunkEntry& entry : model.mChunkDirectory) {
+		const auto chunkType = static_cast<EChunkType>(entry.mOpcode);
+		const auto chunkName = MOD::getChunkName(entry.mOpcode);
+		if (chunkType == EChunkType::Header || chunkType == EChunkType::EndOfFile || !chunkName.has_value()) {
+			continue;
+		}
+
+		MOD probe;
+		util::span_reader probeReader(data);
+		probe.read(probeReader);
+		probe.decode(chunkType);
+
+		MOD mod;
+		measure(input, "decode " + std::string(chunkName.value()), entry.mLength, probe.getElementCount(chunkType),
+		        [&]() {
+			        mod.reset();
+			        util::span_reader reader(data);
+			        mod.read(reader);
+		        },
+		        [&]() { mod.decode(chunkType); });
+	}
+
+	model.decodeAll();
+
+	{
+		std::vector<u8> output;
+		measure(input, "MOD::write", data.size(), 0, [&]() {
+			util::vector_writer writer;
+			model.write(writer);
+			output = writer.takeBuffer();
+		});
+	}
+
+	// Display lists of every mesh, parsed the same way export_obj does
+	{
+		std::size_t bytes     = 0;
+		std::size_t triangles = 0;
+		for (const Mesh& mesh : model.mMeshes) {
+			for (const MeshPacket& packet : mesh.mPackets) {
+				for (const DisplayList& dlist : packet.mDisplayLists) {
+					util::span_reader reader(dlist.mData);
+					DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
+					dlReader.parse();
+					bytes += dlist.mData.size();
+					triangles += dlReader.getStats().mTotalTriangles;
+				}
+			}
+		}
+
+		if (bytes != 0) {
+			std::vector<std::vector<FaceBatch>> parsed;
+			auto parseAll = [&]() {
+				parsed.clear();
+				for (const Mesh& mesh : model.mMeshes) {
+					for (const MeshPacket& packet : mesh.mPackets) {
+						for (const DisplayList& dlist : packet.mDisplayLists) {
+							util::span_reader reader(dlist.mData);
+							DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
+							parsed.push_back(dlReader.parse());
+						}
+					}
+				}
+			};
+
+			// convertToIndexed needs the batches even when --filter skips the parse benchmark
+			parseAll();
+			measure(input, "DisplayListReader::parse", bytes, triangles, parseAll);
+
+			measure(input, "DListUtils::convertToIndexed", 0, triangles, [&]() {
+				for (const std::vector<FaceBatch>& batches : parsed) {
+					DListUtils::convertToIndexed(batches);
+				}
+			});
+
+			// The streaming path export_obj takes, every triangle is handed out without building batches
+			auto forEachReader = [&](const auto& visit) {
+				for (const Mesh& mesh : model.mMeshes) {
+					for (const MeshPacket& packet : mesh.mPackets) {
+						for (const DisplayList& dlist : packet.mDisplayLists) {
+							util::span_reader reader(dlist.mData);
+							DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
+							visit(dlReader);
+						}
+					}
+				}
+			};
+
+			measure(input, "DisplayListReader::forEachTriangle", bytes, triangles, [&]() {
+				u64 checksum = 0;
+				forEachReader([&](DisplayListReader& dlReader) {
+					dlReader.forEachTriangle([&](const Triangle& tri) { checksum += tri[0].mPosition + tri[2].mPosition; });
+				});
+				gSink = checksum;
+			});
+
+			measure(input, "DListUtils::convertToIndexed (streamed)", bytes, triangles, [&]() {
+				forEachReader([&](DisplayListReader& dlReader) { DListUtils::convertToIndexed(dlReader); });
+			});
+		}
+	}
+
+	// The text formats go through real files, as they do from the command line
+	if (!model.mMaterials.mMaterials.empty()) {
+		const std::string path = (scratch / "materials.json").string();
+		mat::saveMaterialsToFile(path, model.mMaterials.mMaterials, model.mMaterials.mTevEnvironmentInfo);
+		const std::size_t bytes    = fileSize(path);
+		const std::size_t elements = model.mMaterials.mMaterials.size();
+
+		measure(input, "mat::saveMaterialsToFile", bytes, elements,
+		        [&]() { mat::saveMaterialsToFile(path, model.mMaterials.mMaterials, model.mMaterials.mTevEnvironmentInfo); });
+
+		MaterialContainer materials;
+		measure(input, "mat::loadMaterialsFromFile", bytes, elements,
+		        [&]() { mat::loadMaterialsFromFile(path, materials.mMaterials, materials.mTevEnvironmentInfo); });
+	}
+
+	if (!model.mCollisionTriangles.mCollInfo.empty() || !model.mCollisionGridInfo.mGroups.empty()) {
+		const std::string path = (scratch / "collision.json").string();
+		collision::saveCollisionToFile(path, model.mCollisionTriangles, model.mCollisionGridInfo);
+		const std::size_t bytes    = fileSize(path);
+		const std::size_t elements = model.mCollisionTriangles.mCollInfo.size();
+
+		measure(input, "collision::saveCollisionToFile", bytes, elements,
+		        [&]() { collision::saveCollisionToFile(path, model.mCollisionTriangles, model.mCollisionGridInfo); });
+
+		CollTriInfo triangles;
+		CollGrid grid;
+		measure(input, "collision::loadCollisionFromFile", bytes, elements,
+		        [&]() { collision::loadCollisionFromFile(path, triangles, grid); });
+	}
+
+	// OBJ conversion through the library, on a fresh session every time as importObj replaces the geometry
+	if (!model.mVertices.empty()) {
+		const std::string path = (scratch / "model.obj").string();
+
+		modconv::Session session;
+		session.mModFile.mVerbosePrint = false;
+		const auto reload              = [&]() { check(modconv::loadFromMemory(session, data, input), "loadFromMemory"); };
+
+		reload();
+		check(modconv::exportObj(session, path), "exportObj");
+		const std::size_t bytes    = fileSize(path);
+		const std::size_t elements = model.mVertices.size();
+
+		measure(input, "exportObj", bytes, elements, reload, [&]() { check(modconv::exportObj(session, path), "exportObj"); });
+		measure(input, "importObj", bytes, elements, reload, [&]() { check(modconv::importObj(session, path), "importObj"); });
+
+		const std::string dmdPath = (scratch / "model.dmd").string();
+		reload();
+		check(modconv::exportDmd(session, dmdPath), "exportDmd");
+		measure(input, "exportDmd", fileSize(dmdPath), elements, reload,
+		        [&]() { check(modconv::exportDmd(session, dmdPath), "exportDmd"); });
+	}
+
+	std::error_code ec;
+	fs::remove_all(scratch, ec);
+}
+
+void printUsage(const char* programName)
+{
+	std::cout << "Usage: " << fs::path(programName).filename().string() << " [options] [setting=value...] [corpus directory]\n\n";
+	std::cout << "Runs the benchmarks on a synthetic model and on every .mod file in the corpus directory (default unit/).\n";
+	std::cout << "The synthetic model takes the same settings as the generate command, e.g. vertices=60000 collision=100000.\n\n";
+	std::cout << "Options:\n";
+	std::cout << "  --help, -h           Show this help message\n";
+	std::cout << "  --min-time <s>       Minimum time spent on each benchmark (default 0.25)\n";
+	std::cout << "  --filter <text>      Only run benchmarks whose name contains the text\n";
+	std::cout << "  --no-synthetic       Skip the synthetic model\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	std::string corpus = "unit";
+	bool synthetic     = true;
+	bool failed        = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+
+		try {
+			if (arg == "--help" || arg == "-h") {
+				printUsage(argv[0]);
+				return EXIT_SUCCESS;
+			} else if ((arg == "--min-time" || arg == "--filter") && i + 1 >= argc) {
+				std::cerr << "Missing value after " << arg << std::endl;
+				return EXIT_FAILURE;
+			} else if (arg == "--min-time") {
+				gOptions.mMinSeconds = std::stod(argv[++i]);
+			} else if (arg == "--filter") {
+				gOptions.mFilter = argv[++i];
+			} else if (arg == "--no-synthetic") {
+				synthetic = false;
+			} else if (arg.starts_with("-")) {
+				std::cerr << "Unknown option: " << arg << std::endl;
+				return EXIT_FAILURE;
+			} else if (const std::size_t equals = arg.find('='); equals != std::string::npos) {
+				if (!gOptions.mSynthetic.set(arg.substr(0, equals), static_cast<u32>(std::stoul(arg.substr(equals + 1))))) {
+					std::cerr << "Unknown setting: " << arg.substr(0, equals) << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else {
+				corpus = arg;
+			}
+		} catch (...) {
+			std::cerr << "Invalid value: " << argv[i] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The default corpus is optional, one that was asked for has to exist
+	std::vector<fs::path> corpusFiles;
+	std::error_code ec;
+	if (fs::is_directory(corpus, ec)) {
+		for (const auto& dentry : fs::recursive_directory_iterator(corpus)) {
+			if (dentry.is_regular_file() && dentry.path().extension() == ".mod") {
+				corpusFiles.push_back(dentry.path());
+			}
+		}
+	} else if (corpus != "unit") {
+		std::cerr << corpus << " isn't a directory" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::sort(corpusFiles.begin(), corpusFiles.end());
+
+	std::cout << std::left << std::setw(20) << "Input" << std::setw(40) << "Benchmark" << std::right << std::setw(8) << "Iters"
+	          << std::setw(12) << "Mean us" << std::setw(12) << "Best us" << std::setw(12) << "MB/s" << std::setw(16) << "Elements/s"
+	          << std::endl;
+
+	try {
+		if (synthetic) {
+			MOD model;
+			generator::generate(model, gOptions.mSynthetic);
+
+			util::vector_writer writer;
+			model.write(writer);
+			benchModel("synthetic", writer.takeBuffer());
+		}
+
+		// A broken file is reported and skipped, the rest of the corpus still gets measured
+		for (const fs::path& path : corpusFiles) {
+			try {
+				util::mapped_file file(path);
+				const std::span<const u8> bytes = file.data();
+				benchModel(path.filename().string(), std::vector<u8>(bytes.begin(), bytes.end()));
+			} catch (const std::exception& e) {
+				std::cerr << "Skipped " << path.string() << ": " << e.what() << std::endl;
+				failed = true;
+			}
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,334 +1,663 @@
 #include "MOD.hpp"
+#include "util/parallel_for.hpp"
+#include "util/alloc_stats.hpp"
+#include "util/profiler.hpp"
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace {
-inline void writeGenericChunk(util::fstream_writer& writer, auto& vector, u32 chunkIdentifier, bool verbose = true)
+// Element types whose in-memory layout matches the file layout word for word, so whole chunks can
+// be copied in one go and byteswapped in place. Anything else is (de)serialized element by element
+template <typename T>
+constexpr std::size_t gBulkWordSize = 0;
+template <>
+constexpr std::size_t gBulkWordSize<Vector3f> = sizeof(f32);
+template <>
+constexpr std::size_t gBulkWordSize<Vector2f> = sizeof(f32);
+template <>
+constexpr std::size_t gBulkWordSize<NBT> = sizeof(f32);
+template <>
+constexpr std::size_t gBulkWordSize<ColourU8> = sizeof(u8);
+
+static_assert(sizeof(Vector3f) == 12 && std::is_trivially_copyable_v<Vector3f>);
+static_assert(sizeof(Vector2f) == 8 && std::is_trivially_copyable_v<Vector2f>);
+static_assert(sizeof(NBT) == 36 && std::is_trivially_copyable_v<NBT>);
+static_assert(sizeof(ColourU8) == 4 && std::is_trivially_copyable_v<ColourU8>);
+
+template <typename T>
+inline void writeElements(util::vector_writer& writer, std::vector<T>& vector)
 {
-	if (verbose) {
-		std::cout << "Writing 0x" << std::hex << chunkIdentifier << std::dec << " at offset 0x" << std::hex << std::uppercase
-		          << writer.tellp() << std::nouppercase << std::dec << ", " << MOD::getChunkName(chunkIdentifier).value() << '\n';
+	if constexpr (gBulkWordSize<T> == sizeof(f32)) {
+		writer.write_array32(vector.data(), vector.size() * sizeof(T) / sizeof(f32));
+	} else if constexpr (gBulkWordSize<T> == sizeof(u8)) {
+		writer.write_buffer(vector.data(), vector.size() * sizeof(T));
+	} else {
+		for (auto& contents : vector) {
+			contents.write(writer);
+		}
 	}
+}
+
+template <typename T>
+inline void readElements(util::span_reader& reader, std::vector<T>& vector, u32 count)
+{
+	if constexpr (gBulkWordSize<T> != 0) {
+		// Make sure the whole payload is there before allocating for it
+		const std::size_t size = static_cast<std::size_t>(count) * sizeof(T);
+		if (size > reader.getRemaining()) {
+			throw std::out_of_range("Chunk claims " + std::to_string(count) + " elements but only "
+			                        + std::to_string(reader.getRemaining()) + " bytes are left");
+		}
 
+		vector.resize(count);
+		if constexpr (gBulkWordSize<T> == sizeof(f32)) {
+			reader.read_array32(vector.data(), size / sizeof(f32));
+		} else {
+			reader.read_buffer(vector.data(), size);
+		}
+	} else {
+		vector.resize(count);
+		for (auto& elem : vector) {
+			elem.read(reader);
+		}
+	}
+}
+
+inline void writeGenericChunk(util::vector_writer& writer, auto& vector, u32 chunkIdentifier)
+{
 	const u32 subchunkPos = startChunk(writer, chunkIdentifier);
 	writer.writeU32(static_cast<u32>(vector.size()));
 
 	writer.align();
-
-	for (auto& contents : vector) {
-		contents.write(writer);
-	}
+	writeElements(writer, vector);
 
 	finishChunk(writer, subchunkPos);
 }
 
-inline void writeGenericChunk(util::fstream_writer& writer, auto& vector, MOD::EChunkType chunkIdentifier, bool verbose = true)
+inline void writeGenericChunk(util::vector_writer& writer, auto& vector, MOD::EChunkType chunkIdentifier)
 {
-	writeGenericChunk(writer, vector, static_cast<u32>(chunkIdentifier), verbose);
+	writeGenericChunk(writer, vector, static_cast<u32>(chunkIdentifier));
 }
 
-inline void readGenericChunk(util::fstream_reader& reader, auto& vector)
+inline void readGenericChunk(util::span_reader& reader, auto& vector)
 {
-	vector.resize(reader.readU32());
+	const u32 count = reader.readU32();
 
 	reader.align();
-	for (auto& elem : vector) {
-		elem.read(reader);
-	}
+	readElements(reader, vector, count);
 	reader.align();
 }
+
+// One chunk of the output file, encoded on its own so that chunks can be built concurrently
+struct ChunkTask {
+	u32 mOpcode                      = 0;
+	const MOD::ChunkEntry* mRawEntry = nullptr; // Set when the chunk is passed through untouched from the source bytes
+	std::function<void(util::vector_writer&)> mEncode;
+	std::vector<u8> mOutput;
+};
+
+// How a chunk shows up in the --profile report, e.g. "0x30 Materials"
+std::string profileName(u32 opcode)
+{
+	std::ostringstream name;
+	name << "0x" << std::hex << std::uppercase << opcode << ' ' << MOD::getChunkName(opcode).value_or("Unknown chunk");
+	return name.str();
+}
 } // namespace
 
 void MOD::read(util::fstream_reader& reader)
 {
-	bool stopRead = false;
-	while (!stopRead) {
-		std::streampos position = reader.tellg();
-		const u32 opcode        = reader.readU32();
-		const u32 length        = reader.readU32();
+	util::profiler::scope profile("phase", "read");
+
+	// Pipes can't be sized up front, so pull the stream in block by block
+	auto buffer = std::make_shared<std::vector<u8>>();
+	std::array<char, 0x10000> block {};
+	while (reader.read(block.data(), block.size()) || reader.gcount() > 0) {
+		buffer->insert(buffer->end(), block.begin(), block.begin() + reader.gcount());
+	}
+
+	mSourceData  = *buffer;
+	mSourceOwner = std::move(buffer);
+	mSourceSize  = mSourceData.size();
+	indexChunks();
+
+	profile.setBytes(mSourceData.size());
+	profile.setElements(mChunkDirectory.size());
+}
+
+void MOD::read(util::span_reader& reader)
+{
+	const std::span<const u8> bytes = reader.readSpan(reader.getRemaining());
+	auto copy                       = std::make_shared<const std::vector<u8>>(bytes.begin(), bytes.end());
+	read(*copy, copy);
+}
+
+void MOD::read(std::span<const u8> bytes, std::shared_ptr<const void> owner)
+{
+	util::profiler::scope profile("phase", "read");
+
+	mSourceData  = bytes;
+	mSourceOwner = std::move(owner);
+	mSourceSize  = bytes.size();
+	indexChunks();
+
+	profile.setBytes(mSourceData.size());
+	profile.setElements(mChunkDirectory.size());
+}
+
+void MOD::detachSource()
+{
+	releaseSourceData();
+	if (!mSourceData.empty()) {
+		auto copy    = std::make_shared<const std::vector<u8>>(mSourceData.begin(), mSourceData.end());
+		mSourceData  = *copy;
+		mSourceOwner = std::move(copy);
+	}
+}
+
+void MOD::indexChunks()
+{
+	mChunkDirectory.clear();
+
+	util::span_reader reader(mSourceData);
+	while (reader.getRemaining() != 0) {
+		const std::size_t position = reader.getPosition();
+		const u32 opcode           = reader.readU32();
+		const u32 length           = reader.readU32();
 
 		if (position & 0x1F) {
-			std::cout << "Error in chunk " << opcode << ", offset " << position
-			          << ", chunk start isn't aligned to 0x20, this means an "
-			             "improper read occured."
-			          << '\n';
+			*mLog << "Error in chunk " << opcode << ", offset " << position
+			      << ", chunk start isn't aligned to 0x20, this means an "
+			         "improper read occured."
+			      << '\n';
 			return;
 		}
 
-		if (mVerbosePrint) {
-			const auto ocString = getChunkName(opcode);
-			std::cout << "Reading 0x" << std::hex << opcode << std::dec << ", "
-			          << (ocString.has_value() ? ocString.value() : "Unknown chunk") << '\n';
+		if (length > reader.getRemaining()) {
+			throw std::out_of_range("Chunk " + std::to_string(opcode) + " at offset " + std::to_string(position) + " claims "
+			                        + std::to_string(length) + " bytes, only " + std::to_string(reader.getRemaining()) + " remain");
 		}
 
+		ChunkEntry& entry = mChunkDirectory.emplace_back();
+		entry.mOpcode     = opcode;
+		entry.mOffset     = static_cast<u32>(position);
+		entry.mLength     = length;
+
 		switch (static_cast<EChunkType>(opcode)) {
 		case EChunkType::Header:
-			reader.align();
-			mHeader.mDateTime.mYear  = reader.readU16();
-			mHeader.mDateTime.mMonth = reader.readU8();
-			mHeader.mDateTime.mDay   = reader.readU8();
-			mHeader.mFlags           = reader.readU32();
-			reader.align();
-			break;
-		case EChunkType::Vertex:
-			readGenericChunk(reader, mVertices);
-			if (mVertices.empty()) {
-				mEmptyChunks.insert(EChunkType::Vertex);
-			}
-			break;
-		case EChunkType::VertexNormal:
-			readGenericChunk(reader, mVertexNormals);
-			if (mVertexNormals.empty()) {
-				mEmptyChunks.insert(EChunkType::VertexNormal);
-			}
-			break;
-		case EChunkType::VertexNBT:
-			readGenericChunk(reader, mVertexNbt);
-			if (mVertexNbt.empty()) {
-				mEmptyChunks.insert(EChunkType::VertexNBT);
-			}
-			break;
-		case EChunkType::VertexColour:
-			readGenericChunk(reader, mVertexColours);
-			if (mVertexColours.empty()) {
-				mEmptyChunks.insert(EChunkType::VertexColour);
+			// Tiny and needed by nearly every command, so never deferred
+			if (mVerbosePrint) {
+				*mLog << "Reading 0x" << std::hex << opcode << std::dec << ", " << getChunkName(opcode).value() << '\n';
 			}
+
+			decodeChunk(entry);
+			reader.skip(length);
 			break;
-		case EChunkType::TexCoord0:
-		case EChunkType::TexCoord1:
-		case EChunkType::TexCoord2:
-		case EChunkType::TexCoord3:
-		case EChunkType::TexCoord4:
-		case EChunkType::TexCoord5:
-		case EChunkType::TexCoord6:
-		case EChunkType::TexCoord7: {
-			auto& texCoords = mTextureCoords[static_cast<std::size_t>(opcode - 0x18)];
-			readGenericChunk(reader, texCoords);
-			if (texCoords.empty()) {
-				mEmptyChunks.insert(static_cast<EChunkType>(opcode));
+		case EChunkType::EndOfFile: {
+			entry.mDecoded = true;
+			if (mVerbosePrint) {
+				*mLog << "Reading 0x" << std::hex << opcode << std::dec << ", " << getChunkName(opcode).value() << '\n';
 			}
+
+			// Skip 'length' bytes from current position
+			reader.skip(length);
+
+			// Read the rest of the buffer into mEndOfFileData
+			const std::span<const u8> rest = reader.readSpan(reader.getRemaining());
+			mEndOfFileData.insert(mEndOfFileData.end(), rest.begin(), rest.end());
 			break;
 		}
-		case EChunkType::Texture:
-			readGenericChunk(reader, mTextures);
-			if (mTextures.empty()) {
-				mEmptyChunks.insert(EChunkType::Texture);
-			}
+		default:
+			// Unknown chunks are dropped on write, there is nothing to decode
+			entry.mDecoded = !getChunkName(opcode).has_value();
+			reader.skip(length);
 			break;
-		case EChunkType::TextureAttribute:
-			readGenericChunk(reader, mTextureAttributes);
-			if (mTextureAttributes.empty()) {
-				mEmptyChunks.insert(EChunkType::TextureAttribute);
+		}
+	}
+}
+
+bool MOD::decodeChunk(ChunkEntry& entry)
+{
+	const u32 opcode = entry.mOpcode;
+	util::span_reader reader(mSourceData, entry.mOffset + 8);
+
+	util::profiler::scope profile("decode", util::profiler::enabled() ? profileName(opcode) : std::string());
+	profile.setBytes(entry.mLength);
+
+	util::alloc_stats::watch heap;
+	heap.start();
+
+	bool isEmpty = false;
+	switch (static_cast<EChunkType>(opcode)) {
+	case EChunkType::Header:
+		reader.align();
+		mHeader.mDateTime.mYear  = reader.readU16();
+		mHeader.mDateTime.mMonth = reader.readU8();
+		mHeader.mDateTime.mDay   = reader.readU8();
+		mHeader.mFlags           = reader.readU32();
+		reader.align();
+		break;
+	case EChunkType::Vertex:
+		readGenericChunk(reader, mVertices);
+		isEmpty = mVertices.empty();
+		break;
+	case EChunkType::VertexNormal:
+		readGenericChunk(reader, mVertexNormals);
+		isEmpty = mVertexNormals.empty();
+		break;
+	case EChunkType::VertexNBT:
+		readGenericChunk(reader, mVertexNbt);
+		isEmpty = mVertexNbt.empty();
+		break;
+	case EChunkType::VertexColour:
+		readGenericChunk(reader, mVertexColours);
+		isEmpty = mVertexColours.empty();
+		break;
+	case EChunkType::TexCoord0:
+	case EChunkType::TexCoord1:
+	case EChunkType::TexCoord2:
+	case EChunkType::TexCoord3:
+	case EChunkType::TexCoord4:
+	case EChunkType::TexCoord5:
+	case EChunkType::TexCoord6:
+	case EChunkType::TexCoord7: {
+		auto& texCoords = mTextureCoords[static_cast<std::size_t>(opcode - 0x18)];
+		readGenericChunk(reader, texCoords);
+		isEmpty = texCoords.empty();
+		break;
+	}
+	case EChunkType::Texture:
+		readGenericChunk(reader, mTextures);
+		isEmpty = mTextures.empty();
+		break;
+	case EChunkType::TextureAttribute:
+		readGenericChunk(reader, mTextureAttributes);
+		isEmpty = mTextureAttributes.empty();
+		break;
+	case EChunkType::Material:
+		mMaterials.mMaterials.resize(reader.readU32());
+		mMaterials.mTevEnvironmentInfo.resize(reader.readU32());
+
+		reader.align();
+		if (!mMaterials.mTevEnvironmentInfo.empty()) {
+			for (mat::TEVInfo& info : mMaterials.mTevEnvironmentInfo) {
+				info.read(reader);
 			}
-			break;
-		case EChunkType::Material:
-			mMaterials.mMaterials.resize(reader.readU32());
-			mMaterials.mTevEnvironmentInfo.resize(reader.readU32());
-
-			reader.align();
-			if (!mMaterials.mTevEnvironmentInfo.empty()) {
-				for (mat::TEVInfo& info : mMaterials.mTevEnvironmentInfo) {
-					info.read(reader);
-				}
+		}
+
+		if (!mMaterials.mMaterials.empty()) {
+			for (mat::Material& mat : mMaterials.mMaterials) {
+				mat.read(reader);
 			}
+		}
 
-			if (!mMaterials.mMaterials.empty()) {
-				for (mat::Material& mat : mMaterials.mMaterials) {
-					mat.read(reader);
-				}
+		reader.align();
+
+		isEmpty = mMaterials.mMaterials.empty() && mMaterials.mTevEnvironmentInfo.empty();
+		break;
+	case EChunkType::VertexMatrix:
+		readGenericChunk(reader, mVertexMatrices);
+		isEmpty = mVertexMatrices.empty();
+		break;
+	case EChunkType::MatrixEnvelope:
+		readGenericChunk(reader, mVertexEnvelopes);
+		isEmpty = mVertexEnvelopes.empty();
+		break;
+	case EChunkType::Mesh:
+		readGenericChunk(reader, mMeshes);
+		isEmpty = mMeshes.empty();
+		break;
+	case EChunkType::Joint:
+		readGenericChunk(reader, mJoints);
+		isEmpty = mJoints.empty();
+		break;
+	case EChunkType::JointName:
+		mJointNames.resize(reader.readU32());
+		reader.align();
+		for (std::string& str : mJointNames) {
+			str.resize(reader.readU32());
+			for (char& i : str) {
+				i = reader.readU8();
 			}
+		}
+		reader.align();
+
+		isEmpty = mJointNames.empty();
+		break;
+	case EChunkType::CollisionPrism:
+		mCollisionTriangles.read(reader);
+		break;
+	case EChunkType::CollisionGrid:
+		mCollisionGridInfo.read(reader);
+		break;
+	default:
+		break;
+	}
 
-			reader.align();
+	if (profile.active()) {
+		profile.setElements(getElementCount(static_cast<EChunkType>(opcode)));
+	}
 
-			if (mMaterials.mMaterials.empty() && mMaterials.mTevEnvironmentInfo.empty()) {
-				mEmptyChunks.insert(EChunkType::Material);
-			}
-			break;
-		case EChunkType::VertexMatrix:
-			readGenericChunk(reader, mVertexMatrices);
-			if (mVertexMatrices.empty()) {
-				mEmptyChunks.insert(EChunkType::VertexMatrix);
-			}
-			break;
-		case EChunkType::MatrixEnvelope:
-			readGenericChunk(reader, mVertexEnvelopes);
-			if (mVertexEnvelopes.empty()) {
-				mEmptyChunks.insert(EChunkType::MatrixEnvelope);
-			}
-			break;
-		case EChunkType::Mesh:
-			readGenericChunk(reader, mMeshes);
-			if (mMeshes.empty()) {
-				mEmptyChunks.insert(EChunkType::Mesh);
-			}
-			break;
-		case EChunkType::Joint:
-			readGenericChunk(reader, mJoints);
-			if (mJoints.empty()) {
-				mEmptyChunks.insert(EChunkType::Joint);
-			}
-			break;
-		case EChunkType::JointName:
-			mJointNames.resize(reader.readU32());
-			reader.align();
-			for (std::string& str : mJointNames) {
-				str.resize(reader.readU32());
-				for (char& i : str) {
-					i = reader.readU8();
-				}
-			}
-			reader.align();
+	const util::alloc_stats::usage usage = heap.stop();
+	entry.mHeapBytes                     = static_cast<u64>(std::max<s64>(usage.mRetainedBytes, 0));
+	entry.mAllocations                   = usage.mAllocations;
 
-			if (mJointNames.empty()) {
-				mEmptyChunks.insert(EChunkType::JointName);
-			}
-			break;
-		case EChunkType::CollisionPrism:
-			mCollisionTriangles.read(reader);
-			break;
-		case EChunkType::CollisionGrid:
-			mCollisionGridInfo.read(reader);
-			break;
-		case EChunkType::EndOfFile: {
-			// Skip 'length' bytes from current position
-			reader.seekg(static_cast<std::istream::off_type>(length), std::ios_base::cur);
+	entry.mDecoded = true;
+	return isEmpty;
+}
 
-			// Read the rest of the stream into mEndOfFileData
-			std::vector<u8> buffer(std::istreambuf_iterator<char>(reader), {});
-			mEndOfFileData.insert(mEndOfFileData.end(), buffer.begin(), buffer.end());
+void MOD::decodeEntries(const std::vector<ChunkEntry*>& entries)
+{
+	if (mVerbosePrint) {
+		for (const ChunkEntry* entry : entries) {
+			const auto ocString = getChunkName(entry->mOpcode);
+			*mLog << "Reading 0x" << std::hex << entry->mOpcode << std::dec << ", "
+			      << (ocString.has_value() ? ocString.value() : "Unknown chunk") << '\n';
+		}
+	}
 
-			stopRead = true;
-			break;
+	// Chunks of the same type land in the same members, so they make up one task and are decoded in
+	// file order, exactly like the serial path. Different types never share any state
+	std::vector<std::vector<std::size_t>> tasks;
+	std::map<u32, std::size_t> taskForOpcode;
+	for (std::size_t i = 0; i < entries.size(); ++i) {
+		const auto [it, inserted] = taskForOpcode.try_emplace(entries[i]->mOpcode, tasks.size());
+		if (inserted) {
+			tasks.emplace_back();
 		}
-		default:
-			// If we don't recognise the chunk then skip it
-			reader.seekg(static_cast<std::basic_istream<char, std::char_traits<char>>::off_type>(length), std::ios_base::cur);
-			break;
+		tasks[it->second].push_back(i);
+	}
+
+	// Start on the biggest chunks first so a large texture or collision chunk doesn't finish last
+	auto taskSize = [&](const std::vector<std::size_t>& task) {
+		std::size_t size = 0;
+		for (std::size_t i : task) {
+			size += entries[i]->mLength;
+		}
+		return size;
+	};
+	std::stable_sort(tasks.begin(), tasks.end(), [&](const auto& a, const auto& b) { return taskSize(a) > taskSize(b); });
+
+	std::vector<u8> isEmpty(entries.size(), false);
+	util::parallel_for(tasks.size(), mJobs, [&](std::size_t task) {
+		for (std::size_t i : tasks[task]) {
+			isEmpty[i] = decodeChunk(*entries[i]);
+		}
+	});
+
+	for (std::size_t i = 0; i < entries.size(); ++i) {
+		if (isEmpty[i]) {
+			mEmptyChunks.insert(static_cast<EChunkType>(entries[i]->mOpcode));
 		}
 	}
+
+	releaseSourceData();
 }
 
-// NOTE: the control flow and layout of this function is a replica of a
-// decompiled version of the DMD->MOD process, found in plugTexConv
-void MOD::write(util::fstream_writer& writer)
+void MOD::decode(EChunkType chunkType) { decode({ chunkType }); }
+
+void MOD::decode(std::initializer_list<EChunkType> chunkTypes)
 {
-	// Write header
-	u32 headerPos = startChunk(writer, static_cast<u32>(EChunkType::Header));
-	writer.align();
-	writer.writeU16(mHeader.mDateTime.mYear);
-	writer.writeU8(mHeader.mDateTime.mMonth);
-	writer.writeU8(mHeader.mDateTime.mDay);
-	writer.writeU32(mHeader.mFlags);
-	finishChunk(writer, headerPos);
-
-	if (!mVertices.empty() || mEmptyChunks.contains(EChunkType::Vertex)) {
-		writeGenericChunk(writer, mVertices, EChunkType::Vertex, mVerbosePrint);
+	std::vector<ChunkEntry*> pending;
+	for (ChunkEntry& entry : mChunkDirectory) {
+		if (!entry.mDecoded && std::find(chunkTypes.begin(), chunkTypes.end(), static_cast<EChunkType>(entry.mOpcode)) != chunkTypes.end()) {
+			pending.push_back(&entry);
+		}
 	}
 
-	if (!mVertexColours.empty() || mEmptyChunks.contains(EChunkType::VertexColour)) {
-		writeGenericChunk(writer, mVertexColours, EChunkType::VertexColour, mVerbosePrint);
+	decodeEntries(pending);
+}
+
+void MOD::decodeAll()
+{
+	std::vector<ChunkEntry*> pending;
+	for (ChunkEntry& entry : mChunkDirectory) {
+		if (!entry.mDecoded) {
+			pending.push_back(&entry);
+		}
 	}
 
-	if (!mVertexNormals.empty() || mEmptyChunks.contains(EChunkType::VertexNormal)) {
-		writeGenericChunk(writer, mVertexNormals, EChunkType::VertexNormal, mVerbosePrint);
+	decodeEntries(pending);
+}
+
+void MOD::discardRaw(EChunkType chunkType)
+{
+	for (ChunkEntry& entry : mChunkDirectory) {
+		if (entry.mOpcode == static_cast<u32>(chunkType)) {
+			entry.mDecoded = true;
+		}
 	}
 
-	if ((mHeader.mFlags & static_cast<u32>(MODFlags::UseNBT) && !mVertexNbt.empty()) || mEmptyChunks.contains(EChunkType::VertexNBT)) {
-		writeGenericChunk(writer, mVertexNbt, EChunkType::VertexNBT, mVerbosePrint);
+	releaseSourceData();
+}
+
+bool MOD::isPending(EChunkType chunkType) const { return findPendingChunk(chunkType) != nullptr; }
+
+std::size_t MOD::getElementCount(EChunkType chunkType) const
+{
+	const u32 opcode = static_cast<u32>(chunkType);
+	if (opcode >= static_cast<u32>(EChunkType::TexCoord0) && opcode <= static_cast<u32>(EChunkType::TexCoord7)) {
+		return mTextureCoords[opcode - static_cast<u32>(EChunkType::TexCoord0)].size();
 	}
 
-	for (std::size_t i = 0; i < mTextureCoords.size(); i++) {
-		auto texIdx = static_cast<EChunkType>(static_cast<u32>(EChunkType::TexCoord0) + i);
-		if (!mTextureCoords[i].empty() || mEmptyChunks.contains(texIdx)) {
-			writeGenericChunk(writer, mTextureCoords[i], texIdx, mVerbosePrint);
-		}
+	switch (chunkType) {
+	case EChunkType::Vertex:
+		return mVertices.size();
+	case EChunkType::VertexNormal:
+		return mVertexNormals.size();
+	case EChunkType::VertexNBT:
+		return mVertexNbt.size();
+	case EChunkType::VertexColour:
+		return mVertexColours.size();
+	case EChunkType::Texture:
+		return mTextures.size();
+	case EChunkType::TextureAttribute:
+		return mTextureAttributes.size();
+	case EChunkType::Material:
+		return mMaterials.mMaterials.size();
+	case EChunkType::VertexMatrix:
+		return mVertexMatrices.size();
+	case EChunkType::MatrixEnvelope:
+		return mVertexEnvelopes.size();
+	case EChunkType::Mesh:
+		return mMeshes.size();
+	case EChunkType::Joint:
+		return mJoints.size();
+	case EChunkType::JointName:
+		return mJointNames.size();
+	case EChunkType::CollisionPrism:
+		return mCollisionTriangles.mCollInfo.size();
+	case EChunkType::CollisionGrid:
+		return mCollisionGridInfo.mGroups.size();
+	default:
+		return 0;
 	}
+}
 
-	if (!mTextures.empty() || mEmptyChunks.contains(EChunkType::Texture)) {
-		writeGenericChunk(writer, mTextures, EChunkType::Texture, mVerbosePrint);
+const MOD::ChunkEntry* MOD::findPendingChunk(EChunkType chunkType) const
+{
+	// The last chunk of a type wins when decoding, so it is also the one passed through
+	const auto it = std::find_if(mChunkDirectory.rbegin(), mChunkDirectory.rend(),
+	                             [&](const ChunkEntry& entry) { return entry.mOpcode == static_cast<u32>(chunkType); });
+	return (it == mChunkDirectory.rend() || it->mDecoded) ? nullptr : &*it;
+}
+
+void MOD::releaseSourceData()
+{
+	// Once nothing refers to the source bytes any more there is no reason to keep them around
+	if (std::all_of(mChunkDirectory.begin(), mChunkDirectory.end(), [](const ChunkEntry& entry) { return entry.mDecoded; })) {
+		mSourceData = {};
+		mSourceOwner.reset();
 	}
+}
 
-	if (!mTextureAttributes.empty() || mEmptyChunks.contains(EChunkType::TextureAttribute)) {
-		writeGenericChunk(writer, mTextureAttributes, EChunkType::TextureAttribute, mVerbosePrint);
+// NOTE: the control flow and layout of this function is a replica of a
+// decompiled version of the DMD->MOD process, found in plugTexConv
+void MOD::write(util::vector_writer& writer)
+{
+	util::profiler::scope profile("phase", "write");
+	const std::size_t startPosition = writer.getPosition();
+
+	// Without the UseNBT flag the NBT chunk is only kept when it's empty, so that needs the decoded data
+	if (!(mHeader.mFlags & static_cast<u32>(MODFlags::UseNBT))) {
+		decode(EChunkType::VertexNBT);
 	}
 
-	if (!mMaterials.mMaterials.empty() || mEmptyChunks.contains(EChunkType::Material)) {
-		if (mVerbosePrint) {
-			std::cout << "Writing 0x30, " << MOD::getChunkName(EChunkType::Material).value() << '\n';
+	// Decide which chunks make it into the file and in what order, untouched ones are passed through as is
+	std::vector<ChunkTask> tasks;
+	auto addChunk = [&](EChunkType chunkType, bool wanted, std::function<void(util::vector_writer&)> encode) {
+		ChunkTask task;
+		task.mOpcode   = static_cast<u32>(chunkType);
+		task.mRawEntry = findPendingChunk(chunkType);
+		if (task.mRawEntry == nullptr) {
+			if (!wanted) {
+				return;
+			}
+
+			task.mEncode = std::move(encode);
 		}
 
-		const u32 start = startChunk(writer, static_cast<u32>(EChunkType::Material));
-		writer.writeU32(static_cast<u32>(mMaterials.mMaterials.size()));
-		writer.writeU32(static_cast<u32>(mMaterials.mTevEnvironmentInfo.size()));
-		writer.align();
+		tasks.push_back(std::move(task));
+	};
+
+	auto addGenericChunk = [&](auto& vector, EChunkType chunkType) {
+		addChunk(chunkType, !vector.empty() || mEmptyChunks.contains(chunkType),
+		         [&vector, chunkType](util::vector_writer& out) { writeGenericChunk(out, vector, chunkType); });
+	};
+
+	addChunk(EChunkType::Header, true, [this](util::vector_writer& out) {
+		const u32 start = startChunk(out, static_cast<u32>(EChunkType::Header));
+		out.align();
+		out.writeU16(mHeader.mDateTime.mYear);
+		out.writeU8(mHeader.mDateTime.mMonth);
+		out.writeU8(mHeader.mDateTime.mDay);
+		out.writeU32(mHeader.mFlags);
+		finishChunk(out, start);
+	});
+
+	addGenericChunk(mVertices, EChunkType::Vertex);
+	addGenericChunk(mVertexColours, EChunkType::VertexColour);
+	addGenericChunk(mVertexNormals, EChunkType::VertexNormal);
+
+	addChunk(EChunkType::VertexNBT,
+	         ((mHeader.mFlags & static_cast<u32>(MODFlags::UseNBT)) && !mVertexNbt.empty()) || mEmptyChunks.contains(EChunkType::VertexNBT),
+	         [this](util::vector_writer& out) { writeGenericChunk(out, mVertexNbt, EChunkType::VertexNBT); });
+
+	for (std::size_t i = 0; i < mTextureCoords.size(); i++) {
+		addGenericChunk(mTextureCoords[i], static_cast<EChunkType>(static_cast<u32>(EChunkType::TexCoord0) + i));
+	}
+
+	addGenericChunk(mTextures, EChunkType::Texture);
+	addGenericChunk(mTextureAttributes, EChunkType::TextureAttribute);
+
+	addChunk(EChunkType::Material, !mMaterials.mMaterials.empty() || mEmptyChunks.contains(EChunkType::Material), [this](util::vector_writer& out) {
+		const u32 start = startChunk(out, static_cast<u32>(EChunkType::Material));
+		out.writeU32(static_cast<u32>(mMaterials.mMaterials.size()));
+		out.writeU32(static_cast<u32>(mMaterials.mTevEnvironmentInfo.size()));
+		out.align();
 		for (mat::TEVInfo& tevInfo : mMaterials.mTevEnvironmentInfo) {
-			tevInfo.write(writer);
+			tevInfo.write(out);
 		}
 		for (mat::Material& material : mMaterials.mMaterials) {
-			material.write(writer);
+			material.write(out);
 		}
-		finishChunk(writer, start);
-	}
+		finishChunk(out, start);
+	});
 
-	if (!mVertexEnvelopes.empty() || mEmptyChunks.contains(EChunkType::MatrixEnvelope)) {
-		writeGenericChunk(writer, mVertexEnvelopes, EChunkType::MatrixEnvelope, mVerbosePrint);
-	}
+	addGenericChunk(mVertexEnvelopes, EChunkType::MatrixEnvelope);
+	addGenericChunk(mVertexMatrices, EChunkType::VertexMatrix);
+	addGenericChunk(mMeshes, EChunkType::Mesh);
 
-	if (!mVertexMatrices.empty() || mEmptyChunks.contains(EChunkType::VertexMatrix)) {
-		writeGenericChunk(writer, mVertexMatrices, EChunkType::VertexMatrix, mVerbosePrint);
-	}
+	if (isPending(EChunkType::Joint) || !mJoints.empty() || mEmptyChunks.contains(EChunkType::Joint)) {
+		addChunk(EChunkType::Joint, true, [this](util::vector_writer& out) { writeGenericChunk(out, mJoints, EChunkType::Joint); });
 
-	if (!mMeshes.empty() || mEmptyChunks.contains(EChunkType::Mesh)) {
-		writeGenericChunk(writer, mMeshes, EChunkType::Mesh, mVerbosePrint);
+		addChunk(EChunkType::JointName, !mJointNames.empty() || mEmptyChunks.contains(EChunkType::JointName), [this](util::vector_writer& out) {
+			const u32 start = startChunk(out, static_cast<u32>(EChunkType::JointName));
+			out.writeU32(static_cast<u32>(mJointNames.size()));
+			out.align();
+			for (std::string& name : mJointNames) {
+				out.writeU32(static_cast<u32>(name.size()));
+				for (char i : name) {
+					out.writeU8(i);
+				}
+			}
+			finishChunk(out, start);
+		});
 	}
 
-	if (!mJoints.empty() || mEmptyChunks.contains(EChunkType::Joint)) {
-		writeGenericChunk(writer, mJoints, EChunkType::Joint, mVerbosePrint);
+	// Collision is only written when there are triangles, for an untouched chunk that's the first word of its payload
+	bool hasCollision = !mCollisionTriangles.mCollInfo.empty();
+	if (const ChunkEntry* prism = findPendingChunk(EChunkType::CollisionPrism)) {
+		hasCollision = prism->mLength >= 4 && util::span_reader::load<u32>(mSourceData.data() + prism->mOffset + 8) != 0;
+	}
 
-		if (!mJointNames.empty() || mEmptyChunks.contains(EChunkType::JointName)) {
-			if (mVerbosePrint) {
-				std::cout << "Writing 0x61, " << MOD::getChunkName(EChunkType::JointName).value() << '\n';
+	// These come as a duo
+	if (hasCollision) {
+		addChunk(EChunkType::CollisionPrism, true, [this](util::vector_writer& out) { mCollisionTriangles.write(out); });
+
+		addChunk(EChunkType::CollisionGrid, true, [this](util::vector_writer& out) {
+			const u32 start = startChunk(out, static_cast<u32>(EChunkType::CollisionGrid));
+			out.align();
+			mCollisionGridInfo.mAABBMin.write(out);
+			mCollisionGridInfo.mAABBMax.write(out);
+			out.writeF32(mCollisionGridInfo.mCellSize);
+			out.writeU32(mCollisionGridInfo.mCellCountX);
+			out.writeU32(mCollisionGridInfo.mCellCountY);
+			out.writeU32(static_cast<u32>(mCollisionGridInfo.mGroups.size()));
+
+			for (CollGroup& group : mCollisionGridInfo.mGroups) {
+				group.write(out);
 			}
 
-			const u32 start = startChunk(writer, static_cast<u32>(EChunkType::JointName));
-			writer.writeU32(static_cast<u32>(mJointNames.size()));
-			writer.align();
-			for (std::string& name : mJointNames) {
-				writer.writeU32(static_cast<u32>(name.size()));
-				for (char i : name) {
-					writer.writeU8(i);
-				}
+			for (s32& i : mCollisionGridInfo.mGroupIndices) {
+				out.writeS32(i);
 			}
-			finishChunk(writer, start);
-		}
+			out.align();
+			finishChunk(out, start);
+		});
 	}
 
-	if (!mCollisionTriangles.mCollInfo.empty()) {
-		if (mVerbosePrint) {
-			std::cout << "Writing 0x100, " << MOD::getChunkName(EChunkType::CollisionPrism).value() << '\n';
-		}
+	// Every chunk starts and ends on the file alignment, so each one encodes the same in its own buffer as it
+	// would in place, and the chunks only read their own members
+	util::parallel_for(tasks.size(), mJobs, [&](std::size_t i) {
+		if (tasks[i].mEncode) {
+			util::profiler::scope encodeProfile("encode", util::profiler::enabled() ? profileName(tasks[i].mOpcode) : std::string());
 
-		mCollisionTriangles.write(writer);
+			util::vector_writer out;
+			tasks[i].mEncode(out);
+			tasks[i].mOutput = out.takeBuffer();
+
+			encodeProfile.setBytes(tasks[i].mOutput.size());
+			if (encodeProfile.active()) {
+				encodeProfile.setElements(getElementCount(static_cast<EChunkType>(tasks[i].mOpcode)));
+			}
+		}
+	});
 
-		// These come as a duo
-		const u32 start = startChunk(writer, static_cast<u32>(EChunkType::CollisionGrid));
-		writer.align();
-		mCollisionGridInfo.mAABBMin.write(writer);
-		mCollisionGridInfo.mAABBMax.write(writer);
-		writer.writeF32(mCollisionGridInfo.mCellSize);
-		writer.writeU32(mCollisionGridInfo.mCellCountX);
-		writer.writeU32(mCollisionGridInfo.mCellCountY);
-		writer.writeU32(static_cast<u32>(mCollisionGridInfo.mGroups.size()));
+	std::size_t totalSize = writer.getPosition() + cfg::MOD_ALIGNMENT_AMT + mEndOfFileData.size();
+	for (const ChunkTask& task : tasks) {
+		totalSize += task.mRawEntry ? static_cast<std::size_t>(task.mRawEntry->mLength) + 8 : task.mOutput.size();
+	}
+	writer.reserve(totalSize);
 
-		for (CollGroup& group : mCollisionGridInfo.mGroups) {
-			group.write(writer);
+	for (const ChunkTask& task : tasks) {
+		if (mVerbosePrint) {
+			*mLog << "Writing 0x" << std::hex << task.mOpcode << std::dec << " at offset 0x" << std::hex << std::uppercase
+			      << writer.getPosition() << std::nouppercase << std::dec << ", " << getChunkName(task.mOpcode).value()
+			      << (task.mRawEntry ? " (unchanged)\n" : "\n");
 		}
 
-		for (s32& i : mCollisionGridInfo.mGroupIndices) {
-			writer.writeS32(i);
+		if (task.mRawEntry) {
+			writer.write_buffer(mSourceData.data() + task.mRawEntry->mOffset, static_cast<std::size_t>(task.mRawEntry->mLength) + 8);
+		} else {
+			writer.write_buffer(task.mOutput.data(), task.mOutput.size());
 		}
-		writer.align();
-		finishChunk(writer, start);
 	}
 
 	// Finalise writing with 0xFFFF chunk and append any INI file
@@ -336,11 +665,14 @@ void MOD::write(util::fstream_writer& writer)
 
 	if (!mEndOfFileData.empty()) {
 		if (mVerbosePrint) {
-			std::cout << "Writing 0xffff, " << MOD::getChunkName(EChunkType::EndOfFile).value() << '\n';
+			*mLog << "Writing 0xffff, " << MOD::getChunkName(EChunkType::EndOfFile).value() << '\n';
 		}
 
-		writer.write(reinterpret_cast<char*>(mEndOfFileData.data()), mEndOfFileData.size());
+		writer.write_buffer(mEndOfFileData.data(), mEndOfFileData.size());
 	}
+
+	profile.setBytes(writer.getPosition() - startPosition);
+	profile.setElements(tasks.size());
 }
 
 void MOD::reset()
@@ -372,6 +704,11 @@ void MOD::reset()
 	mEndOfFileData.clear();
 
 	mEmptyChunks.clear();
+
+	mChunkDirectory.clear();
+	mSourceData = {};
+	mSourceOwner.reset();
+	mSourceSize = 0;
 }
 
 // clang-format off
@@ -3,11 +3,15 @@
 
 #include "common.hpp"
 #include <array>
+#include <iostream>
+#include <memory>
 #include <optional>
+#include <span>
 #include <type_traits>
 #include <string_view>
 #include <vector>
 #include <bitset>
+#include <initializer_list>
 #include <unordered_set>
 
 /**
@@ -77,6 +81,18 @@ struct MOD {
 		EndOfFile = 0xFFFF,
 	};
 
+	/**
+	 * @brief Location of a chunk inside the file the MOD was read from.
+	 */
+	struct ChunkEntry {
+		u32 mOpcode      = 0;
+		u32 mOffset      = 0; // Offset of the chunk opcode from the start of the file
+		u32 mLength      = 0; // Length of the chunk payload, excluding the opcode and length words
+		bool mDecoded    = false;
+		u64 mHeapBytes   = 0; // Heap still held once decoded, only counted in builds with MODCONV_TRACK_ALLOCATIONS
+		u64 mAllocations = 0; // Allocations made while decoding
+	};
+
 	/**
 	 * @brief Default constructor for MOD.
 	 */
@@ -84,9 +100,9 @@ struct MOD {
 
 	/**
 	 * @brief Constructor for MOD that reads data from the given reader.
-	 * @param reader The fstream_reader to read data from.
+	 * @param reader The span_reader to read data from.
 	 */
-	MOD(util::fstream_reader& reader) { read(reader); }
+	MOD(util::span_reader& reader) { read(reader); }
 
 	/**
 	 * @brief Default destructor for MOD.
@@ -94,22 +110,86 @@ struct MOD {
 	~MOD() = default;
 
 	/**
-	 * @brief Reads the MOD data from the given reader.
-	 * @param reader The fstream_reader to read data from.
+	 * @brief Indexes the MOD data from the given reader.
+	 *
+	 * Only the header and end of file chunks are decoded straight away, every other chunk is recorded
+	 * in mChunkDirectory and decoded on demand by decode(). The bytes are copied, so the reader's
+	 * memory doesn't need to outlive the MOD.
+	 * @param reader The span_reader positioned at the start of the MOD.
+	 */
+	void read(util::span_reader& reader);
+
+	/**
+	 * @brief Reads the MOD data from a stream, for sources that can't be memory mapped (e.g. pipes).
+	 * @param reader The fstream_reader to read data from, the rest of the stream is buffered in memory.
 	 */
 	void read(util::fstream_reader& reader);
 
 	/**
-	 * @brief Writes the MOD data to the given writer.
-	 * @param writer The fstream_writer to write data to.
+	 * @brief Indexes the MOD data without copying it, pending chunks are decoded straight from the given bytes.
+	 *
+	 * When the bytes are a file mapping, another process truncating or rewriting the file while chunks are still
+	 * pending makes the next decode fault (SIGBUS) rather than throw. Call detachSource() or decodeAll() before
+	 * holding on to a model that long.
+	 * @param bytes The contents of the MOD file, e.g. a util::mapped_file.
+	 * @param owner Keeps the bytes alive while chunks may still be decoded from them, null if the caller does.
+	 */
+	void read(std::span<const u8> bytes, std::shared_ptr<const void> owner);
+
+	/**
+	 * @brief Copies the source bytes into memory the MOD owns, for when what they point into is about to change
+	 * (e.g. the mapped file is overwritten). Does nothing once every chunk has been decoded.
 	 */
-	void write(util::fstream_writer& writer);
+	void detachSource();
+
+	/**
+	 * @brief Serializes the MOD data into the given in-memory writer.
+	 * @param writer The vector_writer to write data to, flush its buffer to persist the model.
+	 */
+	void write(util::vector_writer& writer);
 
 	/**
 	 * @brief Resets the MOD data to its default state.
 	 */
 	void reset();
 
+	/**
+	 * @brief Decodes every chunk of the given type that hasn't been decoded yet.
+	 * @param chunkType The chunk type to decode.
+	 */
+	void decode(EChunkType chunkType);
+
+	/**
+	 * @brief Decodes every chunk of the given types that hasn't been decoded yet.
+	 * @param chunkTypes The chunk types to decode.
+	 */
+	void decode(std::initializer_list<EChunkType> chunkTypes);
+
+	/**
+	 * @brief Decodes every chunk that hasn't been decoded yet, spread over mJobs threads.
+	 */
+	void decodeAll();
+
+	/**
+	 * @brief Forgets the undecoded bytes of a chunk type, for when its members are about to be replaced or cleared.
+	 * @param chunkType The chunk type to discard.
+	 */
+	void discardRaw(EChunkType chunkType);
+
+	/**
+	 * @brief Checks if a chunk of the given type is still waiting to be decoded.
+	 * @param chunkType The chunk type.
+	 * @return True if write() would pass the chunk through untouched.
+	 */
+	bool isPending(EChunkType chunkType) const;
+
+	/**
+	 * @brief Counts the decoded elements of a chunk type, e.g. vertices or collision triangles.
+	 * @param chunkType The chunk type.
+	 * @return The number of elements, 0 for chunks that don't hold a list.
+	 */
+	std::size_t getElementCount(EChunkType chunkType) const;
+
 	/**
 	 * @brief Gets the name of the chunk with the given opcode.
 	 * @param opcode The opcode of the chunk.
@@ -145,7 +225,25 @@ struct MOD {
 	// When doing unit tests, empty chunks arise, we need to keep track of them
 	std::unordered_set<EChunkType> mEmptyChunks;
 
+	// Every chunk found by read(), in file order, and the bytes they point into. mSourceOwner keeps those alive,
+	// it is the file mapping when the model was loaded from disk and a copy otherwise
+	std::vector<ChunkEntry> mChunkDirectory;
+	std::span<const u8> mSourceData;
+	std::shared_ptr<const void> mSourceOwner;
+	std::size_t mSourceSize = 0; // Bytes read() was given, 0 for models built in memory
+
 	bool mVerbosePrint = false;
+	std::ostream* mLog = &std::cout; // Where progress and read errors are printed
+
+	// Threads used to decode and encode chunks, 1 works serially and 0 uses one per hardware thread
+	unsigned mJobs = 1;
+
+private:
+	void indexChunks();
+	bool decodeChunk(ChunkEntry& entry);
+	void decodeEntries(const std::vector<ChunkEntry*>& entries);
+	void releaseSourceData();
+	const ChunkEntry* findPendingChunk(EChunkType chunkType) const;
 };
 
 #endif
\ No newline at end of file
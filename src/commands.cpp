@@ -4,101 +4,219 @@
 #include <map>
 #include <functional>
 #include <set>
+#include <sstream>
 #include <numeric>
+#include <array>
+#include <span>
+#include <cstdio>
 
-#include "util/vector_reader.hpp"
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "util/mapped_file.hpp"
+#include "util/alloc_stats.hpp"
 #include "util/misc.hpp"
+#include "util/parallel_for.hpp"
+#include "util/profiler.hpp"
+#include "util/text_writer.hpp"
 #include "common.hpp"
 #include "commands.hpp"
+#include "generator.hpp"
 
 using namespace mat;
 
-namespace cmd {
-MOD gModFile;
-std::string gModFileName;
-util::tokeniser gTokeniser;
+namespace {
+// Size of a file a command has just written or is about to read, for the --profile byte counts
+u64 profiledFileSize(const std::string& filename)
+{
+	if (!util::profiler::enabled()) {
+		return 0;
+	}
 
-namespace mod {
-inline bool isModFileOpen() { return static_cast<bool>(!gModFileName.empty()); }
+	std::error_code ec;
+	const std::uintmax_t size = std::filesystem::file_size(filename, ec);
+	return ec ? 0 : static_cast<u64>(size);
+}
+
+// Takes a command's next argument, or asks for it on the session's input when it wasn't given. Fails when
+// there is nobody to ask, as in --serve where stdin carries the requests
+bool nextOrAsk(cmd::Session& session, const std::string& prompt, std::string& value)
+{
+	if (!session.mTokeniser.isEnd()) {
+		value = session.mTokeniser.next();
+		return true;
+	}
+
+	if (session.mIn == nullptr) {
+		return false;
+	}
+
+	session.out() << prompt;
+	return static_cast<bool>(std::getline(*session.mIn, value));
+}
+} // namespace
 
-void importMod()
+namespace cmd {
+namespace mod {
+Status importMod(Session& session)
 {
-	const std::string& filename = gTokeniser.next();
+	MOD& modFile = session.mModFile;
+
+	const std::string& filename = session.mTokeniser.next();
 	if (filename.empty()) {
-		std::cout << "Filename not provided!" << '\n';
+		return Status::error("Filename not provided!");
 	}
 
-	util::fstream_reader reader;
-	reader.open(filename, std::ios_base::binary);
-	if (!reader.is_open()) {
-		std::cout << "Unable to open " << filename << '\n';
-		return;
+	// Map the whole file and decode straight from memory, pipes and other
+	// unmappable sources go through the stream reader instead
+	auto mapping = std::make_shared<util::mapped_file>();
+	if (mapping->open(filename)) {
+		session.mModFileName = filename;
+		modFile.reset();
+
+		// The chunks that aren't decoded yet point into the mapping, the model keeps it open until they are
+		modFile.read(mapping->data(), mapping);
+	} else {
+		util::fstream_reader reader;
+		reader.open(filename, std::ios_base::binary);
+		if (!reader.is_open()) {
+			return Status::error("Unable to open " + filename);
+		}
+
+		session.mModFileName = filename;
+		modFile.reset();
+
+		modFile.read(reader);
+		reader.close();
+	}
+
+	if (modFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
 
-	gModFileName = filename;
-	gModFile.reset();
+	return {};
+}
+
+Status exportMod(Session& session)
+{
+	const std::string& filename = session.mTokeniser.next();
+
+	// Serialize the whole model in memory so the output only sees a single
+	// write and never has to seek, which lets "-" stream it to stdout
+	util::vector_writer writer;
+	session.mModFile.write(writer);
+	const std::vector<u8>& buffer = writer.getBuffer();
+
+	util::profiler::scope profile("io", "write MOD file");
+	profile.setBytes(buffer.size());
+
+	if (filename == "-") {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		session.out().flush();
+		if (std::fwrite(buffer.data(), 1, buffer.size(), stdout) != buffer.size() || std::fflush(stdout) != 0) {
+			return Status::error("Unable to write to stdout");
+		}
+	} else {
+		// Undecoded chunks may be mapped from the very file that's about to be truncated
+		std::error_code ec;
+		if (std::filesystem::equivalent(filename, session.mModFileName, ec)) {
+			session.mModFile.detachSource();
+		}
+
+		std::ofstream os(filename, std::ios_base::binary);
+		if (!os.is_open()) {
+			return Status::error("Unable to open " + filename);
+		}
 
-	reader.seekg(0, std::ios_base::beg);
-	gModFile.read(reader);
-	reader.close();
+		os.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+	}
 
-	if (gModFile.mVerbosePrint) {
-		std::cout << "Done!" << '\n';
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
+
+	return {};
 }
 
-void exportMod()
+Status resetModel(Session& session)
 {
-	const std::string& filename = gTokeniser.next();
-	util::fstream_writer writer;
-	writer.open(filename, std::ios_base::binary);
-	if (!writer.is_open()) {
-		std::cout << "Unable to open " << filename << '\n';
-		return;
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	gModFile.write(writer);
-	writer.close();
+	session.mModFile.reset();
+	session.mModFileName = "";
 
-	if (gModFile.mVerbosePrint) {
-		std::cout << "Done!" << '\n';
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
+
+	return {};
 }
 
-void resetModel()
+Status generateModel(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	generator::Settings settings;
+	while (!session.mTokeniser.isEnd()) {
+		const std::string setting = session.mTokeniser.next();
+		const std::size_t equals  = setting.find('=');
+		if (equals == std::string::npos) {
+			return Status::error("Expected setting=value, got " + setting);
+		}
+
+		u32 value = 0;
+		try {
+			value = static_cast<u32>(std::stoul(setting.substr(equals + 1)));
+		} catch (...) {
+			return Status::error("Invalid value in " + setting);
+		}
+
+		if (!settings.set(setting.substr(0, equals), value)) {
+			return Status::error("Unknown setting: " + setting.substr(0, equals));
+		}
 	}
 
-	gModFile.reset();
-	gModFileName = "";
+	generator::generate(session.mModFile, settings);
+	session.mModFileName = "generated_" + std::to_string(settings.mSeed) + ".mod";
 
-	if (gModFile.mVerbosePrint) {
-		std::cout << "Done!" << '\n';
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done! Generated " << session.mModFile.mVertices.size() << " vertices, " << session.mModFile.mMeshes.size()
+		              << " meshes and " << session.mModFile.mCollisionTriangles.mCollInfo.size() << " collision triangles" << '\n';
 	}
+
+	return {};
 }
 
-void listChunks()
+Status listChunks(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
 	const int nameWidth = 20;
 
-	auto printRow
-	    = [&](const std::string& name, const std::string& data) { std::cout << std::left << std::setw(nameWidth) << name << data << '\n'; };
+	auto printRow = [&](const std::string& name, const std::string& data) {
+		session.out() << std::left << std::setw(nameWidth) << name << data << '\n';
+	};
 
-	std::cout << "\n--- File Information ---\n";
-	printRow("MOD File:", gModFileName);
-	printRow("File Size:", std::to_string(std::filesystem::file_size(gModFileName)) + " bytes");
+	session.out() << "\n--- File Information ---\n";
+	printRow("MOD File:", session.mModFileName);
+	// The name isn't always a file on disk (loadFromMemory, generate), so the size is the one read() was given
+	if (modFile.mChunkDirectory.empty()) {
+		printRow("File Size:", "none, built in memory");
+	} else {
+		printRow("File Size:", std::to_string(modFile.mSourceSize) + " bytes");
+	}
 
 	// --- Header (Always Present) ---
-	std::cout << "\n--- Header ---\n";
-	const auto& header = gModFile.mHeader;
+	session.out() << "\n--- Header ---\n";
+	const auto& header = modFile.mHeader;
 	std::stringstream dateStream;
 	dateStream << header.mDateTime.mYear << "/" << std::setfill('0') << std::setw(2) << static_cast<u32>(header.mDateTime.mMonth) << "/"
 	           << std::setfill('0') << std::setw(2) << static_cast<u32>(header.mDateTime.mDay);
@@ -108,19 +226,65 @@ void listChunks()
 	flagsStream << "0x" << std::hex << header.mFlags << std::dec << " (" << MaterialFlagsToString(header.mFlags) << ")";
 	printRow("Flags:", flagsStream.str());
 
+	// Only the chunk directory is needed for the summary, "full" decodes everything for the detailed report
+	const bool fullReport = !session.mTokeniser.isEnd() && session.mTokeniser.next() == "full";
+	if (!fullReport && modFile.mChunkDirectory.empty()) {
+		// Nothing has been read, so list the chunks write() would encode instead of offsets
+		session.out() << "\n--- Chunks ---\n";
+		session.out() << std::left << std::setw(8) << "Opcode" << std::setw(10) << "Elements" << "Name\n";
+		for (u32 opcode = 0; opcode <= static_cast<u32>(MOD::EChunkType::CollisionGrid); ++opcode) {
+			const std::size_t elements = modFile.getElementCount(static_cast<MOD::EChunkType>(opcode));
+			if (elements == 0) {
+				continue;
+			}
+
+			std::stringstream opcodeStr;
+			opcodeStr << "0x" << std::hex << std::uppercase << opcode;
+			session.out() << std::left << std::setw(8) << opcodeStr.str() << std::setw(10) << elements
+			              << MOD::getChunkName(opcode).value_or("Unknown chunk") << '\n';
+		}
+
+		session.out() << "\nUse 'list_chunks full' for a detailed breakdown\n";
+		return {};
+	}
+
+	if (!fullReport) {
+		session.out() << "\n--- Chunks ---\n";
+		session.out() << std::left << std::setw(8) << "Opcode" << std::setw(10) << "Offset" << std::setw(10) << "Size" << "Name\n";
+		for (const MOD::ChunkEntry& entry : modFile.mChunkDirectory) {
+			const auto chunkName = MOD::getChunkName(entry.mOpcode);
+
+			std::stringstream opcode, offset;
+			opcode << "0x" << std::hex << std::uppercase << entry.mOpcode;
+			offset << "0x" << std::hex << std::uppercase << entry.mOffset;
+
+			session.out() << std::left << std::setw(8) << opcode.str() << std::setw(10) << offset.str() << std::setw(10)
+			              << (static_cast<std::size_t>(entry.mLength) + 8) << (chunkName.has_value() ? chunkName.value() : "Unknown chunk");
+			if (entry.mOpcode == static_cast<u32>(MOD::EChunkType::EndOfFile) && !modFile.mEndOfFileData.empty()) {
+				session.out() << " (+" << modFile.mEndOfFileData.size() << " bytes INI/Config data)";
+			}
+			session.out() << '\n';
+		}
+
+		session.out() << "\nUse 'list_chunks full' for a detailed breakdown\n";
+		return {};
+	}
+
+	modFile.decodeAll();
+
 	// --- Geometry Section ---
 	u32 totalTexCoords = 0;
-	for (const auto& coords : gModFile.mTextureCoords) {
+	for (const auto& coords : modFile.mTextureCoords) {
 		totalTexCoords += static_cast<u32>(coords.size());
 	}
-	const bool hasGeometry = !gModFile.mVertices.empty() || !gModFile.mVertexNormals.empty() || !gModFile.mVertexNbt.empty()
-	                      || !gModFile.mVertexColours.empty() || totalTexCoords > 0;
+	const bool hasGeometry = !modFile.mVertices.empty() || !modFile.mVertexNormals.empty() || !modFile.mVertexNbt.empty()
+	                      || !modFile.mVertexColours.empty() || totalTexCoords > 0;
 
 	if (hasGeometry) {
-		std::cout << "\n--- Geometry ---\n";
-		if (!gModFile.mVertices.empty()) {
-			Vector3f minBounds = gModFile.mVertices[0], maxBounds = gModFile.mVertices[0];
-			for (const auto& v : gModFile.mVertices) {
+		session.out() << "\n--- Geometry ---\n";
+		if (!modFile.mVertices.empty()) {
+			Vector3f minBounds = modFile.mVertices[0], maxBounds = modFile.mVertices[0];
+			for (const auto& v : modFile.mVertices) {
 				minBounds.x = std::min(minBounds.x, v.x);
 				minBounds.y = std::min(minBounds.y, v.y);
 				minBounds.z = std::min(minBounds.z, v.z);
@@ -129,145 +293,169 @@ void listChunks()
 				maxBounds.z = std::max(maxBounds.z, v.z);
 			}
 			std::stringstream boundsStr;
-			boundsStr << std::fixed << std::setprecision(2) << gModFile.mVertices.size() << " [Bounds: (" << minBounds.x << ", "
+			boundsStr << std::fixed << std::setprecision(2) << modFile.mVertices.size() << " [Bounds: (" << minBounds.x << ", "
 			          << minBounds.y << ", " << minBounds.z << ") to (" << maxBounds.x << ", " << maxBounds.y << ", " << maxBounds.z
 			          << ")]";
 			printRow("Vertices (0x10):", boundsStr.str());
 		}
-		if (!gModFile.mVertexNormals.empty())
-			printRow("Normals (0x11):", std::to_string(gModFile.mVertexNormals.size()));
-		if (!gModFile.mVertexNbt.empty())
-			printRow("NBT (0x12):", std::to_string(gModFile.mVertexNbt.size()) + " [Normal/Binormal/Tangent vectors]");
-		if (!gModFile.mVertexColours.empty())
-			printRow("Colors (0x13):", std::to_string(gModFile.mVertexColours.size()));
+		if (!modFile.mVertexNormals.empty())
+			printRow("Normals (0x11):", std::to_string(modFile.mVertexNormals.size()));
+		if (!modFile.mVertexNbt.empty())
+			printRow("NBT (0x12):", std::to_string(modFile.mVertexNbt.size()) + " [Normal/Binormal/Tangent vectors]");
+		if (!modFile.mVertexColours.empty())
+			printRow("Colors (0x13):", std::to_string(modFile.mVertexColours.size()));
 		if (totalTexCoords > 0) {
 			for (u32 i = 0; i < 8; ++i) {
-				if (!gModFile.mTextureCoords[i].empty()) {
+				if (!modFile.mTextureCoords[i].empty()) {
 					std::stringstream title;
 					title << "TexCoord" << i << " (0x" << std::hex << (0x18 + i) << std::dec << "):";
-					printRow(title.str(), std::to_string(gModFile.mTextureCoords[i].size()));
+					printRow(title.str(), std::to_string(modFile.mTextureCoords[i].size()));
 				}
 			}
 		}
 	}
 
 	// --- Materials & Textures Section ---
-	const bool hasMtlAndTex = !gModFile.mTextures.empty() || !gModFile.mTextureAttributes.empty() || !gModFile.mMaterials.mMaterials.empty()
-	                       || !gModFile.mMaterials.mTevEnvironmentInfo.empty();
+	const bool hasMtlAndTex = !modFile.mTextures.empty() || !modFile.mTextureAttributes.empty() || !modFile.mMaterials.mMaterials.empty()
+	                       || !modFile.mMaterials.mTevEnvironmentInfo.empty();
 
 	if (hasMtlAndTex) {
-		std::cout << "\n--- Materials & Textures ---\n";
-		if (!gModFile.mTextures.empty()) {
+		session.out() << "\n--- Materials & Textures ---\n";
+		if (!modFile.mTextures.empty()) {
 			std::map<TextureFormat, int> formatCounts;
 			size_t totalBytes = 0;
-			for (const auto& tex : gModFile.mTextures) {
+			for (const auto& tex : modFile.mTextures) {
 				formatCounts[tex.mFormat]++;
 				totalBytes += tex.mImageData.size();
 			}
 			std::stringstream texStr;
-			texStr << gModFile.mTextures.size() << " textures, " << totalBytes << " bytes total. Formats: ";
+			texStr << modFile.mTextures.size() << " textures, " << totalBytes << " bytes total. Formats: ";
 			for (auto const& [format, count] : formatCounts) {
 				// This part would ideally convert format enum to string
 				texStr << count << "x" << static_cast<int>(format) << " ";
 			}
 			printRow("Textures (0x20):", texStr.str());
 		}
-		if (!gModFile.mTextureAttributes.empty())
-			printRow("Tex Attrs (0x22):", std::to_string(gModFile.mTextureAttributes.size()));
-		if (!gModFile.mMaterials.mMaterials.empty()) {
+		if (!modFile.mTextureAttributes.empty())
+			printRow("Tex Attrs (0x22):", std::to_string(modFile.mTextureAttributes.size()));
+		if (!modFile.mMaterials.mMaterials.empty()) {
 			std::set<s16> usedMaterials;
-			for (const auto& joint : gModFile.mJoints) {
+			for (const auto& joint : modFile.mJoints) {
 				for (const auto& poly : joint.mLinkedPolygons) {
 					if (poly.mMaterialIndex >= 0)
 						usedMaterials.insert(poly.mMaterialIndex);
 				}
 			}
-			printRow("Materials (0x30):", std::to_string(gModFile.mMaterials.mMaterials.size()) + " ("
+			printRow("Materials (0x30):", std::to_string(modFile.mMaterials.mMaterials.size()) + " ("
 			                                  + std::to_string(usedMaterials.size()) + " used in geometry)");
 		}
-		if (!gModFile.mMaterials.mTevEnvironmentInfo.empty())
-			printRow("TEV Environments:", std::to_string(gModFile.mMaterials.mTevEnvironmentInfo.size()));
+		if (!modFile.mMaterials.mTevEnvironmentInfo.empty())
+			printRow("TEV Environments:", std::to_string(modFile.mMaterials.mTevEnvironmentInfo.size()));
 	}
 
 	// --- Rigging & Animation Section ---
-	const bool hasRigging = !gModFile.mVertexMatrices.empty() || !gModFile.mVertexEnvelopes.empty();
+	const bool hasRigging = !modFile.mVertexMatrices.empty() || !modFile.mVertexEnvelopes.empty();
 	if (hasRigging) {
-		std::cout << "\n--- Rigging & Animation ---\n";
-		if (!gModFile.mVertexMatrices.empty()) {
+		session.out() << "\n--- Rigging & Animation ---\n";
+		if (!modFile.mVertexMatrices.empty()) {
 			u32 partialWeights = 0;
-			for (const auto& vtxMtx : gModFile.mVertexMatrices) {
+			for (const auto& vtxMtx : modFile.mVertexMatrices) {
 				if (vtxMtx.mHasPartialWeights)
 					partialWeights++;
 			}
-			printRow("Vtx Matrices (0x40):", std::to_string(gModFile.mVertexMatrices.size()) + " [" + std::to_string(partialWeights)
-			                                     + " partial, " + std::to_string(gModFile.mVertexMatrices.size() - partialWeights)
+			printRow("Vtx Matrices (0x40):", std::to_string(modFile.mVertexMatrices.size()) + " [" + std::to_string(partialWeights)
+			                                     + " partial, " + std::to_string(modFile.mVertexMatrices.size() - partialWeights)
 			                                     + " full]");
 		}
-		if (!gModFile.mVertexEnvelopes.empty()) {
+		if (!modFile.mVertexEnvelopes.empty()) {
 			u32 totalInfluences = 0;
-			for (const auto& env : gModFile.mVertexEnvelopes) {
+			for (const auto& env : modFile.mVertexEnvelopes) {
 				totalInfluences += static_cast<u32>(env.mIndices.size());
 			}
-			double avgInfluences = static_cast<double>(totalInfluences) / gModFile.mVertexEnvelopes.size();
+			double avgInfluences = static_cast<double>(totalInfluences) / modFile.mVertexEnvelopes.size();
 			std::stringstream envStr;
-			envStr << gModFile.mVertexEnvelopes.size() << " [Avg " << std::fixed << std::setprecision(1) << avgInfluences
+			envStr << modFile.mVertexEnvelopes.size() << " [Avg " << std::fixed << std::setprecision(1) << avgInfluences
 			       << " influences/vertex]";
 			printRow("Matrix Envelopes (0x41):", envStr.str());
 		}
 	}
 
 	// --- Mesh & Skeleton Section ---
-	const bool hasMeshAndSkel = !gModFile.mMeshes.empty() || !gModFile.mJoints.empty() || !gModFile.mJointNames.empty();
+	const bool hasMeshAndSkel = !modFile.mMeshes.empty() || !modFile.mJoints.empty() || !modFile.mJointNames.empty();
 	if (hasMeshAndSkel) {
-		std::cout << "\n--- Mesh & Skeleton ---\n";
-		if (!gModFile.mMeshes.empty()) {
+		session.out() << "\n--- Mesh & Skeleton ---\n";
+		if (!modFile.mMeshes.empty()) {
 			u32 totalPackets = 0, totalDisplayLists = 0;
-			for (const auto& mesh : gModFile.mMeshes) {
+			for (const auto& mesh : modFile.mMeshes) {
 				totalPackets += static_cast<u32>(mesh.mPackets.size());
 				for (const auto& packet : mesh.mPackets) {
 					totalDisplayLists += static_cast<u32>(packet.mDisplayLists.size());
 				}
 			}
-			printRow("Meshes (0x50):", std::to_string(gModFile.mMeshes.size()) + " [" + std::to_string(totalPackets) + " packets, "
+			printRow("Meshes (0x50):", std::to_string(modFile.mMeshes.size()) + " [" + std::to_string(totalPackets) + " packets, "
 			                               + std::to_string(totalDisplayLists) + " display lists]");
 		}
-		if (!gModFile.mJoints.empty()) {
+		if (!modFile.mJoints.empty()) {
 			u32 totalPolygons = 0;
-			for (const auto& joint : gModFile.mJoints) {
+			for (const auto& joint : modFile.mJoints) {
 				totalPolygons += static_cast<u32>(joint.mLinkedPolygons.size());
 			}
-			printRow("Joints (0x60):", std::to_string(gModFile.mJoints.size()) + " [" + std::to_string(totalPolygons) + " polygon links]");
+			printRow("Joints (0x60):", std::to_string(modFile.mJoints.size()) + " [" + std::to_string(totalPolygons) + " polygon links]");
 		}
-		if (!gModFile.mJointNames.empty())
-			printRow("Joint Names (0x61):", std::to_string(gModFile.mJointNames.size()));
+		if (!modFile.mJointNames.empty())
+			printRow("Joint Names (0x61):", std::to_string(modFile.mJointNames.size()));
 	}
 
 	// --- Collision Section ---
-	if (!gModFile.mCollisionTriangles.mCollInfo.empty()) {
-		std::cout << "\n--- Collision ---\n";
-		printRow("Coll Tris (0x100):", std::to_string(gModFile.mCollisionTriangles.mCollInfo.size()));
-		if (!gModFile.mCollisionTriangles.mRoomInfo.empty())
-			printRow("Rooms:", std::to_string(gModFile.mCollisionTriangles.mRoomInfo.size()));
-		if (gModFile.mCollisionGridInfo.mCellCountX > 0) {
+	if (!modFile.mCollisionTriangles.mCollInfo.empty()) {
+		session.out() << "\n--- Collision ---\n";
+		printRow("Coll Tris (0x100):", std::to_string(modFile.mCollisionTriangles.mCollInfo.size()));
+		if (!modFile.mCollisionTriangles.mRoomInfo.empty())
+			printRow("Rooms:", std::to_string(modFile.mCollisionTriangles.mRoomInfo.size()));
+		if (modFile.mCollisionGridInfo.mCellCountX > 0) {
 			std::stringstream gridStr;
-			gridStr << "Enabled [" << gModFile.mCollisionGridInfo.mCellCountX << "x" << gModFile.mCollisionGridInfo.mCellCountY
-			        << " cells, " << gModFile.mCollisionGridInfo.mGroups.size() << " groups]";
+			gridStr << "Enabled [" << modFile.mCollisionGridInfo.mCellCountX << "x" << modFile.mCollisionGridInfo.mCellCountY
+			        << " cells, " << modFile.mCollisionGridInfo.mGroups.size() << " groups]";
 			printRow("Coll Grid (0x110):", gridStr.str());
 		}
 	}
 
 	// --- Miscellaneous Section ---
-	if (!gModFile.mEndOfFileData.empty()) {
-		std::cout << "\n--- Miscellaneous ---\n";
-		printRow("End of File (0xFFFF):", std::to_string(gModFile.mEndOfFileData.size()) + " bytes [INI/Config data]");
+	if (!modFile.mEndOfFileData.empty()) {
+		session.out() << "\n--- Miscellaneous ---\n";
+		printRow("End of File (0xFFFF):", std::to_string(modFile.mEndOfFileData.size()) + " bytes [INI/Config data]");
+	}
+
+	// --- Memory Section ---
+	session.out() << "\n--- Memory ---\n";
+	if (util::alloc_stats::available()) {
+		session.out() << std::left << std::setw(8) << "Opcode" << std::setw(12) << "File" << std::setw(12) << "Heap" << std::setw(10)
+		              << "Allocs" << std::setw(10) << "Heap/File" << "Name\n";
+		for (const MOD::ChunkEntry& entry : modFile.mChunkDirectory) {
+			const std::size_t fileBytes = static_cast<std::size_t>(entry.mLength) + 8;
+
+			std::stringstream opcode, ratio;
+			opcode << "0x" << std::hex << std::uppercase << entry.mOpcode;
+			ratio << std::fixed << std::setprecision(2) << static_cast<double>(entry.mHeapBytes) / fileBytes << "x";
+
+			session.out() << std::left << std::setw(8) << opcode.str() << std::setw(12) << fileBytes << std::setw(12) << entry.mHeapBytes
+			              << std::setw(10) << entry.mAllocations << std::setw(10) << ratio.str()
+			              << MOD::getChunkName(entry.mOpcode).value_or("Unknown chunk") << '\n';
+		}
+	} else {
+		session.out() << "Configure with -DMODCONV_TRACK_ALLOCATIONS=ON to count the heap each chunk takes up once decoded\n";
 	}
 
+	std::stringstream residentStr;
+	residentStr << std::fixed << std::setprecision(1) << util::alloc_stats::peakResidentBytes() / (1024.0 * 1024.0) << " MB";
+	printRow("Peak Resident:", residentStr.str());
+
 	// --- Empty Chunks Tracking (for debugging) ---
-	if (!gModFile.mEmptyChunks.empty()) {
-		std::cout << "\n--- Diagnostics ---\n";
+	if (!modFile.mEmptyChunks.empty()) {
+		session.out() << "\n--- Diagnostics ---\n";
 		std::stringstream emptyStream;
 		bool first = true;
-		for (const auto& chunk : gModFile.mEmptyChunks) {
+		for (const auto& chunk : modFile.mEmptyChunks) {
 			if (!first)
 				emptyStream << ", ";
 			emptyStream << "0x" << std::hex << static_cast<u32>(chunk) << std::dec;
@@ -275,52 +463,59 @@ void listChunks()
 		}
 		printRow("Empty Chunks Found:", emptyStream.str());
 	}
+
+	return {};
 }
 
-void importTexture()
+Status importTexture(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
-	}
+	MOD& modFile = session.mModFile;
 
-	if (gModFile.mTextures.empty()) {
-		std::cout << "Loaded MOD file has no textures" << '\n';
-		return;
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	for (u32 i = 0; i < gModFile.mTextures.size(); i++) {
-		std::cout << "Texture [" << i << "]" << '\n';
+	modFile.decode(MOD::EChunkType::Texture);
+	if (modFile.mTextures.empty()) {
+		return Status::error("Loaded MOD file has no textures");
 	}
-	std::cout << "Which one do you want to swap? (number): ";
 
-	std::string input;
-	std::getline(std::cin, input);
+	// Both arguments can be given up front, otherwise ask for them
+	const Status missing = Status::error("import_tex needs its values as arguments here: <texture index> <TXE file>");
+
+	std::string index;
+	if (session.mTokeniser.isEnd() && session.mIn != nullptr) {
+		for (u32 i = 0; i < modFile.mTextures.size(); i++) {
+			session.out() << "Texture [" << i << "]" << '\n';
+		}
+	}
+	if (!nextOrAsk(session, "Which one do you want to swap? (number): ", index)) {
+		return missing;
+	}
 
 	try {
-		const u32 toSwap = std::stoi(input);
-		if (toSwap >= gModFile.mTextures.size()) {
-			std::cout << "Error given index is incorrect!" << '\n';
-			return;
+		const u32 toSwap = std::stoi(index);
+		if (toSwap >= modFile.mTextures.size()) {
+			return Status::error("Error given index is incorrect!");
+		}
+
+		std::string input;
+		if (!nextOrAsk(session, "Path of the TXE file you want to replace Texture " + std::to_string(toSwap) + " with: ", input)) {
+			return missing;
 		}
 
-		std::cout << "Path of the TXE file you want to replace Texture " << toSwap << " with: ";
-		std::getline(std::cin, input);
 		if (!std::filesystem::exists(input)) {
-			std::cout << "Error invalid path given!" << '\n';
-			return;
+			return Status::error("Error invalid path given!");
 		}
 
 		if (std::filesystem::path(input).extension() != ".txe") {
-			std::cout << "Error path is not a TXE file!" << '\n';
-			return;
+			return Status::error("Error path is not a TXE file!");
 		}
 
 		util::fstream_reader txeReader;
 		txeReader.open(input, std::ios_base::binary);
 		if (!txeReader.is_open()) {
-			std::cout << "Error couldn't open file!" << '\n';
-			return;
+			return Status::error("Error couldn't open file!");
 		}
 
 		Texture texture;
@@ -335,71 +530,82 @@ void importTexture()
 		texture.mImageData.resize(util::CalculateTxeSize((u32)texture.mFormat, texture.mWidth, texture.mHeight));
 		txeReader.read(reinterpret_cast<char*>(texture.mImageData.data()), texture.mImageData.size());
 		txeReader.close();
-		gModFile.mTextures[toSwap] = texture;
+		modFile.mTextures[toSwap] = texture;
 	} catch (...) {
-		std::cout << "Error while trying to swap textures!" << '\n';
+		return Status::error("Error while trying to swap textures!");
+	}
+
+	if (modFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
 
-	std::cout << "Done!" << '\n';
+	return {};
 }
 
-void importIni()
+Status importIni(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	const std::string& filename = gTokeniser.next();
+	const std::string& filename = session.mTokeniser.next();
 	std::ifstream inStream(filename);
 	if (!inStream.is_open()) {
-		std::cout << "Error can't open " << filename << '\n';
-		return;
+		return Status::error("Error can't open " + filename);
 	}
 
-	gModFile.mEndOfFileData.clear();
+	session.mModFile.mEndOfFileData.clear();
 	std::string str((std::istreambuf_iterator<char>(inStream)), std::istreambuf_iterator<char>());
 	for (const auto& c : str) {
-		gModFile.mEndOfFileData.push_back(c);
+		session.mModFile.mEndOfFileData.push_back(c);
+	}
+
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
 
-	std::cout << "Done!" << '\n';
+	return {};
 }
 
-void exportObj()
+Status exportObj(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << std::endl;
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	if (gModFile.mVertices.empty()) {
-		std::cout << "Loaded file has no vertex data to export!" << std::endl;
-		return;
+	modFile.decodeAll();
+
+	if (modFile.mVertices.empty()) {
+		return Status::ok("Loaded file has no vertex data to export!");
 	}
 
-	const std::string& filename = gTokeniser.isEnd() ? gModFileName + ".obj" : gTokeniser.next();
-	std::ofstream os(filename);
-	if (!os.is_open()) {
-		std::cout << "Error can't open " << filename << std::endl;
-		return;
+	const std::string& filename = session.mTokeniser.isEnd() ? session.mModFileName + ".obj" : session.mTokeniser.next();
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		return Status::error("Error can't open " + filename);
 	}
 
+	// Floats keep the 6 significant digits iostreams default to
+	util::text_writer os(file);
+	os.setFloatFormat(std::chars_format::general, 6);
+
 	os << "# Exported with MODConv\n";
-	os << "# Date: " << (u32)gModFile.mHeader.mDateTime.mYear << "/" << (u32)gModFile.mHeader.mDateTime.mMonth << "/"
-	   << (u32)gModFile.mHeader.mDateTime.mDay << "\n\n";
+	os << "# Date: " << (u32)modFile.mHeader.mDateTime.mYear << "/" << (u32)modFile.mHeader.mDateTime.mMonth << "/"
+	   << (u32)modFile.mHeader.mDateTime.mDay << "\n\n";
 
 	// Export vertices
-	os << "# Vertices (" << gModFile.mVertices.size() << ")\n";
-	for (const auto& v : gModFile.mVertices) {
+	os << "# Vertices (" << modFile.mVertices.size() << ")\n";
+	for (const auto& v : modFile.mVertices) {
 		os << "v " << v.x << " " << v.y << " " << v.z << "\n";
 	}
 	os << "\n";
 
 	// Export vertex normals
-	if (!gModFile.mVertexNormals.empty()) {
-		os << "# Vertex normals (" << gModFile.mVertexNormals.size() << ")\n";
-		for (const auto& vn : gModFile.mVertexNormals) {
+	if (!modFile.mVertexNormals.empty()) {
+		os << "# Vertex normals (" << modFile.mVertexNormals.size() << ")\n";
+		for (const auto& vn : modFile.mVertexNormals) {
 			os << "vn " << vn.x << " " << vn.y << " " << vn.z << "\n";
 		}
 		os << "\n";
@@ -414,7 +620,7 @@ void exportObj()
 		os << "# Texture coordinates (all sets merged)\n";
 		for (int i = 0; i < 8; ++i) {
 			texCoordOffsets[i]    = totalTexCoords;
-			const auto& texCoords = gModFile.mTextureCoords[i];
+			const auto& texCoords = modFile.mTextureCoords[i];
 
 			if (!texCoords.empty()) {
 				anyTexCoordsExported = true;
@@ -432,15 +638,17 @@ void exportObj()
 	}
 
 	// Create material library reference if we have materials
-	if (!gModFile.mMaterials.mMaterials.empty()) {
+	if (!modFile.mMaterials.mMaterials.empty()) {
 		std::string mtlFilename = std::filesystem::path(filename).stem().string() + ".mtl";
 		os << "mtllib " << mtlFilename << "\n\n";
 
 		// Export material file
-		std::ofstream mtlFile(std::filesystem::path(filename).parent_path() / mtlFilename);
-		if (mtlFile.is_open()) {
-			for (size_t i = 0; i < gModFile.mMaterials.mMaterials.size(); ++i) {
-				const auto& mat = gModFile.mMaterials.mMaterials[i];
+		std::ofstream mtlStream(std::filesystem::path(filename).parent_path() / mtlFilename);
+		if (mtlStream.is_open()) {
+			util::text_writer mtlFile(mtlStream);
+			mtlFile.setFloatFormat(std::chars_format::general, 6);
+			for (size_t i = 0; i < modFile.mMaterials.mMaterials.size(); ++i) {
+				const auto& mat = modFile.mMaterials.mMaterials[i];
 				mtlFile << "newmtl material_" << i << "\n";
 
 				float r = mat.mColourInfo.mDiffuseColour.r / 255.0f;
@@ -469,60 +677,90 @@ void exportObj()
 					mtlFile << "illum 2\n";
 				}
 
-				if (mat.mTextureIndex >= 0 && mat.mTextureIndex < gModFile.mTextures.size()) {
+				if (mat.mTextureIndex >= 0 && mat.mTextureIndex < modFile.mTextures.size()) {
 					mtlFile << "# Texture index: " << mat.mTextureIndex << "\n";
 				}
 
 				mtlFile << "\n";
 			}
-			mtlFile.close();
+			mtlFile.flush();
 		}
 	}
 
 	// Parse and export mesh data using DisplayListReader
 	os << "# Mesh data\n";
-	u32 meshIndex  = 0;
 	u32 totalFaces = 0;
 
 	std::set<s16> usedMaterials;
 
-	for (const auto& mesh : gModFile.mMeshes) {
-		os << "g mesh_" << meshIndex << "\n";
-		os << "# Bone index: " << mesh.mBoneIndex << "\n";
-		os << "# Vertex descriptor: 0x" << std::hex << mesh.mVtxDescriptor << std::dec << "\n";
+	// The vertex matrix each position is drawn with in skinned meshes, the first one wins if there are several
+	constexpr u32 NoMatrix = 0xFFFFFFFF;
+	std::vector<u32> positionMatrices(modFile.mVertices.size(), NoMatrix);
+
+	// OBJ indices point straight into the shared vertex arrays, so every mesh can be formatted on its own
+	struct MeshText {
+		std::string mText;
+		u32 mFaces = 0;
+		std::set<s16> mMaterials;
+		std::vector<std::pair<u32, u32>> mPositionMatrices; // The first matrix of each position within this mesh
+	};
+
+	const bool hasNormal = (!modFile.mVertexNormals.empty() || !modFile.mVertexNbt.empty());
+
+	std::vector<MeshText> meshTexts(modFile.mMeshes.size());
+	util::parallel_for(modFile.mMeshes.size(), modFile.mJobs, [&](std::size_t meshIndex) {
+		const Mesh& mesh = modFile.mMeshes[meshIndex];
+		MeshText& result = meshTexts[meshIndex];
 
-		const bool hasNormal = (!gModFile.mVertexNormals.empty() || !gModFile.mVertexNbt.empty());
+		util::text_writer out;
+		out << "g mesh_" << meshIndex << "\n";
+		out << "# Bone index: " << mesh.mBoneIndex << "\n";
+		out << "# Vertex descriptor: 0x";
+		out.writeHex(mesh.mVtxDescriptor) << "\n";
 
 		std::vector<bool> hasTexCoord(8);
 		for (int i = 0; i < 8; i++) {
 			hasTexCoord[i] = (mesh.mVtxDescriptor & (1 << (i + 3))) != 0;
 		}
 
+		std::vector<bool> matrixSeen;
+		if (mesh.mVtxDescriptor & VCD::MatrixIndex) {
+			matrixSeen.resize(positionMatrices.size());
+		}
+
+		// A packet's -1 slots keep the matrix an earlier packet of the mesh loaded
+		std::vector<s16> loadedMatrices;
 		for (size_t packetIdx = 0; packetIdx < mesh.mPackets.size(); ++packetIdx) {
 			const auto& packet = mesh.mPackets[packetIdx];
+			loadedMatrices.resize(std::max(loadedMatrices.size(), packet.mIndices.size()), -1);
+			for (std::size_t slot = 0; slot < packet.mIndices.size(); ++slot) {
+				if (packet.mIndices[slot] >= 0) {
+					loadedMatrices[slot] = packet.mIndices[slot];
+				}
+			}
 
 			// Handle material assignment
 			s16 currentMaterialIndex = -1;
 			if (!packet.mIndices.empty()) {
 				s16 potentialMatIdx = packet.mIndices[0];
-				if (potentialMatIdx >= 0 && potentialMatIdx < gModFile.mMaterials.mMaterials.size()) {
+				if (potentialMatIdx >= 0 && potentialMatIdx < modFile.mMaterials.mMaterials.size()) {
 					currentMaterialIndex = potentialMatIdx;
-					usedMaterials.insert(currentMaterialIndex);
-					os << "usemtl material_" << currentMaterialIndex << "\n";
+					result.mMaterials.insert(currentMaterialIndex);
+					out << "usemtl material_" << currentMaterialIndex << "\n";
 				}
 			}
 
-			if (currentMaterialIndex == -1 && mesh.mBoneIndex < gModFile.mJoints.size()) {
-				const Joint& joint = gModFile.mJoints[mesh.mBoneIndex];
+			if (currentMaterialIndex == -1 && mesh.mBoneIndex < modFile.mJoints.size()) {
+				const Joint& joint = modFile.mJoints[mesh.mBoneIndex];
 				for (const auto& matPoly : joint.mLinkedPolygons) {
 					if (static_cast<u32>(matPoly.mMeshIndex) != meshIndex) {
 						continue;
 					}
 
 					currentMaterialIndex = matPoly.mMaterialIndex;
-					if (currentMaterialIndex >= 0 && currentMaterialIndex < gModFile.mMaterials.mMaterials.size()) {
-						usedMaterials.insert(currentMaterialIndex);
-						os << "usemtl material_" << currentMaterialIndex << "\n";
+					if (currentMaterialIndex >= 0 && currentMaterialIndex < modFile.mMaterials.mMaterials.size()) {
+						result.mMaterials.insert(currentMaterialIndex);
+						out << "usemtl material_" << currentMaterialIndex << "\n";
 					}
 
 					break;
@@ -531,99 +769,149 @@ void exportObj()
 
 			// Process display lists using DisplayListReader
 			for (const auto& dlist : packet.mDisplayLists) {
-				util::vector_reader reader(dlist.mData, 0, util::vector_reader::Endianness::Big);
+				util::span_reader reader(dlist.mData);
 				DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
-				auto batches = dlReader.parse();
-
-				// Export all triangles from parsed batches
-				for (const auto& batch : batches) {
-					for (const auto& tri : batch.getTriangles()) {
-						// Build face string for each vertex
-						std::vector<std::string> faceVertices;
-
-						for (int v = 0; v < 3; ++v) {
-							const VertexAttrib& vertex = tri[v];
-							std::string vertexStr;
-
-							// Position index (always present, 1-based for OBJ)
-							vertexStr = std::to_string(vertex.mPosition + 1);
-
-							// Find first valid texcoord
-							u32 texIdx          = 0;
-							bool hasAnyTexCoord = false;
-							for (int i = 0; i < 8; i++) {
-								if (hasTexCoord[i] && vertex.mTexcoords[i] != 0) {
-									texIdx         = static_cast<u32>(vertex.mTexcoords[i]) + texCoordOffsets[i];
-									hasAnyTexCoord = true;
-									break;
-								}
-							}
 
-							// Build vertex string (pos/tex/normal format)
-							if (hasAnyTexCoord && hasNormal) {
-								vertexStr += "/" + std::to_string(texIdx + 1) + "/" + std::to_string(vertex.mNormal + 1);
-							} else if (hasAnyTexCoord) {
-								vertexStr += "/" + std::to_string(texIdx + 1);
-							} else if (hasNormal) {
-								vertexStr += "//" + std::to_string(vertex.mNormal + 1);
-							}
+				// Triangles are written as they are decoded, nothing is kept per batch or per face
+				dlReader.forEachTriangle([&](const Triangle& tri) {
+					out << "f";
+					for (int v = 0; v < 3; ++v) {
+						const VertexAttrib& vertex = tri[v];
 
-							faceVertices.push_back(vertexStr);
+						// Position index (always present, 1-based for OBJ)
+						out << " " << (vertex.mPosition + 1);
+
+						const u32 slot = vertex.mMatrixIndex / 3u;
+						if (vertex.mPosition < matrixSeen.size() && !matrixSeen[vertex.mPosition] && slot < loadedMatrices.size()
+						    && loadedMatrices[slot] >= 0) {
+							matrixSeen[vertex.mPosition] = true;
+							result.mPositionMatrices.emplace_back(vertex.mPosition, static_cast<u32>(loadedMatrices[slot]));
+						}
+
+						// Find first valid texcoord
+						u32 texIdx          = 0;
+						bool hasAnyTexCoord = false;
+						for (int i = 0; i < 8; i++) {
+							if (hasTexCoord[i] && vertex.mTexcoords[i] != 0) {
+								texIdx         = static_cast<u32>(vertex.mTexcoords[i]) + texCoordOffsets[i];
+								hasAnyTexCoord = true;
+								break;
+							}
 						}
 
-						// Write the triangle
-						os << "f " << faceVertices[0] << " " << faceVertices[1] << " " << faceVertices[2] << "\n";
-						totalFaces++;
+						// Vertex reference (pos/tex/normal format)
+						if (hasAnyTexCoord && hasNormal) {
+							out << "/" << (texIdx + 1) << "/" << (vertex.mNormal + 1);
+						} else if (hasAnyTexCoord) {
+							out << "/" << (texIdx + 1);
+						} else if (hasNormal) {
+							out << "//" << (vertex.mNormal + 1);
+						}
 					}
-				}
+
+					// Write the triangle
+					out << "\n";
+					result.mFaces++;
+				});
 			}
 		}
 
+		out << "\n";
+		result.mText = out.takeBuffer();
+	});
+
+	// Stitch the meshes back together in their original order
+	for (MeshText& meshText : meshTexts) {
+		os << meshText.mText;
+		totalFaces += meshText.mFaces;
+		usedMaterials.merge(meshText.mMaterials);
+		for (const auto& [position, matrix] : meshText.mPositionMatrices) {
+			if (positionMatrices[position] == NoMatrix) {
+				positionMatrices[position] = matrix;
+			}
+		}
+
+		meshText = {};
+	}
+
+	// Skinning isn't part of OBJ, '#vw <vertex> <joint> <weight>...' comments carry it for import_obj and other readers skip them
+	bool wroteWeights = false;
+	for (std::size_t position = 0; position < positionMatrices.size(); ++position) {
+		const u32 matrix = positionMatrices[position];
+		if (matrix >= modFile.mVertexMatrices.size()) {
+			continue;
+		}
+
+		if (!wroteWeights) {
+			os << "# Vertex weights\n";
+			wroteWeights = true;
+		}
+
+		os << "#vw " << (position + 1);
+		const VtxMatrix& vtxMatrix = modFile.mVertexMatrices[matrix];
+		if (vtxMatrix.mHasPartialWeights) {
+			os << " " << vtxMatrix.mIndex << " 1";
+		} else if (vtxMatrix.mIndex < modFile.mVertexEnvelopes.size()) {
+			const Envelope& envelope = modFile.mVertexEnvelopes[vtxMatrix.mIndex];
+			for (std::size_t i = 0; i < std::min(envelope.mIndices.size(), envelope.mWeights.size()); ++i) {
+				os << " " << envelope.mIndices[i] << " " << envelope.mWeights[i];
+			}
+		}
+		os << "\n";
+	}
+	if (wroteWeights) {
 		os << "\n";
-		meshIndex++;
 	}
 
 	// Export collision mesh if present
-	if (!gModFile.mCollisionTriangles.mCollInfo.empty()) {
+	if (!modFile.mCollisionTriangles.mCollInfo.empty()) {
 		os << "g collision_mesh\n";
-		os << "# Collision triangles (" << gModFile.mCollisionTriangles.mCollInfo.size() << ")\n";
+		os << "# Collision triangles (" << modFile.mCollisionTriangles.mCollInfo.size() << ")\n";
 
-		for (const auto& tri : gModFile.mCollisionTriangles.mCollInfo) {
+		for (const auto& tri : modFile.mCollisionTriangles.mCollInfo) {
 			os << "f " << (tri.mVertexIndexA + 1) << " " << (tri.mVertexIndexB + 1) << " " << (tri.mVertexIndexC + 1) << "\n";
 			totalFaces++;
 		}
 	}
 
-	os.close();
+	os.flush();
+	file.close();
 
-	std::cout << "Done! Exported " << totalFaces << " faces to " << filename << std::endl;
-	if (!gModFile.mMaterials.mMaterials.empty()) {
-		std::cout << "Exported " << gModFile.mMaterials.mMaterials.size() << " materials (";
-		std::cout << usedMaterials.size() << " used) to " << std::filesystem::path(filename).stem().string() << ".mtl" << std::endl;
+	if (modFile.mVerbosePrint) {
+		session.out() << "Done! Exported " << totalFaces << " faces to " << filename << std::endl;
+		if (!modFile.mMaterials.mMaterials.empty()) {
+			session.out() << "Exported " << modFile.mMaterials.mMaterials.size() << " materials (";
+			session.out() << usedMaterials.size() << " used) to " << std::filesystem::path(filename).stem().string() << ".mtl" << std::endl;
+		}
 	}
+
+	return {};
 }
 
-void importObj()
+Status importObj(Session& session)
 {
-	if (gTokeniser.isEnd()) {
-		std::cout << "OBJ filename not provided!" << std::endl;
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (session.mTokeniser.isEnd()) {
+		return Status::error("OBJ filename not provided!");
 	}
 
-	std::string objFile = gTokeniser.next();
+	std::string objFile = session.mTokeniser.next();
 	std::ifstream inputFile(objFile);
 	if (!inputFile.is_open()) {
-		std::cout << "Error: can't open " << objFile << std::endl;
-		return;
+		return Status::error("Error: can't open " + objFile);
 	}
 
+	// Everything that isn't replaced below is kept as is
+	modFile.decodeAll();
+
 	// Clear existing geometry data
-	gModFile.mVertices.clear();
-	gModFile.mVertexNormals.clear();
-	for (auto& texCoords : gModFile.mTextureCoords) {
+	modFile.mVertices.clear();
+	modFile.mVertexNormals.clear();
+	for (auto& texCoords : modFile.mTextureCoords) {
 		texCoords.clear();
 	}
-	gModFile.mMeshes.clear();
+	modFile.mMeshes.clear();
 
 	// Parse OBJ file
 	std::vector<Vector3f> tempVertices;
@@ -648,8 +936,13 @@ void importObj()
 		}
 	};
 
-	std::unordered_map<IndexedVertex, u16, IndexedVertexHash> vertexMap;
-	std::vector<std::vector<u16>> meshFaces;
+	std::unordered_map<IndexedVertex, u32, IndexedVertexHash> vertexMap;
+	std::vector<u32> triangleIndices; // Three per triangle, polygons are split into fans
+	std::vector<int> weldedPositions; // The OBJ position each welded vertex came from
+	std::size_t faceCount = 0;
+
+	// Joint influences from '#vw <vertex> <joint> <weight>...' lines, as written by export_obj
+	std::unordered_map<int, std::vector<std::pair<u32, f32>>> positionWeights;
 
 	std::string line;
 	while (std::getline(inputFile, line)) {
@@ -673,8 +966,19 @@ void importObj()
 			float u = std::stof(tokeniser.next());
 			float v = 1.0f - std::stof(tokeniser.next()); // Flip Y for MOD format
 			tempTexCoords.push_back({ u, v });
+		} else if (type == "#vw") {
+			const int position = std::stoi(tokeniser.next()) - 1;
+			auto& influences   = positionWeights[position];
+			while (!tokeniser.isEnd()) {
+				const u32 joint = static_cast<u32>(std::stoul(tokeniser.next()));
+				if (joint >= modFile.mJoints.size()) {
+					return Status::error("Error: " + objFile + " weights vertex " + std::to_string(position + 1) + " to joint "
+					                     + std::to_string(joint) + ", the model has " + std::to_string(modFile.mJoints.size()));
+				}
+				influences.emplace_back(joint, std::stof(tokeniser.next()));
+			}
 		} else if (type == "f") {
-			std::vector<u16> faceIndices;
+			std::vector<u32> faceIndices;
 
 			while (!tokeniser.isEnd()) {
 				std::string vertexStr = tokeniser.next();
@@ -700,26 +1004,27 @@ void importObj()
 
 				// Get or create vertex index
 				auto it = vertexMap.find(vertex);
-				u16 index;
+				u32 index;
 				if (it == vertexMap.end()) {
-					index             = static_cast<u16>(gModFile.mVertices.size());
+					index             = static_cast<u32>(modFile.mVertices.size());
 					vertexMap[vertex] = index;
+					weldedPositions.push_back(vertex.posIdx);
 
 					// Add vertex data
-					gModFile.mVertices.push_back(tempVertices[vertex.posIdx]);
+					modFile.mVertices.push_back(tempVertices[vertex.posIdx]);
 
 					if (vertex.nrmIdx >= 0) {
-						if (gModFile.mVertexNormals.size() < gModFile.mVertices.size()) {
-							gModFile.mVertexNormals.resize(gModFile.mVertices.size());
+						if (modFile.mVertexNormals.size() < modFile.mVertices.size()) {
+							modFile.mVertexNormals.resize(modFile.mVertices.size());
 						}
-						gModFile.mVertexNormals[index] = tempNormals[vertex.nrmIdx];
+						modFile.mVertexNormals[index] = tempNormals[vertex.nrmIdx];
 					}
 
 					if (vertex.texIdx >= 0) {
-						if (gModFile.mTextureCoords[0].size() < gModFile.mVertices.size()) {
-							gModFile.mTextureCoords[0].resize(gModFile.mVertices.size());
+						if (modFile.mTextureCoords[0].size() < modFile.mVertices.size()) {
+							modFile.mTextureCoords[0].resize(modFile.mVertices.size());
 						}
-						gModFile.mTextureCoords[0][index] = tempTexCoords[vertex.texIdx];
+						modFile.mTextureCoords[0][index] = tempTexCoords[vertex.texIdx];
 					}
 				} else {
 					index = it->second;
@@ -728,88 +1033,194 @@ void importObj()
 				faceIndices.push_back(index);
 			}
 
-			meshFaces.push_back(faceIndices);
+			for (std::size_t i = 2; i < faceIndices.size(); ++i) {
+				triangleIndices.insert(triangleIndices.end(), { faceIndices[0], faceIndices[i - 1], faceIndices[i] });
+			}
+			faceCount++;
 		}
 	}
 
 	inputFile.close();
 
-	// Create mesh from faces
-	if (!meshFaces.empty()) {
-		Mesh mesh;
-		mesh.mBoneIndex = 0;
+	// Display lists address vertices with 16-bit indices
+	if (modFile.mVertices.size() > 0x10000) {
+		return Status::error("Error: " + objFile + " has " + std::to_string(modFile.mVertices.size())
+		                     + " unique vertices, a MOD can only address 65536");
+	}
+
+	// Skinned models get a vertex matrix for every distinct set of joint influences
+	std::vector<u32> vertexMatrices; // Per welded vertex
+	if (!positionWeights.empty()) {
+		modFile.mVertexMatrices.clear();
+		modFile.mVertexEnvelopes.clear();
+
+		std::map<std::vector<std::pair<u32, f32>>, u32> matrixOf;
+		vertexMatrices.resize(modFile.mVertices.size());
+		for (std::size_t v = 0; v < vertexMatrices.size(); ++v) {
+			// Vertices without weights follow the root joint, repeated joints are merged and the weights normalised
+			std::map<u32, f32> merged;
+			if (auto it = positionWeights.find(weldedPositions[v]); it != positionWeights.end()) {
+				for (const auto& [joint, weight] : it->second) {
+					if (weight > 0.0f) {
+						merged[joint] += weight;
+					}
+				}
+			}
+			if (merged.empty()) {
+				merged[0] = 1.0f;
+			}
 
-		// Set vertex descriptor based on what data we have
-		mesh.mVtxDescriptor = 0;
-		if (!gModFile.mVertexNormals.empty()) {
-			mesh.mVtxDescriptor |= (1 << 11); // Has normals
-		}
-		if (!gModFile.mTextureCoords[0].empty()) {
-			mesh.mVtxDescriptor |= (1 << 3); // Has texcoord0
-		}
+			f32 total = 0.0f;
+			for (const auto& [joint, weight] : merged) {
+				total += weight;
+			}
+
+			std::vector<std::pair<u32, f32>> influences;
+			for (const auto& [joint, weight] : merged) {
+				influences.emplace_back(joint, weight / total);
+			}
 
-		// Create a single packet with all faces
-		MeshPacket packet;
+			const auto [it, inserted] = matrixOf.try_emplace(influences, static_cast<u32>(modFile.mVertexMatrices.size()));
+			if (inserted) {
+				if (influences.size() == 1) {
+					modFile.mVertexMatrices.push_back({ influences[0].first, true });
+				} else {
+					Envelope envelope;
+					for (const auto& [joint, weight] : influences) {
+						envelope.mIndices.push_back(static_cast<s16>(joint));
+						envelope.mWeights.push_back(weight);
+					}
+					modFile.mVertexMatrices.push_back({ static_cast<u32>(modFile.mVertexEnvelopes.size()), false });
+					modFile.mVertexEnvelopes.push_back(std::move(envelope));
+				}
+			}
+			vertexMatrices[v] = it->second;
+		}
 
-		// Convert faces to triangle strips (simple conversion)
-		DisplayList dlist;
-		dlist.mFlags = DLFlags::Back;
+		// Packets refer to them with 16-bit indices
+		if (modFile.mVertexMatrices.size() > 0x8000) {
+			return Status::error("Error: " + objFile + " needs " + std::to_string(modFile.mVertexMatrices.size())
+			                     + " different vertex weightings, a MOD can only hold 32768");
+		}
+	}
 
-		for (const auto& face : meshFaces) {
-			if (face.size() >= 3) {
-				// Use triangle primitive (0xA8)
-				dlist.mData.push_back(0xA8);
+	std::size_t stripCount  = 0;
+	std::size_t listCount   = 0;
+	std::size_t matrixLoads = 0;
+	auto stripify           = [&](const std::vector<u32>& indices) {
+		std::vector<DListUtils::IndexedPrimitive> primitives = DListUtils::stripify(indices);
+		for (const DListUtils::IndexedPrimitive& primitive : primitives) {
+			(primitive.mType == PrimitiveType::TriangleStrip ? stripCount : listCount)++;
+		}
+		return primitives;
+	};
 
-				// Vertex count (as u16)
-				u16 vertCount = static_cast<u16>(face.size());
-				dlist.mData.push_back((vertCount >> 8) & 0xFF);
-				dlist.mData.push_back(vertCount & 0xFF);
+	if (!triangleIndices.empty()) {
+		Mesh mesh;
+		mesh.mBoneIndex     = 0;
+		mesh.mVtxDescriptor = modFile.mTextureCoords[0].empty() ? 0u : static_cast<u32>(VCD::Tex0);
+		if (!vertexMatrices.empty()) {
+			mesh.mVtxDescriptor |= VCD::MatrixIndex;
+		}
 
-				// Write vertex indices
-				for (u16 idx : face) {
-					// Position index
-					dlist.mData.push_back((idx >> 8) & 0xFF);
-					dlist.mData.push_back(idx & 0xFF);
+		// Every attribute of a welded vertex shares its index, normals are always part of the vertex
+		const bool hasNormals   = !modFile.mVertexNormals.empty();
+		const bool hasTexCoords = (mesh.mVtxDescriptor & VCD::Tex0) != 0;
+		std::vector<VertexAttrib> vertices(modFile.mVertices.size());
+		for (std::size_t i = 0; i < vertices.size(); ++i) {
+			vertices[i].mPosition     = static_cast<u16>(i);
+			vertices[i].mNormal       = hasNormals ? static_cast<u16>(i) : 0;
+			vertices[i].mTexcoords[0] = hasTexCoords ? static_cast<u16>(i) : 0;
+		}
 
-					// Normal index (if present)
-					if (!gModFile.mVertexNormals.empty()) {
-						dlist.mData.push_back((idx >> 8) & 0xFF);
-						dlist.mData.push_back(idx & 0xFF);
+		if (vertexMatrices.empty()) {
+			// Keeps packets to a handful of display lists
+			constexpr std::size_t MaxDisplayListsPerPacket = 8;
+
+			std::vector<DisplayList> dlists
+			    = DListUtils::encodeDisplayLists(stripify(triangleIndices), vertices, mesh.mVtxDescriptor, DLFlags::Back);
+			for (std::size_t i = 0; i < dlists.size(); i += MaxDisplayListsPerPacket) {
+				MeshPacket packet;
+				const std::size_t end = std::min(i + MaxDisplayListsPerPacket, dlists.size());
+				packet.mDisplayLists.assign(std::make_move_iterator(dlists.begin() + i), std::make_move_iterator(dlists.begin() + end));
+				mesh.mPackets.push_back(std::move(packet));
+			}
+		} else {
+			// The hardware has room for 10 matrices at a time, each packet loads the ones its triangles use
+			constexpr std::size_t MatrixSlots = 10;
+
+			const std::vector<DListUtils::PalettePacket> palettePackets
+			    = DListUtils::splitByMatrixPalette(triangleIndices, vertexMatrices, MatrixSlots);
+
+			// Vertices are copied into each packet that uses them, with the slot their matrix has there
+			std::vector<u32> localIndex(vertices.size());
+			std::vector<u32> packetOf(vertices.size(), 0xFFFFFFFF);
+			const std::vector<u32>* previousSlots = nullptr;
+			for (u32 p = 0; p < palettePackets.size(); ++p) {
+				const DListUtils::PalettePacket& palettePacket = palettePackets[p];
+
+				std::vector<VertexAttrib> packetVertices;
+				std::vector<u32> packetIndices;
+				packetIndices.reserve(palettePacket.mIndices.size());
+				for (u32 index : palettePacket.mIndices) {
+					if (packetOf[index] != p) {
+						const auto slot = std::find(palettePacket.mMatrices.begin(), palettePacket.mMatrices.end(), vertexMatrices[index]);
+
+						packetOf[index]   = p;
+						localIndex[index] = static_cast<u32>(packetVertices.size());
+						packetVertices.push_back(vertices[index]);
+						packetVertices.back().mMatrixIndex = static_cast<u8>((slot - palettePacket.mMatrices.begin()) * 3);
 					}
+					packetIndices.push_back(localIndex[index]);
+				}
 
-					// Texture coordinate index (if present)
-					if (!gModFile.mTextureCoords[0].empty()) {
-						dlist.mData.push_back((idx >> 8) & 0xFF);
-						dlist.mData.push_back(idx & 0xFF);
+				// Slots still holding the previous packet's matrix are written as -1, which the game skips instead of reloading
+				MeshPacket packet;
+				for (std::size_t slot = 0; slot < palettePacket.mMatrices.size(); ++slot) {
+					const bool loaded = previousSlots != nullptr && slot < previousSlots->size()
+					                 && (*previousSlots)[slot] == palettePacket.mMatrices[slot];
+					packet.mIndices.push_back(loaded ? -1 : static_cast<s16>(palettePacket.mMatrices[slot]));
+					if (!loaded) {
+						matrixLoads++;
 					}
 				}
+				previousSlots = &palettePacket.mMatrices;
+
+				packet.mDisplayLists
+				    = DListUtils::encodeDisplayLists(stripify(packetIndices), packetVertices, mesh.mVtxDescriptor, DLFlags::Back);
+				mesh.mPackets.push_back(std::move(packet));
 			}
 		}
 
-		dlist.mCommandCount = meshFaces.size();
-		packet.mDisplayLists.push_back(dlist);
+		if (modFile.mVerbosePrint) {
+			session.out() << "Done! Imported " << modFile.mVertices.size() << " vertices and " << faceCount << " faces from " << objFile
+			              << std::endl;
+			session.out() << "Wrote " << triangleIndices.size() / 3 << " triangles as " << stripCount << " strips and " << listCount
+			              << " triangle lists in " << mesh.mPackets.size() << " packets" << std::endl;
+			if (!vertexMatrices.empty()) {
+				session.out() << "Skinned with " << modFile.mVertexMatrices.size() << " vertex matrices ("
+				              << modFile.mVertexEnvelopes.size() << " envelopes), " << matrixLoads << " matrix loads" << std::endl;
+			}
+		}
 
-		mesh.mPackets.push_back(packet);
-		gModFile.mMeshes.push_back(mesh);
+		modFile.mMeshes.push_back(std::move(mesh));
 	}
 
-	std::cout << "Done! Imported " << gModFile.mVertices.size() << " vertices and " << meshFaces.size() << " faces from " << objFile
-	          << std::endl;
+	return {};
 }
 
-void exportTextures()
+Status exportTextures(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	if (gModFile.mTextures.empty()) {
-		std::cout << "Loaded MOD file has no textures" << '\n';
-		return;
+	session.mModFile.decode(MOD::EChunkType::Texture);
+	if (session.mModFile.mTextures.empty()) {
+		return Status::ok("Loaded MOD file has no textures");
 	}
 
-	std::string pathStr = std::filesystem::path(gTokeniser.isEnd() ? "./" : gTokeniser.next()).string();
+	std::string pathStr = std::filesystem::path(session.mTokeniser.isEnd() ? "./" : session.mTokeniser.next()).string();
 	if (!pathStr.ends_with('/')) {
 		pathStr += "/";
 	}
@@ -818,15 +1229,21 @@ void exportTextures()
 		std::filesystem::create_directory(pathStr);
 	}
 
+	util::profiler::scope profile("io", "write TXE files");
+	profile.setElements(session.mModFile.mTextures.size());
+
 	u32 i = 0;
-	for (Texture& tex : gModFile.mTextures) {
+	u64 bytes = 0;
+	for (Texture& tex : session.mModFile.mTextures) {
 		util::fstream_writer writer;
 		const std::string& filename = pathStr + "tex" + std::to_string(i++) + ".txe";
-		std::cout << "Writing " << filename << '\n';
+		if (session.mModFile.mVerbosePrint) {
+			session.out() << "Writing " << filename << '\n';
+		}
+
 		writer.open(filename);
 		if (!writer.is_open()) {
-			std::cout << "Error unable to open " << filename << '\n';
-			return;
+			return Status::error("Error unable to open " + filename);
 		}
 
 		writer.writeU16(tex.mWidth);
@@ -840,94 +1257,275 @@ void exportTextures()
 
 		writer.write(reinterpret_cast<char*>(tex.mImageData.data()), tex.mImageData.size());
 		writer.close();
+		bytes += 32 + tex.mImageData.size();
+	}
+
+	profile.setBytes(bytes);
+
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done!" << '\n';
 	}
 
-	std::cout << "Done!" << '\n';
+	return {};
 }
 
-void exportMaterials()
+Status exportMaterials(Session& session)
 {
-	if (gModFileName.empty()) {
-		std::cout << "You haven't opened a MOD file!\n";
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (session.mModFileName.empty()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	if (gModFile.mMaterials.mMaterials.empty() && gModFile.mMaterials.mTevEnvironmentInfo.empty()) {
-		std::cout << "Loaded file has no materials!\n";
-		return;
+	modFile.decode(MOD::EChunkType::Material);
+	if (modFile.mMaterials.mMaterials.empty() && modFile.mMaterials.mTevEnvironmentInfo.empty()) {
+		return Status::ok("Loaded file has no materials!");
 	}
 
-	std::string filename = gTokeniser.isEnd() ? "./materials.json" : gTokeniser.next();
+	std::string filename = session.mTokeniser.isEnd() ? "./materials.json" : session.mTokeniser.next();
 
-	if (!mat::saveMaterialsToFile(filename, gModFile.mMaterials.mMaterials, gModFile.mMaterials.mTevEnvironmentInfo)) {
-		std::cout << "[FAIL]" << std::endl;
-	} else {
-		std::cout << "[SUCCESS]" << std::endl;
+	{
+		util::profiler::scope profile("io", "save materials JSON");
+		if (!mat::saveMaterialsToFile(filename, modFile.mMaterials.mMaterials, modFile.mMaterials.mTevEnvironmentInfo)) {
+			return Status::error("Failed to export materials to " + filename);
+		}
+
+		profile.setBytes(profiledFileSize(filename));
+		profile.setElements(modFile.mMaterials.mMaterials.size() + modFile.mMaterials.mTevEnvironmentInfo.size());
+	}
+
+	if (modFile.mVerbosePrint) {
+		session.out() << "[SUCCESS]" << std::endl;
 	}
+
+	return {};
 }
 
-void importMaterials()
+Status importMaterials(Session& session)
 {
-	std::string filename = gTokeniser.isEnd() ? "./materials.json" : gTokeniser.next();
+	MOD& modFile = session.mModFile;
+
+	std::string filename = session.mTokeniser.isEnd() ? "./materials.json" : session.mTokeniser.next();
 
 	std::vector<Material> materials;
 	std::vector<TEVInfo> tevInfos;
 
-	if (mat::loadMaterialsFromFile(filename, materials, tevInfos)) {
-		// Update the global mod file with imported materials
-		gModFile.mMaterials.mMaterials          = std::move(materials);
-		gModFile.mMaterials.mTevEnvironmentInfo = std::move(tevInfos);
-		if (gModFile.mVerbosePrint) {
-			std::cout << "Successfully imported materials from " << filename << "\n";
-			std::cout << "Loaded " << gModFile.mMaterials.mMaterials.size() << " materials and "
-			          << gModFile.mMaterials.mTevEnvironmentInfo.size() << " TEV configurations\n";
+	{
+		util::profiler::scope profile("io", "load materials JSON");
+		profile.setBytes(profiledFileSize(filename));
+		if (!mat::loadMaterialsFromFile(filename, materials, tevInfos)) {
+			return Status::error("Failed to import materials from " + filename);
 		}
-	} else if (gModFile.mVerbosePrint) {
-		std::cout << "Failed to import materials from " << filename << "\n";
+
+		profile.setElements(materials.size() + tevInfos.size());
 	}
+
+	// Update the loaded mod file with imported materials
+	modFile.discardRaw(MOD::EChunkType::Material);
+	modFile.mMaterials.mMaterials          = std::move(materials);
+	modFile.mMaterials.mTevEnvironmentInfo = std::move(tevInfos);
+	if (modFile.mVerbosePrint) {
+		session.out() << "Successfully imported materials from " << filename << "\n";
+		session.out() << "Loaded " << modFile.mMaterials.mMaterials.size() << " materials and "
+		              << modFile.mMaterials.mTevEnvironmentInfo.size() << " TEV configurations\n";
+	}
+
+	return {};
 }
 
-void exportIni()
+Status exportIni(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!\n";
-		return;
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
 	std::string filename = "ini_dump.txt";
-	if (!gTokeniser.isEnd()) {
-		filename = gTokeniser.next();
+	if (!session.mTokeniser.isEnd()) {
+		filename = session.mTokeniser.next();
 	} else {
-		std::cout << "Filename not provided, defaulting to ini_dump.txt!\n";
+		session.out() << "Filename not provided, defaulting to ini_dump.txt!\n";
 	}
 
 	std::filesystem::path filepath { filename };
 	std::ofstream outStream(filepath, std::ios::binary);
 
 	if (!outStream) {
-		std::cout << "Error can't open " << filepath << '\n';
-		return;
+		return Status::error("Error can't open " + filepath.string());
+	}
+
+	outStream.write(reinterpret_cast<const char*>(session.mModFile.mEndOfFileData.data()), session.mModFile.mEndOfFileData.size());
+
+	if (session.mModFile.mVerbosePrint) {
+		session.out() << "Done!\n";
+	}
+
+	return {};
+}
+
+Status optimizeMesh(Session& session)
+{
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	outStream.write(reinterpret_cast<const char*>(gModFile.mEndOfFileData.data()), gModFile.mEndOfFileData.size());
+	std::size_t cacheSize = 16;
+	if (!session.mTokeniser.isEnd()) {
+		const std::string input = session.mTokeniser.next();
+		try {
+			cacheSize = std::stoul(input);
+		} catch (...) {
+			return Status::error("Invalid cache size: " + input);
+		}
+
+		if (cacheSize == 0) {
+			return Status::error("The cache size has to be at least 1");
+		}
+	}
+
+	modFile.decode(MOD::EChunkType::Mesh);
+
+	struct Result {
+		u64 mTrianglesBefore = 0;
+		u64 mMissesBefore    = 0;
+		u64 mTrianglesAfter  = 0;
+		u64 mMissesAfter     = 0;
+		u64 mBytesBefore     = 0;
+		u64 mBytesAfter      = 0;
+		u64 mDegenerate      = 0; // Triangles dropped because two of their corners are the same vertex
+		u32 mGroups          = 0;
+		u32 mOptimized       = 0;
+	};
+
+	std::vector<Result> results(modFile.mMeshes.size());
+	util::parallel_for(modFile.mMeshes.size(), modFile.mJobs, [&](std::size_t m) {
+		Mesh& mesh     = modFile.mMeshes[m];
+		Result& result = results[m];
+
+		for (MeshPacket& packet : mesh.mPackets) {
+			// Display lists with different culling can't share primitives, so each kind is optimised on its own
+			std::vector<std::vector<DisplayList>> groups;
+			for (DisplayList& dlist : packet.mDisplayLists) {
+				auto group = std::find_if(groups.begin(), groups.end(), [&](const auto& g) { return g.front().mFlags == dlist.mFlags; });
+				if (group == groups.end()) {
+					groups.emplace_back();
+					group = groups.end() - 1;
+				}
+				group->push_back(std::move(dlist));
+			}
+
+			packet.mDisplayLists.clear();
+			for (std::vector<DisplayList>& group : groups) {
+				DListUtils::VertexCacheSim before(cacheSize);
+				DListUtils::IndexedMeshBuilder builder;
+				for (const DisplayList& dlist : group) {
+					before.add(dlist, mesh.mVtxDescriptor);
+
+					util::span_reader reader(dlist.mData);
+					DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
+					builder.add(dlReader);
+				}
+
+				DListUtils::IndexedMesh welded = builder.take();
+				DListUtils::optimizeVertexCache(welded.indices, welded.vertices.size());
+
+				auto byteSize = [](const std::vector<DisplayList>& dlists) {
+					return std::accumulate(dlists.begin(), dlists.end(), u64 { 0 },
+					                       [](u64 total, const DisplayList& dlist) { return total + dlist.mData.size(); });
+				};
 
-	std::cout << "Done!\n";
+				// Stripping drops these, so they only go away when the group is replaced
+				u64 degenerate = 0;
+				for (std::size_t i = 0; i + 2 < welded.indices.size(); i += 3) {
+					const u32* tri = welded.indices.data() + i;
+					degenerate += tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] ? 1 : 0;
+				}
+
+				const u64 bytesBefore = byteSize(group);
+				result.mGroups++;
+				result.mTrianglesBefore += before.getTriangles();
+				result.mMissesBefore += before.getMisses();
+				result.mBytesBefore += bytesBefore;
+
+				// Long strips are smaller but can wander away from the new order, strips that only look as far ahead as the
+				// cache holds keep it. Whichever misses least without growing the display lists wins, geometry that's already
+				// well ordered is left as it was
+				DListUtils::VertexCacheSim kept    = before;
+				std::vector<DisplayList> keptLists = std::move(group);
+				bool replaced                      = false;
+				for (const std::size_t window : { std::size_t { 0 }, cacheSize }) {
+					const std::vector<DListUtils::IndexedPrimitive> primitives = DListUtils::stripify(welded.indices, 2, 65535, window);
+					std::vector<DisplayList> candidate
+					    = DListUtils::encodeDisplayLists(primitives, welded.vertices, mesh.mVtxDescriptor, keptLists.front().mFlags);
+
+					DListUtils::VertexCacheSim after(cacheSize);
+					for (const DisplayList& dlist : candidate) {
+						after.add(dlist, mesh.mVtxDescriptor);
+					}
+
+					if (after.getMisses() < kept.getMisses() && byteSize(candidate) <= bytesBefore) {
+						kept      = after;
+						keptLists = std::move(candidate);
+						replaced  = true;
+					}
+				}
+
+				result.mOptimized += replaced ? 1 : 0;
+				result.mDegenerate += replaced ? degenerate : 0;
+				result.mTrianglesAfter += kept.getTriangles();
+				result.mMissesAfter += kept.getMisses();
+				result.mBytesAfter += byteSize(keptLists);
+
+				std::move(keptLists.begin(), keptLists.end(), std::back_inserter(packet.mDisplayLists));
+			}
+		}
+	});
+
+	if (modFile.mVerbosePrint) {
+		Result total;
+		for (const Result& result : results) {
+			total.mTrianglesBefore += result.mTrianglesBefore;
+			total.mMissesBefore += result.mMissesBefore;
+			total.mTrianglesAfter += result.mTrianglesAfter;
+			total.mMissesAfter += result.mMissesAfter;
+			total.mBytesBefore += result.mBytesBefore;
+			total.mBytesAfter += result.mBytesAfter;
+			total.mDegenerate += result.mDegenerate;
+			total.mGroups += result.mGroups;
+			total.mOptimized += result.mOptimized;
+		}
+
+		auto acmr = [](u64 misses, u64 triangles) { return triangles == 0 ? 0.0 : static_cast<double>(misses) / triangles; };
+
+		session.out() << "Done! Reordered " << total.mOptimized << " of " << total.mGroups << " display list groups in "
+		              << modFile.mMeshes.size() << " meshes" << '\n';
+		session.out() << std::fixed << std::setprecision(3) << "ACMR (" << cacheSize << " entry cache): "
+		              << acmr(total.mMissesBefore, total.mTrianglesBefore) << " -> " << acmr(total.mMissesAfter, total.mTrianglesAfter)
+		              << std::defaultfloat << '\n';
+		session.out() << "Display list bytes: " << total.mBytesBefore << " -> " << total.mBytesAfter << '\n';
+		if (total.mDegenerate != 0) {
+			session.out() << "Removed " << total.mDegenerate << " degenerate triangles" << '\n';
+		}
+	}
+
+	return {};
 }
 
-void deleteChunk()
+Status deleteChunk(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	if (gTokeniser.isEnd()) {
-		std::cout << "Chunk not provided!" << '\n';
-		return;
+	if (session.mTokeniser.isEnd()) {
+		return Status::error("Chunk not provided!");
 	}
 
 	// Convert input (hex value) to value
-	std::string input = gTokeniser.next();
+	std::string input = session.mTokeniser.next();
 
 	u32 chunkId = 0;
 	try {
@@ -937,36 +1535,35 @@ void deleteChunk()
 			chunkId = std::stoul(input);
 		}
 	} catch (...) {
-		std::cout << "Invalid chunk ID format!" << '\n';
-		return;
+		return Status::error("Invalid chunk ID format!");
 	}
 
 	// Is the chunk value a valid MOD chunk type?
 	auto chunkName = MOD::getChunkName(chunkId);
 	if (!chunkName.has_value()) {
-		std::cout << "Chunk doesn't exist!" << '\n';
-		return;
+		return Status::error("Chunk doesn't exist!");
 	}
 
 	// Remove the chunk from the loaded MOD file
-	bool failure         = false;
 	const auto chunkType = static_cast<MOD::EChunkType>(chunkId);
+	if (chunkType != MOD::EChunkType::Header) {
+		modFile.discardRaw(chunkType);
+	}
+
 	switch (chunkType) {
 	case MOD::EChunkType::Header:
-		std::cout << "Cannot delete Header chunk!" << '\n';
-		failure = true;
-		break;
+		return Status::error("Cannot delete Header chunk!");
 	case MOD::EChunkType::Vertex:
-		gModFile.mVertices.clear();
+		modFile.mVertices.clear();
 		break;
 	case MOD::EChunkType::VertexNormal:
-		gModFile.mVertexNormals.clear();
+		modFile.mVertexNormals.clear();
 		break;
 	case MOD::EChunkType::VertexNBT:
-		gModFile.mVertexNbt.clear();
+		modFile.mVertexNbt.clear();
 		break;
 	case MOD::EChunkType::VertexColour:
-		gModFile.mVertexColours.clear();
+		modFile.mVertexColours.clear();
 		break;
 	case MOD::EChunkType::TexCoord0:
 	case MOD::EChunkType::TexCoord1:
@@ -977,127 +1574,133 @@ void deleteChunk()
 	case MOD::EChunkType::TexCoord6:
 	case MOD::EChunkType::TexCoord7: {
 		u32 idx = chunkId - static_cast<u32>(MOD::EChunkType::TexCoord0);
-		if (idx < gModFile.mTextureCoords.size()) {
-			gModFile.mTextureCoords[idx].clear();
-			if (gModFile.mVerbosePrint) {
-				std::cout << "Deleted TexCoord" << idx << " chunk." << '\n';
+		if (idx < modFile.mTextureCoords.size()) {
+			modFile.mTextureCoords[idx].clear();
+			if (modFile.mVerbosePrint) {
+				session.out() << "Deleted TexCoord" << idx << " chunk." << '\n';
 			}
 		} else {
-			std::cout << "TexCoord index out of range!" << '\n';
-			failure = true;
+			return Status::error("TexCoord index out of range!");
 		}
 		break;
 	}
 	case MOD::EChunkType::Texture:
-		gModFile.mTextures.clear();
+		modFile.mTextures.clear();
 		break;
 	case MOD::EChunkType::TextureAttribute:
-		gModFile.mTextureAttributes.clear();
+		modFile.mTextureAttributes.clear();
 		break;
 	case MOD::EChunkType::Material:
-		gModFile.mMaterials.mMaterials.clear();
-		gModFile.mMaterials.mTevEnvironmentInfo.clear();
+		modFile.mMaterials.mMaterials.clear();
+		modFile.mMaterials.mTevEnvironmentInfo.clear();
 		break;
 	case MOD::EChunkType::VertexMatrix:
-		gModFile.mVertexMatrices.clear();
+		modFile.mVertexMatrices.clear();
 		break;
 	case MOD::EChunkType::MatrixEnvelope:
-		gModFile.mVertexEnvelopes.clear();
+		modFile.mVertexEnvelopes.clear();
 		break;
 	case MOD::EChunkType::Mesh:
-		gModFile.mMeshes.clear();
+		modFile.mMeshes.clear();
 		break;
 	case MOD::EChunkType::Joint:
-		gModFile.mJoints.clear();
+		modFile.mJoints.clear();
 		break;
 	case MOD::EChunkType::JointName:
-		gModFile.mJointNames.clear();
+		modFile.mJointNames.clear();
 		break;
 	case MOD::EChunkType::CollisionPrism:
-		gModFile.mCollisionTriangles.mCollInfo.clear();
-		gModFile.mCollisionTriangles.mRoomInfo.clear();
+		modFile.mCollisionTriangles.mCollInfo.clear();
+		modFile.mCollisionTriangles.mRoomInfo.clear();
 		break;
 	case MOD::EChunkType::CollisionGrid:
-		gModFile.mCollisionGridInfo.clear();
+		modFile.mCollisionGridInfo.clear();
 		break;
 	case MOD::EChunkType::EndOfFile:
-		gModFile.mEndOfFileData.clear();
+		modFile.mEndOfFileData.clear();
 		break;
 	}
 
-	if (!failure && gModFile.mVerbosePrint) {
-		std::cout << "Successfully deleted (" << chunkName.value() << ")" << '\n';
+	if (modFile.mVerbosePrint) {
+		session.out() << "Successfully deleted (" << chunkName.value() << ")" << '\n';
 	}
+
+	return {};
 }
 
-void editHeader()
+Status editHeader(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
-	}
+	MOD& modFile = session.mModFile;
 
-	std::cout << '\n';
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
+	}
 
-	std::cout << "What would you like to edit?" << '\n';
-	std::cout << "\t(1) date of creation" << '\n';
-	std::cout << "\t(2) flags" << '\n';
+	// Every value can be given up front, e.g. "edit_header date 2025 4 5" or "edit_header flags 0x11",
+	// whatever is left out is asked for
+	const Status missing = Status::error("edit_header needs its values as arguments here: date <year> <month> <day> or flags <value>");
 
 	std::string input;
-	std::getline(std::cin, input);
-
-	std::cout << '\n';
+	if (!nextOrAsk(session, "\nWhat would you like to edit?\n\t(1) date of creation\n\t(2) flags\n", input)) {
+		return missing;
+	}
 
 	try {
-		int choice = std::stoi(input);
+		const int choice = input == "date" ? 1 : input == "flags" ? 2 : std::stoi(input);
 
 		switch (choice) {
 		case 1: {
 			// Edit date
-			std::cout << "Current date: " << gModFile.mHeader.mDateTime.mYear << "/" << (u32)gModFile.mHeader.mDateTime.mMonth << "/"
-			          << (u32)gModFile.mHeader.mDateTime.mDay << '\n';
+			if (session.mTokeniser.isEnd()) {
+				session.out() << "Current date: " << modFile.mHeader.mDateTime.mYear << "/" << (u32)modFile.mHeader.mDateTime.mMonth << "/"
+				              << (u32)modFile.mHeader.mDateTime.mDay << '\n';
+			}
 
-			std::cout << "Enter new year (e.g., 2025): ";
-			std::getline(std::cin, input);
+			if (!nextOrAsk(session, "Enter new year (e.g., 2025): ", input)) {
+				return missing;
+			}
 			u16 year = static_cast<u16>(std::stoi(input));
 
-			std::cout << "Enter new month (1-12): ";
-			std::getline(std::cin, input);
+			if (!nextOrAsk(session, "Enter new month (1-12): ", input)) {
+				return missing;
+			}
 			u8 month = static_cast<u8>(std::stoi(input));
 
-			std::cout << "Enter new day (1-31): ";
-			std::getline(std::cin, input);
+			if (!nextOrAsk(session, "Enter new day (1-31): ", input)) {
+				return missing;
+			}
 			u8 day = static_cast<u8>(std::stoi(input));
 
 			// Validate input
 			if (month < 1 || month > 12) {
-				std::cout << "Invalid month! Must be between 1-12." << '\n';
-				return;
+				return Status::error("Invalid month! Must be between 1-12.");
 			}
 			if (day < 1 || day > 31) {
-				std::cout << "Invalid day! Must be between 1-31." << '\n';
-				return;
+				return Status::error("Invalid day! Must be between 1-31.");
 			}
 
-			gModFile.mHeader.mDateTime.mYear  = year;
-			gModFile.mHeader.mDateTime.mMonth = month;
-			gModFile.mHeader.mDateTime.mDay   = day;
+			modFile.mHeader.mDateTime.mYear  = year;
+			modFile.mHeader.mDateTime.mMonth = month;
+			modFile.mHeader.mDateTime.mDay   = day;
 
-			std::cout << "Date updated to: " << gModFile.mHeader.mDateTime.mYear << "/" << (u32)gModFile.mHeader.mDateTime.mMonth << "/"
-			          << (u32)gModFile.mHeader.mDateTime.mDay << '\n';
+			session.out() << "Date updated to: " << modFile.mHeader.mDateTime.mYear << "/" << (u32)modFile.mHeader.mDateTime.mMonth << "/"
+			              << (u32)modFile.mHeader.mDateTime.mDay << '\n';
 			break;
 		}
 		case 2: {
 			// Edit flags
-			std::cout << "Current flags: 0x" << std::hex << gModFile.mHeader.mFlags << std::dec << '\n';
-			std::cout << "\t0x00 - None" << '\n';
-			std::cout << "\t0x01 - UseNBT (Use Normal/Binormal/Tangent)" << '\n';
-			std::cout << "\t0x02 - AllowCaching (Allow display list caching)" << '\n';
-			std::cout << "\t0x04 - AlwaysRedraw (Force redraw every frame)" << '\n';
-			std::cout << "\t0x10 - IsPlatform (Has platform collision)" << '\n';
-			std::cout << "Enter new flags (hex format, e.g., 0x01 or decimal): ";
-
-			std::getline(std::cin, input);
+			if (session.mTokeniser.isEnd()) {
+				session.out() << "Current flags: 0x" << std::hex << modFile.mHeader.mFlags << std::dec << '\n';
+				session.out() << "\t0x00 - None" << '\n';
+				session.out() << "\t0x01 - UseNBT (Use Normal/Binormal/Tangent)" << '\n';
+				session.out() << "\t0x02 - AllowCaching (Allow display list caching)" << '\n';
+				session.out() << "\t0x04 - AlwaysRedraw (Force redraw every frame)" << '\n';
+				session.out() << "\t0x10 - IsPlatform (Has platform collision)" << '\n';
+			}
+
+			if (!nextOrAsk(session, "Enter new flags (hex format, e.g., 0x01 or decimal): ", input)) {
+				return missing;
+			}
 			u32 flags = 0;
 
 			if (input.starts_with("0x") || input.starts_with("0X")) {
@@ -1109,78 +1712,81 @@ void editHeader()
 			if (!(flags & static_cast<u32>(MODFlags::UseNBT)) && !(flags & static_cast<u32>(MODFlags::AllowCaching))
 			    && !(flags & static_cast<u32>(MODFlags::AlwaysRedraw)) && !(flags & static_cast<u32>(MODFlags::IsPlatform))
 			    && !(flags & static_cast<u32>(MODFlags::UseClassicScaling))) {
-				std::cout << "Unable to change flags, you haven't provided any valid option!" << '\n';
-				return;
+				return Status::error("Unable to change flags, you haven't provided any valid option!");
 			}
 
-			gModFile.mHeader.mFlags = flags;
+			modFile.mHeader.mFlags = flags;
 
-			std::cout << "Flags updated to: 0x" << std::hex << gModFile.mHeader.mFlags << std::dec << '\n';
+			session.out() << "Flags updated to: 0x" << std::hex << modFile.mHeader.mFlags << std::dec << '\n';
 
 			// Show which flags are set
 			if (flags & static_cast<u32>(MODFlags::UseNBT)) {
-				std::cout << "\t- UseNBT enabled" << '\n';
+				session.out() << "\t- UseNBT enabled" << '\n';
 			}
 			if (flags & static_cast<u32>(MODFlags::AllowCaching)) {
-				std::cout << "\t- AllowCaching enabled" << '\n';
+				session.out() << "\t- AllowCaching enabled" << '\n';
 			}
 			if (flags & static_cast<u32>(MODFlags::AlwaysRedraw)) {
-				std::cout << "\t- AlwaysRedraw enabled" << '\n';
+				session.out() << "\t- AlwaysRedraw enabled" << '\n';
 			}
 			if (flags & static_cast<u32>(MODFlags::UseClassicScaling)) {
-				std::cout << "\t- UseClassicScaling enabled" << '\n';
+				session.out() << "\t- UseClassicScaling enabled" << '\n';
 			}
 			if (flags & static_cast<u32>(MODFlags::IsPlatform)) {
-				std::cout << "\t- IsPlatform enabled" << '\n';
+				session.out() << "\t- IsPlatform enabled" << '\n';
 			}
 			break;
 		}
 		default:
-			std::cout << "Invalid choice! Please enter 1 or 2." << '\n';
-			return;
+			return Status::error("Invalid choice! Please enter 1 or 2.");
 		}
 
-		if (gModFile.mVerbosePrint) {
-			std::cout << "Header editing complete!" << '\n';
+		if (modFile.mVerbosePrint) {
+			session.out() << "Header editing complete!" << '\n';
 		}
 
 	} catch (const std::exception& e) {
-		std::cout << "Error: " << e.what() << '\n';
+		return Status::error(std::string("Error: ") + e.what());
 	}
+
+	return {};
 }
 
-void exportDmd()
+Status exportDmd(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!" << '\n';
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	const std::string& filename = gTokeniser.isEnd() ? gModFileName + ".dmd" : gTokeniser.next();
-	std::ofstream os(filename);
-	if (!os.is_open()) {
-		std::cout << "Error can't open " << filename << '\n';
-		return;
+	modFile.decodeAll();
+
+	const std::string& filename = session.mTokeniser.isEnd() ? session.mModFileName + ".dmd" : session.mTokeniser.next();
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		return Status::error("Error can't open " + filename);
 	}
 
-	os << std::fixed << std::setprecision(6);
+	util::text_writer os(file);
+	os.setFloatFormat(std::chars_format::fixed, 6);
 
 	// <INFORMATION> section
 	os << "<INFORMATION>\n{\n";
-	os << "\tnumjoints\t" << gModFile.mJoints.size() << '\n';
+	os << "\tnumjoints\t" << modFile.mJoints.size() << '\n';
 	os << "\tprimitive\tTriangleStrip\n";
-	os << "\tembossbump\t" << (gModFile.mHeader.mFlags & static_cast<u32>(MODFlags::UseNBT) ? "on" : "off") << '\n';
+	os << "\tembossbump\t" << (modFile.mHeader.mFlags & static_cast<u32>(MODFlags::UseNBT) ? "on" : "off") << '\n';
 	os << "\tscalingrule\tsoftimage\n";
 	os << "}\n\n";
 
 	// <JOINT> sections
-	for (size_t i = 0; i < gModFile.mJoints.size(); ++i) {
-		const auto& joint = gModFile.mJoints[i];
+	for (size_t i = 0; i < modFile.mJoints.size(); ++i) {
+		const auto& joint = modFile.mJoints[i];
 		os << "<JOINT>\n{\n";
 
 		// Index and name
 		os << "\tindex\t" << i << '\n';
-		std::string jointName = (i < gModFile.mJointNames.size()) ? gModFile.mJointNames[i] : "joint_" + std::to_string(i);
+		std::string jointName = (i < modFile.mJointNames.size()) ? modFile.mJointNames[i] : "joint_" + std::to_string(i);
 		os << "\tname\t" << jointName << '\n';
 
 		// Parent
@@ -1211,7 +1817,7 @@ void exportDmd()
 	}
 
 	// <TEX_ATTR> sections
-	for (const auto& attr : gModFile.mTextureAttributes) {
+	for (const auto& attr : modFile.mTextureAttributes) {
 		os << "<TEX_ATTR>\n{\n";
 		os << "\tindex\t" << attr.mIndex << '\n';
 		os << "\timage\t" << attr.mIndex << '\n';
@@ -1224,10 +1830,10 @@ void exportDmd()
 	}
 
 	// <ENVELOPE> section
-	if (!gModFile.mVertexEnvelopes.empty()) {
+	if (!modFile.mVertexEnvelopes.empty()) {
 		os << "<ENVELOPE>\n{\n";
-		os << "\tsize\t" << gModFile.mVertexEnvelopes.size() << '\n';
-		for (const auto& env : gModFile.mVertexEnvelopes) {
+		os << "\tsize\t" << modFile.mVertexEnvelopes.size() << '\n';
+		for (const auto& env : modFile.mVertexEnvelopes) {
 			os << "\tevl_mtx_num\t" << env.mIndices.size();
 			os << "\n\tevl_mtx_idx";
 			for (const auto& index : env.mIndices) {
@@ -1243,18 +1849,18 @@ void exportDmd()
 	}
 
 	// <VTX_MATRIX> section
-	if (!gModFile.mVertexMatrices.empty()) {
+	if (!modFile.mVertexMatrices.empty()) {
 		os << "<VTX_MATRIX>\n{\n";
-		os << "\tsize\t" << gModFile.mVertexMatrices.size() << '\n';
-		for (const auto& vtxMtx : gModFile.mVertexMatrices) {
+		os << "\tsize\t" << modFile.mVertexMatrices.size() << '\n';
+		for (const auto& vtxMtx : modFile.mVertexMatrices) {
 			os << "\tmatrix\t" << (vtxMtx.mHasPartialWeights ? "weight" : "full") << " " << vtxMtx.mIndex << '\n';
 		}
 		os << "}\n\n";
 	}
 
 	// <MATERIAL> section
-	for (u32 i = 0; i < gModFile.mMaterials.mMaterials.size(); ++i) {
-		const auto& mat = gModFile.mMaterials.mMaterials[i];
+	for (u32 i = 0; i < modFile.mMaterials.mMaterials.size(); ++i) {
+		const auto& mat = modFile.mMaterials.mMaterials[i];
 		os << "<MATERIAL>\n{\n";
 		os << "\tindex\t" << i << '\n';
 		os << "\tname\tmat_" << std::to_string(i) << '\n';
@@ -1288,10 +1894,10 @@ void exportDmd()
 	}
 
 	// <VTX_POS> and <DEFORMED_XYZ>
-	if (!gModFile.mVertices.empty()) {
-		Vector3f minbounds = gModFile.mVertices[0];
-		Vector3f maxbounds = gModFile.mVertices[0];
-		for (const Vector3f& vertex : gModFile.mVertices) {
+	if (!modFile.mVertices.empty()) {
+		Vector3f minbounds = modFile.mVertices[0];
+		Vector3f maxbounds = modFile.mVertices[0];
+		for (const Vector3f& vertex : modFile.mVertices) {
 			minbounds.x = std::min(minbounds.x, vertex.x);
 			minbounds.y = std::min(minbounds.y, vertex.y);
 			minbounds.z = std::min(minbounds.z, vertex.z);
@@ -1302,10 +1908,10 @@ void exportDmd()
 
 		for (const char* blockName : { "<VTX_POS>", "<DEFORMED_XYZ>", "<ENVELOPE_XYZ>" }) {
 			os << blockName << "\n{\n";
-			os << "\tsize\t" << gModFile.mVertices.size() << '\n';
+			os << "\tsize\t" << modFile.mVertices.size() << '\n';
 			os << "\tmin\t" << minbounds.x << " " << minbounds.y << " " << minbounds.z << '\n';
 			os << "\tmax\t" << maxbounds.x << " " << maxbounds.y << " " << maxbounds.z << '\n' << '\n';
-			for (const Vector3f& v : gModFile.mVertices) {
+			for (const Vector3f& v : modFile.mVertices) {
 				os << "\tfloat\t" << v.x << " " << v.y << " " << v.z << '\n';
 			}
 			os << "}\n\n";
@@ -1313,11 +1919,11 @@ void exportDmd()
 	}
 
 	// <VTX_NRM> and <ENVELOPE_NRM>
-	if (!gModFile.mVertexNormals.empty()) {
+	if (!modFile.mVertexNormals.empty()) {
 		for (const char* blockName : { "<VTX_NRM>", "<ENVELOPE_NRM>" }) {
 			os << blockName << "\n{\n";
-			os << "\tsize\t" << gModFile.mVertexNormals.size() << '\n' << '\n';
-			for (const Vector3f& vn : gModFile.mVertexNormals) {
+			os << "\tsize\t" << modFile.mVertexNormals.size() << '\n' << '\n';
+			for (const Vector3f& vn : modFile.mVertexNormals) {
 				os << "\tfloat\t" << vn.x << " " << vn.y << " " << vn.z << '\n';
 			}
 			os << "}\n\n";
@@ -1325,8 +1931,8 @@ void exportDmd()
 	}
 
 	// <TEXCOORDn>
-	for (u32 i = 0; i < gModFile.mTextureCoords.size(); ++i) {
-		const auto& texCoords = gModFile.mTextureCoords[i];
+	for (u32 i = 0; i < modFile.mTextureCoords.size(); ++i) {
+		const auto& texCoords = modFile.mTextureCoords[i];
 		if (texCoords.empty())
 			continue;
 
@@ -1340,136 +1946,165 @@ void exportDmd()
 	}
 
 	// <COLOR0>
-	if (!gModFile.mVertexColours.empty()) {
+	if (!modFile.mVertexColours.empty()) {
 		os << "<COLOR0>\n{\n";
-		os << "\tsize\t" << gModFile.mVertexColours.size() << '\n' << '\n';
-		for (const ColourU8& c : gModFile.mVertexColours) {
+		os << "\tsize\t" << modFile.mVertexColours.size() << '\n' << '\n';
+		for (const ColourU8& c : modFile.mVertexColours) {
 			os << "\tbyte\t" << static_cast<u32>(c.r) << " " << static_cast<u32>(c.g) << " " << static_cast<u32>(c.b) << " "
 			   << static_cast<u32>(c.a) << '\n';
 		}
 		os << "}\n\n";
 	}
 
-	// <POLYGON>
-	for (size_t i = 0; i < gModFile.mMeshes.size(); ++i) {
-		const auto& mesh = gModFile.mMeshes[i];
-		os << "<POLYGON>\n{\n";
-		os << "\tindex\t" << i << '\n';
-		os << "\tlight\ton\n";
-		os << "\tembossbump\t" << ((mesh.mVtxDescriptor & 0x10000) ? "on" : "off") << '\n';
-		os << "\tvcd\t";
+	// <POLYGON>, the meshes are formatted on mJobs threads into their own buffers and written out in order
+	std::vector<std::string> polygons(modFile.mMeshes.size());
+	util::parallel_for(modFile.mMeshes.size(), modFile.mJobs, [&](std::size_t i) {
+		const auto& mesh = modFile.mMeshes[i];
+
+		util::text_writer out;
+		out.setFloatFormat(std::chars_format::fixed, 6);
+		out << "<POLYGON>\n{\n";
+		out << "\tindex\t" << i << '\n';
+		out << "\tlight\ton\n";
+		out << "\tembossbump\t" << ((mesh.mVtxDescriptor & 0x10000) ? "on" : "off") << '\n';
+		out << "\tvcd\t";
 		// Generate VCD line from descriptor
 		// Bit 0: PNMTXIDX, Bit 2: Color0, Bit 3-10: TexCoord0-7
-		os << ((mesh.mVtxDescriptor & 0x1) ? 1 : 0) << " 1 ";                                      // PNMTXIDX, Position
-		os << ((!gModFile.mVertexNormals.empty() || !gModFile.mVertexNbt.empty()) ? 1 : 0) << " "; // Normal
-		os << ((mesh.mVtxDescriptor & 0x4) ? 1 : 0) << " 0 ";                                      // Color0, Color1
+		out << ((mesh.mVtxDescriptor & 0x1) ? 1 : 0) << " 1 ";                                      // PNMTXIDX, Position
+		out << ((!modFile.mVertexNormals.empty() || !modFile.mVertexNbt.empty()) ? 1 : 0) << " "; // Normal
+		out << ((mesh.mVtxDescriptor & 0x4) ? 1 : 0) << " 0 ";                                      // Color0, Color1
 		for (int j = 0; j < 8; ++j) {
-			os << ((mesh.mVtxDescriptor & (1 << (j + 3))) ? 1 : 0) << " "; // TexCoord j
+			out << ((mesh.mVtxDescriptor & (1 << (j + 3))) ? 1 : 0) << " "; // TexCoord j
 		}
-		os << "0 0 0 0 0 0 0 0\n"; // Unused fields
+		out << "0 0 0 0 0 0 0 0\n"; // Unused fields
+
+		// The same vertex layout DisplayListReader decodes with, normals take up a slot even in models without any
+		const bool hasNormals     = !modFile.mVertexNormals.empty() || !modFile.mVertexNbt.empty();
+		const VertexLayout layout = VertexLayout::fromDescriptor(mesh.mVtxDescriptor);
 
 		for (const auto& packet : mesh.mPackets) {
-			os << "\tnmtx_lists\t" << (packet.mIndices.empty() ? 0 : 1) << '\n';
-			os << "\tnmtxs\t" << packet.mIndices.size() << '\n';
-			os << "\tmtx_list";
+			out << "\tnmtx_lists\t" << (packet.mIndices.empty() ? 0 : 1) << '\n';
+			out << "\tnmtxs\t" << packet.mIndices.size() << '\n';
+			out << "\tmtx_list";
 			for (s16 idx : packet.mIndices) {
-				os << "\t" << idx;
+				out << "\t" << idx;
 			}
-			os << '\n';
+			out << '\n';
 
 			for (const auto& dlist : packet.mDisplayLists) {
 				switch (dlist.mFlags) {
 				case DLFlags::Front:
-					os << "\tface\tfront\n";
+					out << "\tface\tfront\n";
 					break;
 				case DLFlags::Back:
-					os << "\tface\tback\n";
+					out << "\tface\tback\n";
 					break;
 				case DLFlags::Both:
-					os << "\tface\tboth\n";
+					out << "\tface\tboth\n";
 					break;
 				default:
-					os << "\tface\tboth\n"; // Default case
+					out << "\tface\tboth\n"; // Default case
 					break;
 				}
 
-				util::vector_reader reader(dlist.mData, 0, util::vector_reader::Endianness::Big);
+				util::span_reader reader(dlist.mData);
 				while (reader.getRemaining() > 0) {
 					u8 opcode = reader.readU8();
 					if (opcode >= 0x90 && opcode <= 0xB8) { // Is a primitive
 						u16 vertCount = reader.readU16();
-						os << "\tnodes\t" << vertCount << '\n';
+						out << "\tnodes\t" << vertCount << '\n';
+
+						// Fetch the whole primitive at once, then decode each vertex without bounds checks
+						const std::span<const u8> vertexData = reader.readSpan(static_cast<std::size_t>(vertCount) * layout.mStride);
 
 						for (u16 v = 0; v < vertCount; ++v) {
-							std::vector<int> vcd_data(21, -1);
-
-							// Parse vertex data from stream based on descriptor
-							if (mesh.mVtxDescriptor & 0x1)
-								vcd_data[0] = reader.readU8(); // PNMTXIDX
-							if (mesh.mVtxDescriptor & 0x2)
-								reader.readU8(); // TEXMTXIDX (skip)
-
-							vcd_data[1] = reader.readU16(); // POS
-							if (!gModFile.mVertexNormals.empty() || !gModFile.mVertexNbt.empty())
-								vcd_data[2] = reader.readU16(); // NRM
-							if (mesh.mVtxDescriptor & 0x4)
-								vcd_data[3] = reader.readU16(); // COL0
-
-							for (int j = 0; j < 8; ++j) {
-								if (mesh.mVtxDescriptor & (1 << (j + 3)))
-									vcd_data[10 + j] = reader.readU16(); // TEX j
+							const u8* data = vertexData.data() + static_cast<std::size_t>(v) * layout.mStride;
+
+							std::array<int, 21> vcd_data;
+							vcd_data.fill(-1);
+
+							// TEXMTXIDX is skipped
+							if (mesh.mVtxDescriptor & VCD::MatrixIndex) {
+								vcd_data[0] = data[layout.mMatrixIndexOffset]; // PNMTXIDX
+							}
+
+							vcd_data[1] = util::span_reader::load<u16>(data + layout.mPositionOffset); // POS
+							if (hasNormals) {
+								vcd_data[2] = util::span_reader::load<u16>(data + layout.mNormalOffset); // NRM
+							}
+							if (mesh.mVtxDescriptor & VCD::Color0) {
+								vcd_data[3] = util::span_reader::load<u16>(data + layout.mColorOffset); // COL0
 							}
 
-							os << "\tvcd_dat";
+							for (u32 t = 0; t < layout.mTexCoordCount; ++t) {
+								const u16 texCoord                      = util::span_reader::load<u16>(data + layout.mTexCoordOffsets[t]);
+								vcd_data[10 + layout.mTexCoordSlots[t]] = texCoord; // TEX j
+							}
+
+							out << "\tvcd_dat";
 							for (int val : vcd_data) {
-								os << "\t" << val;
+								out << "\t" << val;
 							}
-							os << '\n';
+							out << '\n';
 						}
 					}
 				}
 			}
 		}
-		os << "}\n\n";
+		out << "}\n\n";
+		polygons[i] = out.takeBuffer();
+	});
+
+	for (const std::string& polygon : polygons) {
+		os << polygon;
 	}
 
-	os.close();
-	if (gModFile.mVerbosePrint) {
-		std::cout << "Done! Exported model to " << filename << std::endl;
+	os.flush();
+	file.close();
+	if (modFile.mVerbosePrint) {
+		session.out() << "Done! Exported model to " << filename << std::endl;
 	}
+
+	return {};
 }
 
-void exportCollision()
+Status exportCollision(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!\n";
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	if (gModFile.mCollisionTriangles.mCollInfo.empty()) {
-		std::cout << "Loaded file has no collision data!\n";
-		return;
+	modFile.decode({ MOD::EChunkType::CollisionPrism, MOD::EChunkType::CollisionGrid });
+	if (modFile.mCollisionTriangles.mCollInfo.empty()) {
+		return Status::ok("Loaded file has no collision data!");
 	}
 
-	std::string filename = gTokeniser.isEnd() ? "./collision.json" : gTokeniser.next();
+	std::string filename = session.mTokeniser.isEnd() ? "./collision.json" : session.mTokeniser.next();
+
+	{
+		util::profiler::scope profile("io", "save collision JSON");
+		if (!collision::saveCollisionToFile(filename, modFile.mCollisionTriangles, modFile.mCollisionGridInfo)) {
+			return Status::error("Failed to export collision data to " + filename);
+		}
 
-	if (!collision::saveCollisionToFile(filename, gModFile.mCollisionTriangles, gModFile.mCollisionGridInfo)) {
-		std::cout << "Failed to export collision data to " << filename << "\n";
-		return;
+		profile.setBytes(profiledFileSize(filename));
+		profile.setElements(modFile.mCollisionTriangles.mCollInfo.size());
 	}
 
-	if (gModFile.mVerbosePrint) {
-		std::cout << "Successfully exported collision data to " << filename << "\n";
-		std::cout << "Exported " << gModFile.mCollisionTriangles.mCollInfo.size() << " collision triangles\n";
-		std::cout << "Exported " << gModFile.mCollisionTriangles.mRoomInfo.size() << " room entries\n";
-		std::cout << "Exported collision grid with " << gModFile.mCollisionGridInfo.mGroups.size() << " groups\n";
+	if (modFile.mVerbosePrint) {
+		session.out() << "Successfully exported collision data to " << filename << "\n";
+		session.out() << "Exported " << modFile.mCollisionTriangles.mCollInfo.size() << " collision triangles\n";
+		session.out() << "Exported " << modFile.mCollisionTriangles.mRoomInfo.size() << " room entries\n";
+		session.out() << "Exported collision grid with " << modFile.mCollisionGridInfo.mGroups.size() << " groups\n";
 
 		// Analyze collision data
 		std::map<int, int> surfaceTypeCounts;
 		std::map<int, int> slipCodeCounts;
 		int baldTriangles = 0;
 
-		for (const auto& tri : gModFile.mCollisionTriangles.mCollInfo) {
+		for (const auto& tri : modFile.mCollisionTriangles.mCollInfo) {
 			collision::MapCodeBitfield mapCode(static_cast<u32>(tri.mMapCode));
 			surfaceTypeCounts[mapCode.getAttribute()]++;
 			slipCodeCounts[mapCode.getSlipCode()]++;
@@ -1477,47 +2112,60 @@ void exportCollision()
 				baldTriangles++;
 		}
 
-		std::cout << "\nCollision Analysis:\n";
-		std::cout << "Surface Types:\n";
+		session.out() << "\nCollision Analysis:\n";
+		session.out() << "Surface Types:\n";
 		for (const auto& [type, count] : surfaceTypeCounts) {
-			std::cout << "  " << collision::EnumConverters::MapAttributesToString(type) << ": " << count << " triangles\n";
+			session.out() << "  " << collision::EnumConverters::MapAttributesToString(type) << ": " << count << " triangles\n";
 		}
 
-		std::cout << "Slip Codes:\n";
+		session.out() << "Slip Codes:\n";
 		for (const auto& [slip, count] : slipCodeCounts) {
-			std::cout << "  " << collision::EnumConverters::SlipCodeToString(slip) << ": " << count << " triangles\n";
+			session.out() << "  " << collision::EnumConverters::SlipCodeToString(slip) << ": " << count << " triangles\n";
 		}
 
-		std::cout << "Bald (non-walkable) triangles: " << baldTriangles << "\n";
+		session.out() << "Bald (non-walkable) triangles: " << baldTriangles << "\n";
 	}
+
+	return {};
 }
 
-void importCollision()
+Status importCollision(Session& session)
 {
-	if (!isModFileOpen()) {
-		std::cout << "You haven't opened a MOD file!\n";
-		return;
+	MOD& modFile = session.mModFile;
+
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
 	}
 
-	std::string filename = gTokeniser.isEnd() ? "./collision.json" : gTokeniser.next();
+	std::string filename = session.mTokeniser.isEnd() ? "./collision.json" : session.mTokeniser.next();
 
 	CollTriInfo triangles;
 	CollGrid grid;
 
-	if (collision::loadCollisionFromFile(filename, triangles, grid)) {
-		// Update the global mod file with imported collision data
-		gModFile.mCollisionTriangles = std::move(triangles);
-		gModFile.mCollisionGridInfo  = std::move(grid);
-
-		if (gModFile.mVerbosePrint) {
-			std::cout << "Successfully imported collision data from " << filename << "\n";
-			std::cout << "Loaded " << gModFile.mCollisionTriangles.mCollInfo.size() << " collision triangles\n";
-			std::cout << "Loaded " << gModFile.mCollisionTriangles.mRoomInfo.size() << " room entries\n";
-			std::cout << "Loaded collision grid with " << gModFile.mCollisionGridInfo.mGroups.size() << " groups\n";
+	{
+		util::profiler::scope profile("io", "load collision JSON");
+		profile.setBytes(profiledFileSize(filename));
+		if (!collision::loadCollisionFromFile(filename, triangles, grid)) {
+			return Status::error("Failed to import collision data from " + filename);
 		}
-	} else {
-		std::cout << "Failed to import collision data from " << filename << "\n";
+
+		profile.setElements(triangles.mCollInfo.size());
 	}
+
+	// Update the loaded mod file with imported collision data
+	modFile.discardRaw(MOD::EChunkType::CollisionPrism);
+	modFile.discardRaw(MOD::EChunkType::CollisionGrid);
+	modFile.mCollisionTriangles = std::move(triangles);
+	modFile.mCollisionGridInfo  = std::move(grid);
+
+	if (modFile.mVerbosePrint) {
+		session.out() << "Successfully imported collision data from " << filename << "\n";
+		session.out() << "Loaded " << modFile.mCollisionTriangles.mCollInfo.size() << " collision triangles\n";
+		session.out() << "Loaded " << modFile.mCollisionTriangles.mRoomInfo.size() << " room entries\n";
+		session.out() << "Loaded collision grid with " << modFile.mCollisionGridInfo.mGroups.size() << " groups\n";
+	}
+
+	return {};
 }
 
 } // namespace mod
@@ -3,39 +3,36 @@
 
 #pragma once
 
-#include "util/tokeniser.hpp"
+#include "session.hpp"
 #include <functional>
 #include <iostream>
-#include "MOD.hpp"
 #include <string>
 
 namespace cmd {
-extern MOD gModFile;
-extern std::string gModFileName;
-extern util::tokeniser gTokeniser;
-
 namespace mod {
-void importMod();
-void exportMod();
-void resetModel();
-
-void listChunks();
-void importObj();
-void importMaterials();
-void importTexture();
-void importIni();
-
-void exportObj();
-void exportMaterials();
-void exportTextures();
-void exportIni();
-void exportDmd();
-
-void exportCollision();
-void importCollision();
-
-void deleteChunk();
-void editHeader();
+Status importMod(Session& session);
+Status exportMod(Session& session);
+Status resetModel(Session& session);
+Status generateModel(Session& session);
+
+Status listChunks(Session& session);
+Status importObj(Session& session);
+Status importMaterials(Session& session);
+Status importTexture(Session& session);
+Status importIni(Session& session);
+
+Status exportObj(Session& session);
+Status exportMaterials(Session& session);
+Status exportTextures(Session& session);
+Status exportIni(Session& session);
+Status exportDmd(Session& session);
+
+Status exportCollision(Session& session);
+Status importCollision(Session& session);
+
+Status deleteChunk(Session& session);
+Status optimizeMesh(Session& session);
+Status editHeader(Session& session);
 } // namespace mod
 
 void showCommands();
@@ -44,9 +41,9 @@ struct Command {
 	std::string_view mCommand;
 	std::vector<std::string_view> mParameters;
 	std::string_view mDescription;
-	std::function<void()> mFunction;
+	std::function<Status(Session&)> mFunction;
 
-	Command(std::string_view cmd, std::vector<std::string_view> params, std::string_view desc, std::function<void()> func)
+	Command(std::string_view cmd, std::vector<std::string_view> params, std::string_view desc, std::function<Status(Session&)> func)
 	    : mCommand(cmd)
 	    , mParameters(params)
 	    , mDescription(desc)
@@ -65,14 +62,19 @@ struct Command {
 
 static std::vector<Command> gCommands = {
 	Command("load", { "input filename" }, "loads a MOD file", cmd::mod::importMod),
-	Command("write", { "output filename" }, "writes the MOD file", cmd::mod::exportMod),
+	Command("write", { "output filename" }, "writes the MOD file ('-' for stdout)", cmd::mod::exportMod),
 	Command("reset", {}, "resets the currently loaded MOD file", cmd::mod::resetModel),
+	Command("generate", { "setting=value (optional, repeatable)" }, "generates a synthetic model, e.g. seed=7 vertices=60000 meshes=64",
+	        cmd::mod::generateModel),
 
 	Command("NEW_LINE"),
 
-	Command("list_chunks", {}, "lists all chunks in the currently loaded MOD file", cmd::mod::listChunks),
+	Command("list_chunks", { "'full' (optional)" }, "lists all chunks in the currently loaded MOD file", cmd::mod::listChunks),
 	Command("delete_chunk", { "target chunk (0x10, 0x12, 0x30, etc.)" }, "deletes a chunk type [dangerous]", cmd::mod::deleteChunk),
-	Command("edit_header", {}, "edits header information (date of creation / flags)", cmd::mod::editHeader),
+	Command("edit_header", { "date <y> <m> <d> | flags <value> (optional)" }, "edits header information (date of creation / flags)",
+	        cmd::mod::editHeader),
+	Command("optimize_mesh", { "vertex cache size (optional, default 16)" }, "reorders and restrips every mesh for the vertex cache",
+	        cmd::mod::optimizeMesh),
 
 	Command("NEW_LINE"),
 
@@ -80,7 +82,8 @@ static std::vector<Command> gCommands = {
 	Command("import_mat", { "input filename" }, "imports materials from an external file", cmd::mod::importMaterials),
 	Command("import_obj", { "input filename" }, "imports an external obj", cmd::mod::importObj),
 	Command("import_ini", { "input filename" }, "imports an external ini", cmd::mod::importIni),
-	Command("import_tex", {}, "swaps a texture with an external TXE file", cmd::mod::importTexture),
+	Command("import_tex", { "texture index (optional)", "input filename (optional)" }, "swaps a texture with an external TXE file",
+	        cmd::mod::importTexture),
 
 	Command("NEW_LINE"),
 
@@ -93,7 +96,10 @@ static std::vector<Command> gCommands = {
 
 	Command("NEW_LINE"),
 
-	Command("help", {}, "re-generate this command list", showCommands),
+	Command("help", {}, "re-generate this command list", [](Session&) {
+		showCommands();
+		return Status::ok();
+	}),
 };
 
 inline void showCommands()
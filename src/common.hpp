@@ -16,24 +16,25 @@
 #include "common/dlist_reader.hpp"
 #include "common/material_serializer.hpp"
 #include "common/collision_serializer.hpp"
+#include "util/fstream_reader.hpp"
 #include "util/fstream_writer.hpp"
+#include "util/span_reader.hpp"
+#include "util/vector_writer.hpp"
 
 namespace {
-inline u32 startChunk(util::fstream_writer& writer, u32 chunk)
+inline u32 startChunk(util::vector_writer& writer, u32 chunk)
 {
 	writer.writeU32(chunk);
-	const u32 position = static_cast<u32>(writer.tellp());
+	const u32 position = static_cast<u32>(writer.getPosition());
 	writer.writeU32(0);
 	return position;
 }
 
-inline void finishChunk(util::fstream_writer& writer, u32 chunkStart)
+inline void finishChunk(util::vector_writer& writer, u32 chunkStart)
 {
 	writer.align();
-	const u32 position = static_cast<u32>(writer.tellp());
-	writer.seekp(chunkStart, std::ios_base::beg);
-	writer.writeU32(position - chunkStart - 4);
-	writer.seekp(position, std::ios_base::beg);
+	const u32 position = static_cast<u32>(writer.getPosition());
+	writer.patchU32(chunkStart, position - chunkStart - 4);
 }
 } // namespace
 
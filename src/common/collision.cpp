@@ -1,10 +1,10 @@
 #include "common.hpp"
 #include "collision.hpp"
 
-void BaseRoomInfo::read(util::fstream_reader& reader) { mIndex = reader.readU32(); }
-void BaseRoomInfo::write(util::fstream_writer& writer) const { writer.writeU32(mIndex); }
+void BaseRoomInfo::read(util::span_reader& reader) { mIndex = reader.readU32(); }
+void BaseRoomInfo::write(util::vector_writer& writer) const { writer.writeU32(mIndex); }
 
-void BaseCollTriInfo::read(util::fstream_reader& reader)
+void BaseCollTriInfo::read(util::span_reader& reader)
 {
 	mMapCode = static_cast<MapAttributes>(reader.readU32());
 
@@ -20,7 +20,7 @@ void BaseCollTriInfo::read(util::fstream_reader& reader)
 	mPlane.read(reader);
 }
 
-void BaseCollTriInfo::write(util::fstream_writer& writer)
+void BaseCollTriInfo::write(util::vector_writer& writer)
 {
 	writer.writeS32(static_cast<s32>(mMapCode));
 
@@ -36,7 +36,7 @@ void BaseCollTriInfo::write(util::fstream_writer& writer)
 	mPlane.write(writer);
 }
 
-void CollTriInfo::read(util::fstream_reader& reader)
+void CollTriInfo::read(util::span_reader& reader)
 {
 	mCollInfo.resize(reader.readU32());
 	mRoomInfo.resize(reader.readU32());
@@ -56,7 +56,7 @@ void CollTriInfo::read(util::fstream_reader& reader)
 	reader.align();
 }
 
-void CollTriInfo::write(util::fstream_writer& writer)
+void CollTriInfo::write(util::vector_writer& writer)
 {
 	const u32 start = startChunk(writer, 0x100);
 	writer.writeU32(static_cast<u32>(mCollInfo.size()));
@@ -77,7 +77,7 @@ void CollTriInfo::write(util::fstream_writer& writer)
 	finishChunk(writer, start);
 }
 
-void CollGroup::read(util::fstream_reader& reader)
+void CollGroup::read(util::span_reader& reader)
 {
 	mFarCullDistances.resize(reader.readU16());
 	mTriangleIndices.resize(reader.readU16());
@@ -91,7 +91,7 @@ void CollGroup::read(util::fstream_reader& reader)
 	}
 }
 
-void CollGroup::write(util::fstream_writer& writer)
+void CollGroup::write(util::vector_writer& writer)
 {
 	writer.writeU16(static_cast<u16>(mFarCullDistances.size()));
 	writer.writeU16(static_cast<u16>(mTriangleIndices.size()));
@@ -105,7 +105,7 @@ void CollGroup::write(util::fstream_writer& writer)
 	}
 }
 
-void CollGrid::read(util::fstream_reader& reader)
+void CollGrid::read(util::span_reader& reader)
 {
 	reader.align();
 
@@ -131,7 +131,7 @@ void CollGrid::read(util::fstream_reader& reader)
 	reader.align();
 }
 
-void CollGrid::write(util::fstream_writer& writer)
+void CollGrid::write(util::vector_writer& writer)
 {
 	const u32 start = startChunk(writer, 0x110);
 	writer.align();
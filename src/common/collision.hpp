@@ -4,14 +4,14 @@
 #include "../types.hpp"
 #include "../common/vector3.hpp"
 #include "../common/plane.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 struct BaseRoomInfo {
 	u32 mIndex = 0;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 /**
@@ -36,24 +36,24 @@ struct BaseCollTriInfo {
 	s16 mNeighbourIndices[3] = {};
 	Plane mPlane;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct CollTriInfo {
 	std::vector<BaseRoomInfo> mRoomInfo;
 	std::vector<BaseCollTriInfo> mCollInfo;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct CollGroup {
 	std::vector<u8> mFarCullDistances;
 	std::vector<u32> mTriangleIndices;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct CollGrid {
@@ -65,8 +65,8 @@ struct CollGrid {
 	std::vector<CollGroup> mGroups;
 	std::vector<s32> mGroupIndices;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 	void clear();
 };
 
@@ -1,6 +1,6 @@
 #include "colour.hpp"
 
-void ColourU8::read(util::fstream_reader& reader)
+void ColourU8::read(util::span_reader& reader)
 {
 	r = reader.readU8();
 	g = reader.readU8();
@@ -8,7 +8,7 @@ void ColourU8::read(util::fstream_reader& reader)
 	a = reader.readU8();
 }
 
-void ColourU8::write(util::fstream_writer& writer)
+void ColourU8::write(util::vector_writer& writer)
 {
 	writer.writeU8(r);
 	writer.writeU8(g);
@@ -22,7 +22,7 @@ std::ostream& operator<<(std::ostream& os, ColourU8 const& c)
 	return os;
 }
 
-void ColourU16::read(util::fstream_reader& reader)
+void ColourU16::read(util::span_reader& reader)
 {
 	r = reader.readU16();
 	g = reader.readU16();
@@ -30,7 +30,7 @@ void ColourU16::read(util::fstream_reader& reader)
 	a = reader.readU16();
 }
 
-void ColourU16::write(util::fstream_writer& writer)
+void ColourU16::write(util::vector_writer& writer)
 {
 	writer.writeU16(r);
 	writer.writeU16(g);
@@ -1,51 +1,108 @@
 #include "dlist_reader.hpp"
+#include "dlist_writer.hpp"
+#include "../util/profiler.hpp"
 #include <algorithm>
-#include <unordered_map>
-
-DisplayListReader::DisplayListReader(util::vector_reader& reader, u32 vcd)
-    : mReader(reader)
-    , mVCD(vcd)
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <type_traits>
+
+namespace {
+// Handles any descriptor by walking the layout's tables
+void decodeGeneric(const VertexLayout& layout, const u8* data, std::size_t count, VertexAttrib* out)
 {
+	const u32 vcd = layout.mDescriptor;
+	for (std::size_t i = 0; i < count; ++i, data += layout.mStride) {
+		VertexAttrib& attr = out[i];
+		if (vcd & VCD::MatrixIndex) {
+			attr.mMatrixIndex = data[layout.mMatrixIndexOffset];
+		}
+		if (vcd & VCD::TexMatrixIndex) {
+			attr.mTexMtxIndex = data[layout.mTexMtxIndexOffset];
+		}
+
+		attr.mPosition = util::span_reader::load<u16>(data + layout.mPositionOffset);
+		attr.mNormal   = util::span_reader::load<u16>(data + layout.mNormalOffset);
+
+		if (vcd & VCD::Color0) {
+			attr.mColor = util::span_reader::load<u16>(data + layout.mColorOffset);
+		}
+
+		for (u32 t = 0; t < layout.mTexCoordCount; ++t) {
+			attr.mTexcoords[layout.mTexCoordSlots[t]] = util::span_reader::load<u16>(data + layout.mTexCoordOffsets[t]);
+		}
+	}
 }
 
-VertexAttrib DisplayListReader::readVertex()
+// The same for a descriptor known at compile time, every test folds away and the stride is a constant
+template <u32 Vcd>
+void decodeFixed(const VertexLayout&, const u8* data, std::size_t count, VertexAttrib* out)
 {
-	VertexAttrib attr {};
+	static constexpr VertexLayout layout = VertexLayout::fromDescriptor(Vcd);
 
-	// Matrix indices (based on original code logic)
-	if (mVCD & VCD::MatrixIndex) {
-		attr.mMatrixIndex = mReader.readU8();
-	}
-	if (mVCD & VCD::TexMatrixIndex) {
-		attr.mTexMtxIndex = mReader.readU8();
-	}
+	for (std::size_t i = 0; i < count; ++i, data += layout.mStride) {
+		VertexAttrib& attr = out[i];
+		if constexpr ((Vcd & VCD::MatrixIndex) != 0) {
+			attr.mMatrixIndex = data[layout.mMatrixIndexOffset];
+		}
+		if constexpr ((Vcd & VCD::TexMatrixIndex) != 0) {
+			attr.mTexMtxIndex = data[layout.mTexMtxIndexOffset];
+		}
 
-	// Always present
-	attr.mPosition = mReader.readU16();
-	attr.mNormal   = mReader.readU16();
+		attr.mPosition = util::span_reader::load<u16>(data + layout.mPositionOffset);
+		attr.mNormal   = util::span_reader::load<u16>(data + layout.mNormalOffset);
 
-	// Color (optional)
-	if (mVCD & VCD::Color0) {
-		attr.mColor = mReader.readU16();
-	}
+		if constexpr ((Vcd & VCD::Color0) != 0) {
+			attr.mColor = util::span_reader::load<u16>(data + layout.mColorOffset);
+		}
 
-	// Texture coordinates
-	bool hasAnyTexcoord = false;
-	for (int i = 0; i < 8; ++i) {
-		if (mVCD & (VCD::Tex0 << i)) {
-			attr.mTexcoords[i] = mReader.readU16();
-			hasAnyTexcoord     = true;
+		for (u32 t = 0; t < layout.mTexCoordCount; ++t) {
+			attr.mTexcoords[layout.mTexCoordSlots[t]] = util::span_reader::load<u16>(data + layout.mTexCoordOffsets[t]);
 		}
 	}
+}
 
-	// CRITICAL: Based on the original code, if NO texcoords are present,
-	// it still writes 2 bytes (0,0). We need to read them!
-	if (!hasAnyTexcoord) {
-		mReader.readU8();
-		mReader.readU8();
+// Descriptors used by most stage and object meshes: an optional matrix index and colour with zero to two texcoords
+DisplayListReader::DecodeFn selectDecoder(u32 vcd)
+{
+	switch (vcd) {
+	case 0:
+		return decodeFixed<0>;
+	case VCD::MatrixIndex:
+		return decodeFixed<VCD::MatrixIndex>;
+	case VCD::Color0:
+		return decodeFixed<VCD::Color0>;
+	case VCD::MatrixIndex | VCD::Color0:
+		return decodeFixed<VCD::MatrixIndex | VCD::Color0>;
+	case VCD::Tex0:
+		return decodeFixed<VCD::Tex0>;
+	case VCD::MatrixIndex | VCD::Tex0:
+		return decodeFixed<VCD::MatrixIndex | VCD::Tex0>;
+	case VCD::Color0 | VCD::Tex0:
+		return decodeFixed<VCD::Color0 | VCD::Tex0>;
+	case VCD::MatrixIndex | VCD::Color0 | VCD::Tex0:
+		return decodeFixed<VCD::MatrixIndex | VCD::Color0 | VCD::Tex0>;
+	case VCD::Tex0 | VCD::Tex1:
+		return decodeFixed<VCD::Tex0 | VCD::Tex1>;
+	case VCD::MatrixIndex | VCD::Tex0 | VCD::Tex1:
+		return decodeFixed<VCD::MatrixIndex | VCD::Tex0 | VCD::Tex1>;
+	case VCD::Color0 | VCD::Tex0 | VCD::Tex1:
+		return decodeFixed<VCD::Color0 | VCD::Tex0 | VCD::Tex1>;
+	case VCD::MatrixIndex | VCD::Color0 | VCD::Tex0 | VCD::Tex1:
+		return decodeFixed<VCD::MatrixIndex | VCD::Color0 | VCD::Tex0 | VCD::Tex1>;
+	default:
+		return decodeGeneric;
 	}
+}
+} // namespace
 
-	return attr;
+DisplayListReader::DisplayListReader(util::span_reader& reader, u32 vcd)
+    : mReader(reader)
+    , mLayout(VertexLayout::fromDescriptor(vcd))
+    , mDecode(selectDecoder(vcd))
+{
 }
 
 FaceBatch DisplayListReader::readBatch()
@@ -62,13 +119,11 @@ FaceBatch DisplayListReader::readBatch()
 	batch.mPrimType = static_cast<PrimitiveType>(primType);
 	u16 vertexCount = mReader.readU16();
 
-	// Reserve space
-	batch.mVertices.reserve(vertexCount);
+	// Fetch every vertex of the batch with a single bounds check, then decode them in one pass
+	const std::span<const u8> vertexData = mReader.readSpan(static_cast<std::size_t>(vertexCount) * mLayout.mStride);
 
-	// Read all vertices
-	for (u16 i = 0; i < vertexCount; ++i) {
-		batch.mVertices.push_back(readVertex());
-	}
+	batch.mVertices.resize(vertexCount);
+	mDecode(mLayout, vertexData.data(), vertexCount, batch.mVertices.data());
 
 	// Update stats
 	mStats.mTotalVertices += vertexCount;
@@ -102,12 +157,16 @@ std::optional<FaceBatch> DisplayListReader::parseNext()
 
 std::vector<FaceBatch> DisplayListReader::parse()
 {
+	util::profiler::scope profile("parse", "display list");
+	profile.setBytes(mReader.getRemaining());
+
 	std::vector<FaceBatch> batches;
 
 	while (auto batch = parseNext()) {
 		batches.push_back(std::move(*batch));
 	}
 
+	profile.setElements(mStats.mTotalTriangles);
 	return batches;
 }
 
@@ -159,60 +218,732 @@ void FaceBatch::convertToTriangles()
 // Utility implementations
 namespace DListUtils {
 
+namespace {
+// Vertices are compared and hashed as raw bytes, which needs every byte to belong to a member
+static_assert(std::has_unique_object_representations_v<VertexAttrib>, "VertexAttrib must not contain padding");
+
+// Mixes all 22 bytes of a vertex, unlike shifting each member by a few bits neighbouring indices don't collide
+u64 hashVertex(const VertexAttrib& vertex)
+{
+	std::array<u64, (sizeof(VertexAttrib) + 7) / 8> words {};
+	std::memcpy(words.data(), &vertex, sizeof(VertexAttrib));
+
+	auto mix = [](u64 x) {
+		// The splitmix64 finaliser
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ull;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBull;
+		x ^= x >> 31;
+		return x;
+	};
+
+	u64 hash = 0x9E3779B97F4A7C15ull;
+	for (u64 word : words) {
+		hash = mix(hash ^ word);
+	}
+	return hash;
+}
+
+// Calls visit(a, b, c) for every triangle of a batch's vertices, with the same winding as convertToTriangles
+template <typename Visit>
+void forEachBatchTriangle(const FaceBatch& batch, Visit&& visit)
+{
+	const std::vector<VertexAttrib>& v = batch.mVertices;
+	if (batch.mPrimType == PrimitiveType::Triangles) {
+		for (std::size_t i = 0; i + 2 < v.size(); i += 3) {
+			visit(v[i], v[i + 1], v[i + 2]);
+		}
+	} else if (batch.mPrimType == PrimitiveType::TriangleStrip) {
+		for (std::size_t i = 0; i + 2 < v.size(); ++i) {
+			if (i & 1) {
+				visit(v[i + 1], v[i], v[i + 2]);
+			} else {
+				visit(v[i], v[i + 1], v[i + 2]);
+			}
+		}
+	}
+}
+
+// Size of the LRU cache the optimiser models, its scores work well for smaller FIFO caches too
+constexpr std::size_t ForsythCacheSize = 32;
+
+// How much the optimiser wants to use a vertex next, from its place in the modelled cache (-1 when it isn't in it)
+// and how many triangles still need it. Vertices with few triangles left are boosted so they get finished off
+float forsythScore(int cachePosition, u32 remainingTriangles)
+{
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// The last triangle's vertices get a fixed score, so the same triangle's neighbours don't always win
+			score = 0.75f;
+		} else {
+			const float scale = 1.0f / (ForsythCacheSize - 3);
+			score             = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+} // namespace
+
+void IndexedMeshBuilder::reserve(std::size_t vertices, std::size_t triangles)
+{
+	mMesh.vertices.reserve(mMesh.vertices.size() + vertices);
+	mMesh.indices.reserve(mMesh.indices.size() + triangles * 3);
+
+	// Keep the table at most half full
+	std::size_t capacity = 16;
+	while (capacity < (mMesh.vertices.size() + vertices) * 2) {
+		capacity *= 2;
+	}
+	if (capacity > mSlots.size()) {
+		rehash(capacity);
+	}
+}
+
+void IndexedMeshBuilder::rehash(std::size_t capacity)
+{
+	std::vector<Slot> old = std::move(mSlots);
+	mSlots.assign(capacity, Slot {});
+
+	const std::size_t mask = capacity - 1;
+	for (const Slot& slot : old) {
+		if (slot.mIndex == EmptySlot) {
+			continue;
+		}
+
+		std::size_t pos = slot.mHash & mask;
+		while (mSlots[pos].mIndex != EmptySlot) {
+			pos = (pos + 1) & mask;
+		}
+		mSlots[pos] = slot;
+	}
+}
+
+u32 IndexedMeshBuilder::findOrInsert(const VertexAttrib& vertex)
+{
+	if ((mMesh.vertices.size() + 1) * 2 > mSlots.size()) {
+		rehash(std::max<std::size_t>(16, mSlots.size() * 2));
+	}
+
+	const u32 hash         = static_cast<u32>(hashVertex(vertex));
+	const std::size_t mask = mSlots.size() - 1;
+	for (std::size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		Slot& slot = mSlots[pos];
+		if (slot.mIndex == EmptySlot) {
+			slot.mHash  = hash;
+			slot.mIndex = static_cast<u32>(mMesh.vertices.size());
+			mMesh.vertices.push_back(vertex);
+			return slot.mIndex;
+		}
+
+		if (slot.mHash == hash && std::memcmp(&mMesh.vertices[slot.mIndex], &vertex, sizeof(VertexAttrib)) == 0) {
+			return slot.mIndex;
+		}
+	}
+}
+
+void IndexedMeshBuilder::add(const Triangle& tri)
+{
+	for (const VertexAttrib& vertex : tri.mVertices) {
+		mMesh.indices.push_back(findOrInsert(vertex));
+	}
+}
+
+void IndexedMeshBuilder::add(const FaceBatch& batch)
+{
+	if (!batch.mTriangles.empty()) {
+		for (const Triangle& tri : batch.mTriangles) {
+			add(tri);
+		}
+		return;
+	}
+
+	forEachBatchTriangle(batch, [&](const VertexAttrib& a, const VertexAttrib& b, const VertexAttrib& c) {
+		mMesh.indices.push_back(findOrInsert(a));
+		mMesh.indices.push_back(findOrInsert(b));
+		mMesh.indices.push_back(findOrInsert(c));
+	});
+}
+
+void IndexedMeshBuilder::add(DisplayListReader& reader)
+{
+	const std::size_t bound = reader.getVertexBound();
+	reserve(bound, bound);
+	reader.forEachTriangle([&](const Triangle& tri) { add(tri); });
+}
+
+IndexedMesh IndexedMeshBuilder::take()
+{
+	mSlots.clear();
+	return std::move(mMesh);
+}
+
 IndexedMesh convertToIndexed(const std::vector<FaceBatch>& batches)
 {
-	IndexedMesh mesh;
+	std::size_t vertices  = 0;
+	std::size_t triangles = 0;
+	for (const FaceBatch& batch : batches) {
+		vertices += batch.mVertices.size();
+		triangles += batch.mTriangles.empty() ? batch.mVertices.size() : batch.mTriangles.size();
+	}
+
+	IndexedMeshBuilder builder;
+	builder.reserve(vertices, triangles);
+	for (const FaceBatch& batch : batches) {
+		builder.add(batch);
+	}
+
+	return builder.take();
+}
+
+IndexedMesh convertToIndexed(DisplayListReader& reader)
+{
+	IndexedMeshBuilder builder;
+	builder.add(reader);
+	return builder.take();
+}
+
+std::vector<IndexedMesh> splitIndexed(const IndexedMesh& mesh, std::size_t maxVertices)
+{
+	maxVertices = std::max<std::size_t>(maxVertices, 3);
+
+	std::vector<IndexedMesh> parts;
+	if (mesh.vertices.size() <= maxVertices) {
+		parts.push_back(mesh);
+		return parts;
+	}
+
+	// Where each vertex went in the current part, valid while partOf matches the part's number
+	std::vector<u32> localIndex(mesh.vertices.size());
+	std::vector<u32> partOf(mesh.vertices.size(), 0xFFFFFFFF);
+
+	parts.emplace_back();
+	for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		u32 part = static_cast<u32>(parts.size() - 1);
+
+		std::size_t added = 0;
+		for (std::size_t k = 0; k < 3; ++k) {
+			added += partOf[mesh.indices[i + k]] != part ? 1 : 0;
+		}
 
-	// Hash function for vertex deduplication
-	struct VertexHash {
-		size_t operator()(const VertexAttrib& v) const
-		{
-			size_t h = 0;
-			h ^= std::hash<u16> {}(v.mPosition) << 1;
-			h ^= std::hash<u16> {}(v.mNormal) << 2;
-			h ^= std::hash<u16> {}(v.mColor) << 3;
-			h ^= std::hash<u8> {}(v.mMatrixIndex) << 4;
-			h ^= std::hash<u8> {}(v.mTexMtxIndex) << 5;
-			for (int i = 0; i < 8; ++i) {
-				h ^= std::hash<u16> {}(v.mTexcoords[i]) << (6 + i);
+		if (parts.back().vertices.size() + added > maxVertices) {
+			parts.emplace_back();
+			part++;
+		}
+
+		IndexedMesh& current = parts.back();
+		for (std::size_t k = 0; k < 3; ++k) {
+			const u32 index = mesh.indices[i + k];
+			if (partOf[index] != part) {
+				partOf[index]     = part;
+				localIndex[index] = static_cast<u32>(current.vertices.size());
+				current.vertices.push_back(mesh.vertices[index]);
 			}
-			return h;
+			current.indices.push_back(localIndex[index]);
 		}
+	}
+
+	return parts;
+}
+
+std::vector<IndexedPrimitive> stripify(const std::vector<u32>& indices, std::size_t minStripTriangles, std::size_t maxVertices,
+                                       std::size_t window)
+{
+	maxVertices = std::max<std::size_t>(maxVertices, 3);
+
+	// Every directed edge of every triangle, sorted so the triangles that can follow an edge sit together
+	struct Edge {
+		u64 mKey;
+		u32 mTriangle;
+		u32 mOpposite; // The triangle's vertex that isn't on the edge
 	};
 
-	struct VertexEqual {
-		bool operator()(const VertexAttrib& a, const VertexAttrib& b) const
-		{
-			return a.mPosition == b.mPosition && a.mNormal == b.mNormal && a.mColor == b.mColor && a.mMatrixIndex == b.mMatrixIndex
-			    && a.mTexMtxIndex == b.mTexMtxIndex
-			    && std::equal(std::begin(a.mTexcoords), std::end(a.mTexcoords), std::begin(b.mTexcoords));
+	auto edgeKey = [](u32 from, u32 to) { return (static_cast<u64>(from) << 32) | to; };
+
+	std::vector<u32> triangles;
+	triangles.reserve(indices.size() - indices.size() % 3);
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const u32 a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (a != b && b != c && a != c) {
+			triangles.insert(triangles.end(), { a, b, c });
+		}
+	}
+
+	const u32 triCount = static_cast<u32>(triangles.size() / 3);
+
+	std::vector<Edge> edges;
+	edges.reserve(triangles.size());
+	for (u32 t = 0; t < triCount; ++t) {
+		const u32* v = triangles.data() + t * 3;
+		edges.push_back({ edgeKey(v[0], v[1]), t, v[2] });
+		edges.push_back({ edgeKey(v[1], v[2]), t, v[0] });
+		edges.push_back({ edgeKey(v[2], v[0]), t, v[1] });
+	}
+	std::sort(edges.begin(), edges.end(),
+	          [](const Edge& a, const Edge& b) { return a.mKey != b.mKey ? a.mKey < b.mKey : a.mTriangle < b.mTriangle; });
+
+	// 0 is free, 1 is in a finished primitive, anything higher marks the triangles a trial strip has taken
+	constexpr u32 Free      = 0;
+	constexpr u32 Committed = 1;
+	std::vector<u32> marks(triCount, Free);
+	u32 trial = Committed;
+
+	// Appends vertices to the strip while some free triangle continues it, marking the triangles it takes with stamp
+	u32 limit = triCount; // Triangles from here on can't continue the current strip
+	auto grow = [&](std::vector<u32>& strip, u32 stamp) {
+		while (strip.size() < maxVertices) {
+			// Triangle k of a strip is (k, k+1, k+2) when k is even and (k+1, k, k+2) when it's odd,
+			// so the next one has to run along the last edge, or against it on odd triangles
+			const std::size_t k = strip.size() - 2;
+			const u32 p         = strip[strip.size() - 2];
+			const u32 q         = strip[strip.size() - 1];
+			const u64 key       = (k & 1) ? edgeKey(q, p) : edgeKey(p, q);
+
+			auto it = std::lower_bound(edges.begin(), edges.end(), key, [](const Edge& edge, u64 value) { return edge.mKey < value; });
+			for (; it != edges.end() && it->mKey == key; ++it) {
+				const u32 mark = marks[it->mTriangle];
+				if (mark != Committed && mark != stamp && it->mTriangle < limit) {
+					break;
+				}
+			}
+
+			if (it == edges.end() || it->mKey != key) {
+				return;
+			}
+
+			marks[it->mTriangle] = stamp;
+			strip.push_back(it->mOpposite);
 		}
 	};
 
-	std::unordered_map<VertexAttrib, u16, VertexHash, VertexEqual> vertexMap;
+	std::vector<IndexedPrimitive> primitives;
+	std::vector<u32> lists; // Triangles of strips too short to keep, in their winding
 
-	for (const auto& batch : batches) {
-		// Ensure triangles are generated
-		const_cast<FaceBatch&>(batch).convertToTriangles();
-
-		for (const auto& tri : batch.mTriangles) {
-			for (int i = 0; i < 3; ++i) {
-				const auto& v = tri.mVertices[i];
-
-				auto it = vertexMap.find(v);
-				if (it == vertexMap.end()) {
-					u16 idx      = static_cast<u16>(mesh.vertices.size());
-					vertexMap[v] = idx;
-					mesh.vertices.push_back(v);
-					mesh.indices.push_back(idx);
+	std::vector<u32> strip;
+	std::vector<u32> best;
+	for (u32 start = 0; start < triCount; ++start) {
+		if (marks[start] == Committed) {
+			continue;
+		}
+
+		// Try the strip starting on each edge of the first triangle and keep the longest
+		const u32* v = triangles.data() + start * 3;
+		limit        = window == 0 ? triCount : static_cast<u32>(std::min<std::size_t>(start + window, triCount));
+		best.clear();
+		for (u32 rotation = 0; rotation < 3; ++rotation) {
+			strip.assign({ v[rotation], v[(rotation + 1) % 3], v[(rotation + 2) % 3] });
+			marks[start] = ++trial;
+			grow(strip, trial);
+			if (strip.size() > best.size()) {
+				best.swap(strip);
+			}
+		}
+
+		// Replaying the winner leaves exactly its triangles committed
+		strip.assign(best.begin(), best.begin() + 3);
+		marks[start] = Committed;
+		grow(strip, Committed);
+
+		// Trial stamps only have to differ from each other, start over before they run out
+		if (trial > 0xFFFFFFF0) {
+			for (u32& mark : marks) {
+				mark = mark == Committed ? Committed : Free;
+			}
+			trial = Committed;
+		}
+
+		if (strip.size() - 2 >= std::max<std::size_t>(minStripTriangles, 1)) {
+			primitives.push_back({ PrimitiveType::TriangleStrip, strip });
+			continue;
+		}
+
+		for (std::size_t k = 0; k + 2 < strip.size(); ++k) {
+			if (k & 1) {
+				lists.insert(lists.end(), { strip[k + 1], strip[k], strip[k + 2] });
+			} else {
+				lists.insert(lists.end(), { strip[k], strip[k + 1], strip[k + 2] });
+			}
+		}
+	}
+
+	const std::size_t listVertices = maxVertices - maxVertices % 3;
+	for (std::size_t i = 0; i < lists.size(); i += listVertices) {
+		const std::size_t end = std::min(i + listVertices, lists.size());
+		primitives.push_back({ PrimitiveType::Triangles, std::vector<u32>(lists.begin() + i, lists.begin() + end) });
+	}
+
+	return primitives;
+}
+
+std::vector<DisplayList> encodeDisplayLists(const std::vector<IndexedPrimitive>& primitives, const std::vector<VertexAttrib>& vertices,
+                                            u32 descriptor, DLFlags flags, std::size_t maxBytes)
+{
+	const VertexLayout layout = VertexLayout::fromDescriptor(descriptor);
+
+	// Every display list has room for at least one triangle, and its padding never takes it over the limit
+	maxBytes = std::max(maxBytes, 3 + 3 * layout.mStride + DisplayListWriter::Alignment);
+	maxBytes -= maxBytes % DisplayListWriter::Alignment;
+
+	std::size_t remainingBytes = 0;
+	for (const IndexedPrimitive& primitive : primitives) {
+		remainingBytes += 3 + primitive.mIndices.size() * layout.mStride;
+	}
+
+	std::vector<DisplayList> dlists;
+	util::vector_writer writer;
+	std::optional<DisplayListWriter> dlWriter;
+
+	// Each display list gets its own buffer, sized for what's left so small meshes don't reserve the maximum
+	auto begin = [&]() {
+		writer.clear();
+		writer.reserve(std::min(maxBytes, remainingBytes + DisplayListWriter::Alignment));
+		dlWriter.emplace(writer, descriptor);
+	};
+
+	auto flush = [&]() {
+		if (dlWriter->getCommandCount() == 0) {
+			return;
+		}
+
+		remainingBytes -= std::min(remainingBytes, dlWriter->getSize());
+
+		DisplayList& dlist  = dlists.emplace_back();
+		dlist.mFlags        = flags;
+		dlist.mCommandCount = dlWriter->finish();
+		dlist.mData         = writer.takeBuffer();
+		begin();
+	};
+
+	begin();
+
+	for (const IndexedPrimitive& primitive : primitives) {
+		// Strip pieces overlap by two vertices and start on an even triangle, list pieces hold whole triangles
+		const bool isStrip      = primitive.mType == PrimitiveType::TriangleStrip;
+		std::size_t maxVertices = std::min<std::size_t>((maxBytes - 3) / layout.mStride, 0xFFFF);
+		maxVertices -= isStrip ? maxVertices % 2 : maxVertices % 3;
+		const std::size_t advance = isStrip ? maxVertices - 2 : maxVertices;
+
+		for (std::size_t first = 0; first + 2 < primitive.mIndices.size(); first += advance) {
+			const std::size_t count = std::min(maxVertices, primitive.mIndices.size() - first);
+			if (dlWriter->getSize() + dlWriter->getPrimitiveSize(count) > maxBytes) {
+				flush();
+			}
+
+			dlWriter->writePrimitive(primitive.mType, std::span(primitive.mIndices).subspan(first, count), vertices);
+		}
+	}
+
+	flush();
+	return dlists;
+}
+
+std::vector<PalettePacket> splitByMatrixPalette(const std::vector<u32>& indices, const std::vector<u32>& vertexMatrices,
+                                                std::size_t paletteSize)
+{
+	// A triangle never needs more than three matrices
+	paletteSize = std::max<std::size_t>(paletteSize, 3);
+
+	constexpr u32 NoMatrix = 0xFFFFFFFF;
+
+	// Triangles that need the same matrices are always placed together
+	struct Group {
+		std::array<u32, 3> mMatrices; // Sorted, unused entries are NoMatrix
+		std::vector<u32> mTriangles;
+	};
+
+	std::vector<Group> groups;
+	std::map<std::array<u32, 3>, u32> groupOf;
+	for (u32 t = 0; t < indices.size() / 3; ++t) {
+		std::array<u32, 3> matrices;
+		for (u32 k = 0; k < 3; ++k) {
+			matrices[k] = vertexMatrices[indices[t * 3 + k]];
+		}
+		std::sort(matrices.begin(), matrices.end());
+		std::fill(std::unique(matrices.begin(), matrices.end()), matrices.end(), NoMatrix);
+
+		const auto [it, inserted] = groupOf.try_emplace(matrices, static_cast<u32>(groups.size()));
+		if (inserted) {
+			groups.push_back({ matrices, {} });
+		}
+		groups[it->second].mTriangles.push_back(t);
+	}
+
+	std::vector<u32> remaining(groups.size());
+	std::iota(remaining.begin(), remaining.end(), 0);
+
+	std::vector<PalettePacket> packets;
+	std::vector<u32> previous; // The last packet's slots
+	std::vector<u32> needed;   // Matrices the packet being built uses
+	std::vector<u32> taken;    // Groups in the packet being built
+
+	auto contains = [](const std::vector<u32>& list, u32 matrix) { return std::find(list.begin(), list.end(), matrix) != list.end(); };
+
+	while (!remaining.empty()) {
+		needed.clear();
+		taken.clear();
+
+		while (!remaining.empty()) {
+			// Everything that fits without another matrix goes in for free
+			for (std::size_t i = 0; i < remaining.size();) {
+				const Group& group = groups[remaining[i]];
+				const bool fits    = std::all_of(group.mMatrices.begin(), group.mMatrices.end(),
+				                                 [&](u32 matrix) { return matrix == NoMatrix || contains(needed, matrix); });
+				if (fits && !needed.empty()) {
+					taken.push_back(remaining[i]);
+					remaining[i] = remaining.back();
+					remaining.pop_back();
 				} else {
-					mesh.indices.push_back(it->second);
+					++i;
 				}
 			}
+
+			// Then the group that adds the fewest matrices, ideally ones the previous packet already loaded
+			std::size_t best   = remaining.size();
+			u32 bestAdded      = 4;
+			u32 bestReused     = 0;
+			std::size_t bestId = 0;
+			for (std::size_t i = 0; i < remaining.size(); ++i) {
+				const Group& group = groups[remaining[i]];
+				u32 added          = 0;
+				u32 reused         = 0;
+				for (u32 matrix : group.mMatrices) {
+					if (matrix != NoMatrix && !contains(needed, matrix)) {
+						added++;
+						reused += contains(previous, matrix) ? 1 : 0;
+					}
+				}
+
+				if (needed.size() + added > paletteSize) {
+					continue;
+				}
+
+				// Earlier triangles break ties, which keeps neighbouring triangles in the same packet
+				const std::size_t id = group.mTriangles.front();
+				if (added < bestAdded || (added == bestAdded && (reused > bestReused || (reused == bestReused && id < bestId)))) {
+					best       = i;
+					bestAdded  = added;
+					bestReused = reused;
+					bestId     = id;
+				}
+			}
+
+			if (best == remaining.size()) {
+				break;
+			}
+
+			for (u32 matrix : groups[remaining[best]].mMatrices) {
+				if (matrix != NoMatrix && !contains(needed, matrix)) {
+					needed.push_back(matrix);
+				}
+			}
+			taken.push_back(remaining[best]);
+			remaining[best] = remaining.back();
+			remaining.pop_back();
+		}
+
+		// Matrices the previous packet loaded keep their slot, new ones take the first slot nothing here needs.
+		// Slots in between that aren't needed keep their old matrix, so they cost nothing either
+		std::vector<u32> slots = previous;
+		std::vector<bool> kept(slots.size(), false);
+		for (std::size_t s = 0; s < slots.size(); ++s) {
+			kept[s] = contains(needed, slots[s]);
+		}
+
+		std::size_t freeSlot = 0;
+		for (u32 matrix : needed) {
+			if (contains(previous, matrix)) {
+				continue;
+			}
+
+			while (freeSlot < slots.size() && kept[freeSlot]) {
+				freeSlot++;
+			}
+			if (freeSlot == slots.size()) {
+				slots.push_back(matrix);
+				kept.push_back(true);
+			} else {
+				slots[freeSlot] = matrix;
+				kept[freeSlot]  = true;
+			}
+		}
+
+		while (!slots.empty() && !kept[slots.size() - 1]) {
+			slots.pop_back();
+			kept.pop_back();
+		}
+
+		PalettePacket& packet = packets.emplace_back();
+		packet.mMatrices      = slots;
+
+		std::vector<u32> triangles;
+		for (u32 group : taken) {
+			triangles.insert(triangles.end(), groups[group].mTriangles.begin(), groups[group].mTriangles.end());
+		}
+		std::sort(triangles.begin(), triangles.end());
+
+		packet.mIndices.reserve(triangles.size() * 3);
+		for (u32 t : triangles) {
+			packet.mIndices.insert(packet.mIndices.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+		}
+
+		previous = std::move(slots);
+	}
+
+	return packets;
+}
+
+void optimizeVertexCache(std::vector<u32>& indices, std::size_t vertexCount)
+{
+	const std::size_t triCount = indices.size() / 3;
+	if (triCount < 2) {
+		return;
+	}
+
+	constexpr u32 NoTriangle = 0xFFFFFFFF;
+
+	// The triangles still waiting for each vertex, packed into one array. A vertex's live triangles are
+	// the first remaining[v] entries from offsets[v], emitted ones are swapped past the end
+	std::vector<u32> remaining(vertexCount, 0);
+	for (std::size_t i = 0; i < triCount * 3; ++i) {
+		remaining[indices[i]]++;
+	}
+
+	std::vector<u32> offsets(vertexCount + 1, 0);
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+
+	std::vector<u32> vertexTriangles(triCount * 3);
+	{
+		std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+		for (std::size_t i = 0; i < triCount * 3; ++i) {
+			vertexTriangles[cursor[indices[i]]++] = static_cast<u32>(i / 3);
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		vertexScore[v] = forsythScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	u32 best        = 0;
+	float bestScore = -1.0f;
+	for (std::size_t t = 0; t < triCount; ++t) {
+		const u32* v     = indices.data() + t * 3;
+		triangleScore[t] = vertexScore[v[0]] + vertexScore[v[1]] + vertexScore[v[2]];
+		if (triangleScore[t] > bestScore) {
+			best      = static_cast<u32>(t);
+			bestScore = triangleScore[t];
 		}
 	}
 
-	return mesh;
+	std::vector<u32> output;
+	output.reserve(triCount * 3);
+	std::vector<u32> cache;
+	std::vector<u32> nextCache;
+	cache.reserve(ForsythCacheSize + 3);
+	nextCache.reserve(ForsythCacheSize + 3);
+	std::size_t scanCursor = 0;
+
+	for (std::size_t n = 0; n < triCount; ++n) {
+		if (best == NoTriangle) {
+			// Nothing in the cache has triangles left, carry on from the earliest triangle not drawn yet
+			while (emitted[scanCursor]) {
+				scanCursor++;
+			}
+			best = static_cast<u32>(scanCursor);
+		}
+
+		const u32* tri = indices.data() + best * 3;
+		output.insert(output.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		for (u32 k = 0; k < 3; ++k) {
+			const u32 v = tri[k];
+			u32* first  = vertexTriangles.data() + offsets[v];
+			u32* last   = first + remaining[v] - 1;
+			std::iter_swap(std::find(first, last + 1, best), last);
+			remaining[v]--;
+		}
+
+		// The triangle's vertices move to the front of the cache, everything else shifts back
+		nextCache.assign(tri, tri + 3);
+		for (u32 v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				nextCache.push_back(v);
+			}
+		}
+
+		for (std::size_t i = ForsythCacheSize; i < nextCache.size(); ++i) {
+			cachePosition[nextCache[i]] = -1;
+			vertexScore[nextCache[i]]   = forsythScore(-1, remaining[nextCache[i]]);
+		}
+		nextCache.resize(std::min(nextCache.size(), ForsythCacheSize));
+		cache.swap(nextCache);
+
+		for (std::size_t i = 0; i < cache.size(); ++i) {
+			cachePosition[cache[i]] = static_cast<int>(i);
+			vertexScore[cache[i]]   = forsythScore(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		// Only triangles touching the cache changed score, the best of them goes next
+		best      = NoTriangle;
+		bestScore = -1.0f;
+		for (u32 v : cache) {
+			for (u32 i = 0; i < remaining[v]; ++i) {
+				const u32 t      = vertexTriangles[offsets[v] + i];
+				const u32* other = indices.data() + t * 3;
+				triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+				if (triangleScore[t] > bestScore) {
+					best      = t;
+					bestScore = triangleScore[t];
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+VertexCacheSim::VertexCacheSim(std::size_t size)
+    : mEntries(std::max<std::size_t>(size, 1))
+{
+}
+
+void VertexCacheSim::add(const DisplayList& dlist, u32 descriptor)
+{
+	util::span_reader reader(dlist.mData);
+	DisplayListReader dlReader(reader, descriptor);
+
+	while (std::optional<FaceBatch> batch = dlReader.parseNext()) {
+		const std::size_t count = batch->mVertices.size();
+		if (batch->mPrimType == PrimitiveType::TriangleStrip) {
+			mTriangles += count >= 3 ? count - 2 : 0;
+		} else {
+			mTriangles += count / 3;
+		}
+
+		for (const VertexAttrib& vertex : batch->mVertices) {
+			auto same = [&](const VertexAttrib& entry) { return std::memcmp(&entry, &vertex, sizeof(VertexAttrib)) == 0; };
+			if (std::any_of(mEntries.begin(), mEntries.begin() + mFilled, same)) {
+				continue;
+			}
+
+			mMisses++;
+			mEntries[mNext] = vertex;
+			mNext           = (mNext + 1) % mEntries.size();
+			mFilled         = std::min(mFilled + 1, mEntries.size());
+		}
+	}
 }
 
 std::vector<FaceBatch> optimizeBatches(const std::vector<FaceBatch>& batches)
@@ -1,9 +1,11 @@
 #ifndef COMMON_DISPLAYLISTREADER_HPP
 #define COMMON_DISPLAYLISTREADER_HPP
 
-#include "../util/vector_reader.hpp"
+#include "../util/profiler.hpp"
+#include "../util/span_reader.hpp"
 #include "../types.hpp"
 #include "mesh.hpp"
+#include <array>
 #include <span>
 #include <optional>
 
@@ -47,6 +49,61 @@ struct FaceBatch {
 	const std::vector<Triangle>& getTriangles() const { return mTriangles; }
 };
 
+// Where each attribute sits inside a vertex for one vertex descriptor (Mesh::mVtxDescriptor)
+struct VertexLayout {
+	u32 mDescriptor        = 0;
+	u32 mStride            = 0; // Bytes per vertex
+	u32 mMatrixIndexOffset = 0; // The offsets are only meaningful for attributes the descriptor enables
+	u32 mTexMtxIndexOffset = 0;
+	u32 mPositionOffset    = 0;
+	u32 mNormalOffset      = 0;
+	u32 mColorOffset       = 0;
+	u32 mTexCoordCount     = 0;
+	std::array<u8, 8> mTexCoordSlots {};   // Which of the 8 texcoords each stored one is, in file order
+	std::array<u8, 8> mTexCoordOffsets {}; // Offset of each stored texcoord
+
+	static constexpr VertexLayout fromDescriptor(u32 vcd)
+	{
+		VertexLayout layout;
+		layout.mDescriptor = vcd;
+
+		u32 offset = 0;
+		if (vcd & VCD::MatrixIndex) {
+			layout.mMatrixIndexOffset = offset++;
+		}
+		if (vcd & VCD::TexMatrixIndex) {
+			layout.mTexMtxIndexOffset = offset++;
+		}
+
+		// Position and normal are always present
+		layout.mPositionOffset = offset;
+		layout.mNormalOffset   = offset + 2;
+		offset += 4;
+
+		if (vcd & VCD::Color0) {
+			layout.mColorOffset = offset;
+			offset += 2;
+		}
+
+		for (u32 i = 0; i < 8; ++i) {
+			if (vcd & (VCD::Tex0 << i)) {
+				layout.mTexCoordSlots[layout.mTexCoordCount]   = static_cast<u8>(i);
+				layout.mTexCoordOffsets[layout.mTexCoordCount] = static_cast<u8>(offset);
+				layout.mTexCoordCount++;
+				offset += 2;
+			}
+		}
+
+		// If NO texcoords are present the original tool still writes 2 bytes (0,0)
+		if (layout.mTexCoordCount == 0) {
+			offset += 2;
+		}
+
+		layout.mStride = offset;
+		return layout;
+	}
+};
+
 class DisplayListReader {
 public:
 	struct Options {
@@ -57,7 +114,7 @@ public:
 		Options() = default;
 	};
 
-	DisplayListReader(util::vector_reader& reader, u32 vcd);
+	DisplayListReader(util::span_reader& reader, u32 vcd);
 
 	// Parse all batches
 	std::vector<FaceBatch> parse();
@@ -65,6 +122,11 @@ public:
 	// Parse single batch (for streaming)
 	std::optional<FaceBatch> parseNext();
 
+	// Decode strips and lists on the fly and call callback(const Triangle&) for every triangle, in the same order
+	// and winding as parse() but without building any batches
+	template <typename Callback>
+	void forEachTriangle(Callback&& callback);
+
 	// Get statistics
 	struct Stats {
 		size_t mTotalVertices  = 0;
@@ -74,16 +136,91 @@ public:
 	};
 	const Stats& getStats() const { return mStats; }
 
+	// Most vertices the rest of the display list can hold, for sizing output up front
+	std::size_t getVertexBound() const { return mReader.getRemaining() / mLayout.mStride; }
+
+	// Decodes count packed vertices laid out as layout describes
+	using DecodeFn = void (*)(const VertexLayout& layout, const u8* data, std::size_t count, VertexAttrib* out);
+
 private:
-	util::vector_reader& mReader;
-	u32 mVCD;
+	util::span_reader& mReader;
+	VertexLayout mLayout;
+	DecodeFn mDecode; // Specialised for common descriptors, table driven for the rest
 	Options mOptions;
 	Stats mStats;
 
-	VertexAttrib readVertex();
 	FaceBatch readBatch();
 };
 
+template <typename Callback>
+void DisplayListReader::forEachTriangle(Callback&& callback)
+{
+	// Includes the time spent in the callback, so it's kept apart from parse()
+	util::profiler::scope profile("parse", "display list (visited)");
+	profile.setBytes(mReader.getRemaining());
+
+	// Vertices are decoded a block at a time, the two before the block are kept in front of it because the
+	// next triangle still needs them
+	constexpr std::size_t BlockSize = 64;
+	std::array<VertexAttrib, BlockSize + 2> window {};
+
+	const std::size_t trianglesBefore = mStats.mTotalTriangles;
+	while (mReader.getRemaining() > 0) {
+		const u8 primType = mReader.readU8();
+		if (primType != static_cast<u8>(PrimitiveType::TriangleStrip) && primType != static_cast<u8>(PrimitiveType::Triangles)) {
+			mReader.setPosition(mReader.getPosition() - 1);
+			break;
+		}
+
+		const bool isStrip                   = primType == static_cast<u8>(PrimitiveType::TriangleStrip);
+		const u16 vertexCount                = mReader.readU16();
+		const std::span<const u8> vertexData = mReader.readSpan(static_cast<std::size_t>(vertexCount) * mLayout.mStride);
+		if (vertexCount == 0) {
+			break;
+		}
+
+		for (std::size_t first = 0; first < vertexCount; first += BlockSize) {
+			const std::size_t count = std::min<std::size_t>(BlockSize, vertexCount - first);
+			if (first != 0) {
+				window[0] = window[BlockSize];
+				window[1] = window[BlockSize + 1];
+			}
+			mDecode(mLayout, vertexData.data() + first * mLayout.mStride, count, window.data() + 2);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				// Vertex j completes a triangle when it's the third of a list entry, or any vertex from the third on in a strip
+				const std::size_t j = first + i;
+				if (j < 2 || (!isStrip && j % 3 != 2)) {
+					continue;
+				}
+
+				const VertexAttrib* v = window.data() + i; // v[0], v[1], v[2] are vertices j - 2, j - 1 and j
+				Triangle tri;
+				if (isStrip && (j & 1)) {
+					// Odd triangles are reversed for correct winding
+					tri.mVertices[0] = v[1];
+					tri.mVertices[1] = v[0];
+				} else {
+					tri.mVertices[0] = v[0];
+					tri.mVertices[1] = v[1];
+				}
+				tri.mVertices[2] = v[2];
+
+				callback(static_cast<const Triangle&>(tri));
+				mStats.mTotalTriangles++;
+			}
+		}
+
+		mStats.mTotalVertices += vertexCount;
+		mStats.mBatchCount++;
+		if (isStrip) {
+			mStats.mStripCount++;
+		}
+	}
+
+	profile.setElements(mStats.mTotalTriangles - trianglesBefore);
+}
+
 // Utility functions
 namespace DListUtils {
 
@@ -93,10 +230,107 @@ std::vector<FaceBatch> optimizeBatches(const std::vector<FaceBatch>& batches);
 // Convert to indexed triangle list
 struct IndexedMesh {
 	std::vector<VertexAttrib> vertices;
-	std::vector<u16> indices;
+	std::vector<u32> indices; // Three per triangle
+};
+
+// Welds identical vertices into an IndexedMesh, triangles from any number of display lists can be added
+class IndexedMeshBuilder {
+public:
+	// Size the tables up front, e.g. from DisplayListReader stats, so adding never has to grow them
+	void reserve(std::size_t vertices, std::size_t triangles);
+
+	void add(const Triangle& tri);
+
+	// Uses the batch's triangles, or works them out from its vertices if it has none, without modifying it
+	void add(const FaceBatch& batch);
+
+	// Streams the rest of the display list through forEachTriangle
+	void add(DisplayListReader& reader);
+
+	std::size_t getVertexCount() const { return mMesh.vertices.size(); }
+
+	IndexedMesh take();
+
+private:
+	static constexpr u32 EmptySlot = 0xFFFFFFFF;
+
+	// Open addressing with linear probing, the hash is kept next to the index so most misses never touch the vertex
+	struct Slot {
+		u32 mHash  = 0;
+		u32 mIndex = EmptySlot;
+	};
+
+	u32 findOrInsert(const VertexAttrib& vertex);
+	void rehash(std::size_t capacity);
+
+	IndexedMesh mMesh;
+	std::vector<Slot> mSlots;
 };
 
 IndexedMesh convertToIndexed(const std::vector<FaceBatch>& batches);
+
+// Same as above, straight from the display list without parsing it into batches first
+IndexedMesh convertToIndexed(DisplayListReader& reader);
+
+// Splits a mesh into parts of at most maxVertices vertices, for formats limited to 16-bit indices.
+// Triangles stay whole and in order, so each part can still hold at least one
+std::vector<IndexedMesh> splitIndexed(const IndexedMesh& mesh, std::size_t maxVertices = 65535);
+
+// One primitive of a display list being built, as indices into a vertex pool
+struct IndexedPrimitive {
+	PrimitiveType mType = PrimitiveType::TriangleStrip;
+	std::vector<u32> mIndices;
+};
+
+// Greedily joins an index buffer's triangles (three indices each) into strips that keep their winding.
+// Strips with fewer than minStripTriangles triangles are gathered into triangle lists at the end instead,
+// no primitive holds more than maxVertices indices and degenerate triangles are dropped. A non-zero window
+// only lets a strip take triangles less than window places after the first one not yet used, which keeps
+// the order of a cache optimised index buffer instead of following strips across the whole mesh
+std::vector<IndexedPrimitive> stripify(const std::vector<u32>& indices, std::size_t minStripTriangles = 2,
+                                       std::size_t maxVertices = 65535, std::size_t window = 0);
+
+// Packs primitives over a vertex pool into display lists of at most maxBytes, with vertices laid out for the descriptor.
+// Primitives that don't fit are split, strips on an even triangle so they keep their winding
+std::vector<DisplayList> encodeDisplayLists(const std::vector<IndexedPrimitive>& primitives, const std::vector<VertexAttrib>& vertices,
+                                            u32 descriptor, DLFlags flags, std::size_t maxBytes = 0x4000);
+
+// The triangles of one mesh packet and the matrix palette they're drawn with
+struct PalettePacket {
+	std::vector<u32> mMatrices; // The mVertexMatrices index loaded into each slot, vertices refer to slot i as matrix index i * 3
+	std::vector<u32> mIndices;  // Three per triangle, in their original order
+};
+
+// Partitions an index buffer's triangles into as few packets as it can whose vertices use at most paletteSize
+// matrices, vertexMatrices gives each vertex's mVertexMatrices index. Each packet greedily takes the triangles
+// that add the fewest new matrices, preferring ones still loaded by the previous packet, and matrices shared
+// with the previous packet stay in the same slot so they don't have to be loaded again
+std::vector<PalettePacket> splitByMatrixPalette(const std::vector<u32>& indices, const std::vector<u32>& vertexMatrices,
+                                                std::size_t paletteSize = 10);
+
+// Reorders an index buffer's triangles (three indices each) so they reuse recently transformed vertices, following
+// Tom Forsyth's linear-speed vertex cache optimisation. The triangles and their winding are left as they are
+void optimizeVertexCache(std::vector<u32>& indices, std::size_t vertexCount);
+
+// Counts the misses of a FIFO post-transform vertex cache, for average cache miss ratios (misses per triangle)
+class VertexCacheSim {
+public:
+	explicit VertexCacheSim(std::size_t size);
+
+	// Runs a display list's vertices through the cache in draw order, the cache carries over between calls
+	void add(const DisplayList& dlist, u32 descriptor);
+
+	u64 getTriangles() const { return mTriangles; }
+	u64 getMisses() const { return mMisses; }
+	double getACMR() const { return mTriangles == 0 ? 0.0 : static_cast<double>(mMisses) / mTriangles; }
+
+private:
+	std::vector<VertexAttrib> mEntries;
+	std::size_t mFilled = 0;
+	std::size_t mNext   = 0; // The entry the next miss replaces
+	u64 mTriangles      = 0;
+	u64 mMisses         = 0;
+};
 } // namespace DListUtils
 
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "dlist_writer.hpp"
+#include <stdexcept>
+#include <string>
+
+DisplayListWriter::DisplayListWriter(util::vector_writer& writer, u32 vcd)
+    : mWriter(writer)
+    , mLayout(VertexLayout::fromDescriptor(vcd))
+    , mStart(writer.getPosition())
+{
+}
+
+void DisplayListWriter::writeStrip(std::span<const VertexAttrib> vertices)
+{
+	if (vertices.size() < 3) {
+		throw std::invalid_argument("DisplayListWriter: a strip needs at least 3 vertices, got " + std::to_string(vertices.size()));
+	}
+
+	writeHeader(PrimitiveType::TriangleStrip, vertices.size());
+	for (const VertexAttrib& vertex : vertices) {
+		writeVertex(vertex);
+	}
+}
+
+void DisplayListWriter::writeTriangles(std::span<const VertexAttrib> vertices)
+{
+	if (vertices.empty() || vertices.size() % 3 != 0) {
+		throw std::invalid_argument("DisplayListWriter: a triangle list needs a multiple of 3 vertices, got "
+		                            + std::to_string(vertices.size()));
+	}
+
+	writeHeader(PrimitiveType::Triangles, vertices.size());
+	for (const VertexAttrib& vertex : vertices) {
+		writeVertex(vertex);
+	}
+}
+
+void DisplayListWriter::writePrimitive(PrimitiveType type, std::span<const u32> indices, std::span<const VertexAttrib> pool)
+{
+	const bool isStrip = type == PrimitiveType::TriangleStrip;
+	if (isStrip ? indices.size() < 3 : indices.empty() || indices.size() % 3 != 0) {
+		throw std::invalid_argument("DisplayListWriter: " + std::to_string(indices.size()) + " vertices don't make a "
+		                            + (isStrip ? "strip" : "triangle list"));
+	}
+
+	writeHeader(type, indices.size());
+	for (u32 index : indices) {
+		if (index >= pool.size()) {
+			throw std::out_of_range("DisplayListWriter: vertex " + std::to_string(index) + " is outside the pool of "
+			                        + std::to_string(pool.size()));
+		}
+		writeVertex(pool[index]);
+	}
+}
+
+u32 DisplayListWriter::finish()
+{
+	// GX_NOP is 0, so zero padding is all that's needed
+	const std::size_t padding = (Alignment - getSize() % Alignment) % Alignment;
+	for (std::size_t i = 0; i < padding; ++i) {
+		mWriter.writeU8(0);
+	}
+
+	const u32 commands = mCommandCount;
+	mStart             = mWriter.getPosition();
+	mCommandCount      = 0;
+	return commands;
+}
+
+void DisplayListWriter::writeHeader(PrimitiveType type, std::size_t vertexCount)
+{
+	if (vertexCount > 0xFFFF) {
+		throw std::length_error("DisplayListWriter: a primitive can't hold " + std::to_string(vertexCount) + " vertices");
+	}
+
+	mWriter.writeU8(static_cast<u8>(type));
+	mWriter.writeU16(static_cast<u16>(vertexCount));
+	mCommandCount++;
+}
+
+// The inverse of the reader's decoders, the padding written for descriptors without texcoords is 0
+void DisplayListWriter::writeVertex(const VertexAttrib& vertex)
+{
+	const u32 vcd = mLayout.mDescriptor;
+	if (vcd & VCD::MatrixIndex) {
+		mWriter.writeU8(vertex.mMatrixIndex);
+	}
+	if (vcd & VCD::TexMatrixIndex) {
+		mWriter.writeU8(vertex.mTexMtxIndex);
+	}
+
+	mWriter.writeU16(vertex.mPosition);
+	mWriter.writeU16(vertex.mNormal);
+
+	if (vcd & VCD::Color0) {
+		mWriter.writeU16(vertex.mColor);
+	}
+
+	for (u32 t = 0; t < mLayout.mTexCoordCount; ++t) {
+		mWriter.writeU16(vertex.mTexcoords[mLayout.mTexCoordSlots[t]]);
+	}
+	if (mLayout.mTexCoordCount == 0) {
+		mWriter.writeU16(0);
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef COMMON_DISPLAYLISTWRITER_HPP
+#define COMMON_DISPLAYLISTWRITER_HPP
+
+#include "../util/vector_writer.hpp"
+#include "../types.hpp"
+#include "dlist_reader.hpp"
+#include <span>
+
+// The counterpart of DisplayListReader, packs primitives with the vertex layout of a descriptor (Mesh::mVtxDescriptor)
+class DisplayListWriter {
+public:
+	// Display lists are sent to the GPU in whole 32 byte blocks
+	static constexpr std::size_t Alignment = 32;
+
+	// Writes onto the end of writer, reserve() it first to write without reallocating
+	DisplayListWriter(util::vector_writer& writer, u32 vcd);
+
+	// Appends a strip of at least 3 vertices
+	void writeStrip(std::span<const VertexAttrib> vertices);
+
+	// Appends a triangle list, three vertices per triangle
+	void writeTriangles(std::span<const VertexAttrib> vertices);
+
+	// Appends a primitive whose vertices are picked from a pool by index
+	void writePrimitive(PrimitiveType type, std::span<const u32> indices, std::span<const VertexAttrib> pool);
+
+	// Pads what has been written since the last call to a multiple of 32 bytes with GX NOPs, which the reader
+	// stops at, and returns how many primitives went into it for DisplayList::mCommandCount
+	u32 finish();
+
+	// Bytes a primitive of vertexCount vertices takes up
+	std::size_t getPrimitiveSize(std::size_t vertexCount) const { return 3 + vertexCount * mLayout.mStride; }
+
+	// Bytes written since the last finish(), without padding
+	std::size_t getSize() const { return mWriter.getPosition() - mStart; }
+
+	u32 getCommandCount() const { return mCommandCount; }
+	const VertexLayout& getLayout() const { return mLayout; }
+
+private:
+	util::vector_writer& mWriter;
+	VertexLayout mLayout;
+	std::size_t mStart = 0; // Where the current display list starts in mWriter
+	u32 mCommandCount  = 0;
+
+	void writeHeader(PrimitiveType type, std::size_t vertexCount);
+	void writeVertex(const VertexAttrib& vertex);
+};
+
+#endif
@@ -1,6 +1,6 @@
 #include "envelope.hpp"
 
-void Envelope::read(util::fstream_reader& reader)
+void Envelope::read(util::span_reader& reader)
 {
 	mIndices.resize(reader.readU16());
 	mWeights.resize(mIndices.size());
@@ -11,7 +11,7 @@ void Envelope::read(util::fstream_reader& reader)
 	}
 }
 
-void Envelope::write(util::fstream_writer& writer)
+void Envelope::write(util::vector_writer& writer)
 {
 	writer.writeU16(static_cast<u16>(mIndices.size()));
 
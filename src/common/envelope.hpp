@@ -2,15 +2,15 @@
 #define ENVELOPE_HPP
 
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 struct Envelope {
 	std::vector<s16> mIndices;
 	std::vector<f32> mWeights;
 
-	void read(util::fstream_reader&);
-	void write(util::fstream_writer&);
+	void read(util::span_reader&);
+	void write(util::vector_writer&);
 };
 
 #endif
\ No newline at end of file
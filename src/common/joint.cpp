@@ -1,18 +1,18 @@
 #include "joint.hpp"
 
-void JointMatPoly::read(util::fstream_reader& reader)
+void JointMatPoly::read(util::span_reader& reader)
 {
 	mMaterialIndex = reader.readU16();
 	mMeshIndex     = reader.readU16();
 }
 
-void JointMatPoly::write(util::fstream_writer& writer) const
+void JointMatPoly::write(util::vector_writer& writer) const
 {
 	writer.writeU16(mMaterialIndex);
 	writer.writeU16(mMeshIndex);
 }
 
-void Joint::read(util::fstream_reader& reader)
+void Joint::read(util::span_reader& reader)
 {
 	mParentIndex = reader.readU32();
 	mIsVisible   = reader.readU32();
@@ -28,7 +28,7 @@ void Joint::read(util::fstream_reader& reader)
 	}
 }
 
-void Joint::write(util::fstream_writer& writer)
+void Joint::write(util::vector_writer& writer)
 {
 	writer.writeU32(mParentIndex);
 	writer.writeU32(mIsVisible);
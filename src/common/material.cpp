@@ -8,7 +8,7 @@ namespace mat {
 // KEYFRAME PRIMITIVES
 //================================================================================
 
-void KeyInfoU8::read(util::fstream_reader& reader)
+void KeyInfoU8::read(util::span_reader& reader)
 {
 	mTime = reader.readU8();
 	// Read 3 padding bytes to match the original source's four separate byte reads
@@ -20,7 +20,7 @@ void KeyInfoU8::read(util::fstream_reader& reader)
 	mTangent = reader.readF32();
 }
 
-void KeyInfoU8::write(util::fstream_writer& writer) const
+void KeyInfoU8::write(util::vector_writer& writer) const
 {
 	writer.writeU8(mTime);
 	writer.writeU8(0);
@@ -30,21 +30,21 @@ void KeyInfoU8::write(util::fstream_writer& writer) const
 	writer.writeF32(mTangent);
 }
 
-void KeyInfoF32::read(util::fstream_reader& reader)
+void KeyInfoF32::read(util::span_reader& reader)
 {
 	mTime    = reader.readF32();
 	mValue   = reader.readF32();
 	mTangent = reader.readF32();
 }
 
-void KeyInfoF32::write(util::fstream_writer& writer) const
+void KeyInfoF32::write(util::vector_writer& writer) const
 {
 	writer.writeF32(mTime);
 	writer.writeF32(mValue);
 	writer.writeF32(mTangent);
 }
 
-void KeyInfoS10::read(util::fstream_reader& reader)
+void KeyInfoS10::read(util::span_reader& reader)
 {
 	mTime = reader.readS16();
 	reader.readS16(); // Padding
@@ -52,7 +52,7 @@ void KeyInfoS10::read(util::fstream_reader& reader)
 	mTangent = reader.readF32();
 }
 
-void KeyInfoS10::write(util::fstream_writer& writer) const
+void KeyInfoS10::write(util::vector_writer& writer) const
 {
 	writer.writeS16(mTime);
 	writer.writeS16(0);
@@ -64,7 +64,7 @@ void KeyInfoS10::write(util::fstream_writer& writer) const
 // ANIMATION INFO STRUCTURES
 //================================================================================
 
-void ColourAnimInfo::read(util::fstream_reader& reader)
+void ColourAnimInfo::read(util::span_reader& reader)
 {
 	mIndex = reader.readS32();
 	mKeyDataR.read(reader);
@@ -72,7 +72,7 @@ void ColourAnimInfo::read(util::fstream_reader& reader)
 	mKeyDataB.read(reader);
 }
 
-void ColourAnimInfo::write(util::fstream_writer& writer) const
+void ColourAnimInfo::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mIndex);
 	mKeyDataR.write(writer);
@@ -80,19 +80,19 @@ void ColourAnimInfo::write(util::fstream_writer& writer) const
 	mKeyDataB.write(writer);
 }
 
-void AlphaAnimInfo::read(util::fstream_reader& reader)
+void AlphaAnimInfo::read(util::span_reader& reader)
 {
 	mIndex = reader.readS32();
 	mKeyData.read(reader);
 }
 
-void AlphaAnimInfo::write(util::fstream_writer& writer) const
+void AlphaAnimInfo::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mIndex);
 	mKeyData.write(writer);
 }
 
-void TextureAnimData::read(util::fstream_reader& reader)
+void TextureAnimData::read(util::span_reader& reader)
 {
 	mAnimationFrame = reader.readS32();
 	mValueX.read(reader);
@@ -100,7 +100,7 @@ void TextureAnimData::read(util::fstream_reader& reader)
 	mValueZ.read(reader);
 }
 
-void TextureAnimData::write(util::fstream_writer& writer) const
+void TextureAnimData::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mAnimationFrame);
 	mValueX.write(writer);
@@ -108,19 +108,19 @@ void TextureAnimData::write(util::fstream_writer& writer) const
 	mValueZ.write(writer);
 }
 
-void PVWAnimInfo_1_S10::read(util::fstream_reader& reader)
+void PVWAnimInfo_1_S10::read(util::span_reader& reader)
 {
 	mKeyframeCount = reader.readS32();
 	mKeyframeInfo.read(reader);
 }
 
-void PVWAnimInfo_1_S10::write(util::fstream_writer& writer) const
+void PVWAnimInfo_1_S10::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mKeyframeCount);
 	mKeyframeInfo.write(writer);
 }
 
-void PVWAnimInfo_3_S10::read(util::fstream_reader& reader)
+void PVWAnimInfo_3_S10::read(util::span_reader& reader)
 {
 	mKeyframeCount = reader.readS32();
 	mKeyframeA.read(reader);
@@ -128,7 +128,7 @@ void PVWAnimInfo_3_S10::read(util::fstream_reader& reader)
 	mKeyframeC.read(reader);
 }
 
-void PVWAnimInfo_3_S10::write(util::fstream_writer& writer) const
+void PVWAnimInfo_3_S10::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mKeyframeCount);
 	mKeyframeA.write(writer);
@@ -140,7 +140,7 @@ void PVWAnimInfo_3_S10::write(util::fstream_writer& writer) const
 // MATERIAL COMPONENT STRUCTURES
 //================================================================================
 
-void PolygonColourInfo::read(util::fstream_reader& reader)
+void PolygonColourInfo::read(util::span_reader& reader)
 {
 	mDiffuseColour.read(reader);
 	mAnimLength = reader.readS32();
@@ -157,7 +157,7 @@ void PolygonColourInfo::read(util::fstream_reader& reader)
 	}
 }
 
-void PolygonColourInfo::write(util::fstream_writer& writer)
+void PolygonColourInfo::write(util::vector_writer& writer)
 {
 	mDiffuseColour.write(writer);
 	writer.writeS32(mAnimLength);
@@ -174,19 +174,19 @@ void PolygonColourInfo::write(util::fstream_writer& writer)
 	}
 }
 
-void LightingInfo::read(util::fstream_reader& reader)
+void LightingInfo::read(util::span_reader& reader)
 {
 	mFlags   = reader.readU32();
 	mUnknown = reader.readF32();
 }
 
-void LightingInfo::write(util::fstream_writer& writer) const
+void LightingInfo::write(util::vector_writer& writer) const
 {
 	writer.writeU32(mFlags);
 	writer.writeF32(mUnknown);
 }
 
-void PeInfo::read(util::fstream_reader& reader)
+void PeInfo::read(util::span_reader& reader)
 {
 	mFlags                      = reader.readS32();
 	mAlphaCompareFunction.value = reader.readS32();
@@ -194,7 +194,7 @@ void PeInfo::read(util::fstream_reader& reader)
 	mBlendMode.value            = reader.readS32();
 }
 
-void PeInfo::write(util::fstream_writer& writer) const
+void PeInfo::write(util::vector_writer& writer) const
 {
 	writer.writeS32(mFlags);
 	writer.writeS32(mAlphaCompareFunction.value);
@@ -206,7 +206,7 @@ void PeInfo::write(util::fstream_writer& writer) const
 // TEXTURE STRUCTURES
 //================================================================================
 
-void TexGenData::read(util::fstream_reader& reader)
+void TexGenData::read(util::span_reader& reader)
 {
 	mDestinationCoords = reader.readU8();
 	mFunc              = reader.readU8();
@@ -214,7 +214,7 @@ void TexGenData::read(util::fstream_reader& reader)
 	mTexMtx            = reader.readU8();
 }
 
-void TexGenData::write(util::fstream_writer& writer) const
+void TexGenData::write(util::vector_writer& writer) const
 {
 	writer.writeU8(mDestinationCoords);
 	writer.writeU8(mFunc);
@@ -222,7 +222,7 @@ void TexGenData::write(util::fstream_writer& writer) const
 	writer.writeU8(mTexMtx);
 }
 
-void TextureData::read(util::fstream_reader& reader)
+void TextureData::read(util::span_reader& reader)
 {
 	mTextureAttributeIndex = reader.readS32();
 	mWrapModeS             = reader.readS16();
@@ -255,7 +255,7 @@ void TextureData::read(util::fstream_reader& reader)
 	}
 }
 
-void TextureData::write(util::fstream_writer& writer)
+void TextureData::write(util::vector_writer& writer)
 {
 	writer.writeS32(mTextureAttributeIndex);
 	writer.writeS16(mWrapModeS);
@@ -289,7 +289,7 @@ void TextureData::write(util::fstream_writer& writer)
 	}
 }
 
-void TextureInfo::read(util::fstream_reader& reader)
+void TextureInfo::read(util::span_reader& reader)
 {
 	mUseScale = reader.readS32();
 	mScale.read(reader);
@@ -305,7 +305,7 @@ void TextureInfo::read(util::fstream_reader& reader)
 	}
 }
 
-void TextureInfo::write(util::fstream_writer& writer)
+void TextureInfo::write(util::vector_writer& writer)
 {
 	writer.writeS32(mUseScale);
 	mScale.write(writer);
@@ -325,7 +325,7 @@ void TextureInfo::write(util::fstream_writer& writer)
 // TEV (TEXTURE ENVIRONMENT) STRUCTURES
 //================================================================================
 
-void PVWCombiner::read(util::fstream_reader& reader)
+void PVWCombiner::read(util::span_reader& reader)
 {
 	for (unsigned char& i : mInputABCD) {
 		i = reader.readU8();
@@ -340,7 +340,7 @@ void PVWCombiner::read(util::fstream_reader& reader)
 	}
 }
 
-void PVWCombiner::write(util::fstream_writer& writer) const
+void PVWCombiner::write(util::vector_writer& writer) const
 {
 	for (unsigned char i : mInputABCD) {
 		writer.writeU8(i);
@@ -355,7 +355,7 @@ void PVWCombiner::write(util::fstream_writer& writer) const
 	}
 }
 
-void TEVStage::read(util::fstream_reader& reader)
+void TEVStage::read(util::span_reader& reader)
 {
 	mUnknown     = reader.readU8();
 	mTexCoordID  = reader.readU8();
@@ -369,7 +369,7 @@ void TEVStage::read(util::fstream_reader& reader)
 	mTevAlphaCombiner.read(reader);
 }
 
-void TEVStage::write(util::fstream_writer& writer) const
+void TEVStage::write(util::vector_writer& writer) const
 {
 	writer.writeU8(mUnknown);
 	writer.writeU8(mTexCoordID);
@@ -382,7 +382,7 @@ void TEVStage::write(util::fstream_writer& writer) const
 	mTevAlphaCombiner.write(writer);
 }
 
-void TEVColReg::read(util::fstream_reader& reader)
+void TEVColReg::read(util::span_reader& reader)
 {
 	mColour.read(reader);
 	mAnimLength = reader.readS32();
@@ -399,7 +399,7 @@ void TEVColReg::read(util::fstream_reader& reader)
 	}
 }
 
-void TEVColReg::write(util::fstream_writer& writer)
+void TEVColReg::write(util::vector_writer& writer)
 {
 	mColour.write(writer);
 	writer.writeS32(mAnimLength);
@@ -416,7 +416,7 @@ void TEVColReg::write(util::fstream_writer& writer)
 	}
 }
 
-void TEVInfo::read(util::fstream_reader& reader)
+void TEVInfo::read(util::span_reader& reader)
 {
 	mTevColourRegA.read(reader);
 	mTevColourRegB.read(reader);
@@ -433,7 +433,7 @@ void TEVInfo::read(util::fstream_reader& reader)
 	}
 }
 
-void TEVInfo::write(util::fstream_writer& writer)
+void TEVInfo::write(util::vector_writer& writer)
 {
 	mTevColourRegA.write(writer);
 	mTevColourRegB.write(writer);
@@ -452,7 +452,7 @@ void TEVInfo::write(util::fstream_writer& writer)
 
 #pragma region Material
 
-void Material::read(util::fstream_reader& reader)
+void Material::read(util::span_reader& reader)
 {
 	mFlags        = reader.readU32();
 	mTextureIndex = reader.readS32();
@@ -467,7 +467,7 @@ void Material::read(util::fstream_reader& reader)
 	}
 }
 
-void Material::write(util::fstream_writer& writer)
+void Material::write(util::vector_writer& writer)
 {
 	writer.writeU32(mFlags);
 	writer.writeS32(mTextureIndex);
@@ -7,8 +7,8 @@
 #include "vector3.hpp"
 #include "vector2.hpp"
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 #include "gxdefines.hpp"
 #include <iostream>
 
@@ -23,8 +23,8 @@ struct KeyInfoU8 {
 		return mTime == other.mTime && nearly_equal(mValue, other.mValue) && nearly_equal(mTangent, other.mTangent);
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct KeyInfoF32 {
@@ -37,8 +37,8 @@ struct KeyInfoF32 {
 		return nearly_equal(mTime, other.mTime) && nearly_equal(mValue, other.mValue) && nearly_equal(mTangent, other.mTangent);
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct KeyInfoS10 {
@@ -51,8 +51,8 @@ struct KeyInfoS10 {
 		return mTime == other.mTime && nearly_equal(mValue, other.mValue) && nearly_equal(mTangent, other.mTangent);
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct ColourAnimInfo {
@@ -66,8 +66,8 @@ struct ColourAnimInfo {
 		return mIndex == other.mIndex && mKeyDataR == other.mKeyDataR && mKeyDataG == other.mKeyDataG && mKeyDataB == other.mKeyDataB;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct AlphaAnimInfo {
@@ -76,8 +76,8 @@ struct AlphaAnimInfo {
 
 	bool operator==(const AlphaAnimInfo& other) const { return mIndex == other.mIndex && mKeyData == other.mKeyData; }
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct PolygonColourInfo {
@@ -93,8 +93,8 @@ struct PolygonColourInfo {
 		    && mColourAnimInfo == other.mColourAnimInfo && mAlphaAnimInfo == other.mAlphaAnimInfo;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 enum struct LightingInfoFlags : u32 {
@@ -119,8 +119,8 @@ struct LightingInfo {
 
 	bool operator==(const LightingInfo& other) const { return mFlags == other.mFlags && nearly_equal(mUnknown, other.mUnknown); }
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct PeInfo {
@@ -156,8 +156,8 @@ struct PeInfo {
 		    && mZModeFunction == other.mZModeFunction && mBlendMode.value == other.mBlendMode.value;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TexGenData {
@@ -172,8 +172,8 @@ struct TexGenData {
 		    && mTexMtx == other.mTexMtx;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TextureAnimData {
@@ -187,8 +187,8 @@ struct TextureAnimData {
 		return mAnimationFrame == other.mAnimationFrame && mValueX == other.mValueX && mValueY == other.mValueY && mValueZ == other.mValueZ;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TextureData {
@@ -224,8 +224,8 @@ struct TextureData {
 		    && mScaleInfo == other.mScaleInfo && mRotationInfo == other.mRotationInfo && mTranslationInfo == other.mTranslationInfo;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct TextureInfo {
@@ -240,8 +240,8 @@ struct TextureInfo {
 		    && mTextureData == other.mTextureData;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 enum class MaterialFlags : u32 {
@@ -269,8 +269,8 @@ struct Material {
 		    && mTexInfo == other.mTexInfo;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct PVWAnimInfo_3_S10 {
@@ -285,8 +285,8 @@ struct PVWAnimInfo_3_S10 {
 		    && mKeyframeC == other.mKeyframeC;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct PVWAnimInfo_1_S10 {
@@ -298,8 +298,8 @@ struct PVWAnimInfo_1_S10 {
 		return mKeyframeCount == other.mKeyframeCount && mKeyframeInfo == other.mKeyframeInfo;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TEVColReg {
@@ -315,8 +315,8 @@ struct TEVColReg {
 		    && mColorAnimInfo == other.mColorAnimInfo && mAlphaAnimInfo == other.mAlphaAnimInfo;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct PVWCombiner {
@@ -338,8 +338,8 @@ struct PVWCombiner {
 		return mOp == other.mOp && mBias == other.mBias && mScale == other.mScale && mClamp == other.mClamp && mOutReg == other.mOutReg;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TEVStage {
@@ -359,8 +359,8 @@ struct TEVStage {
 		    && mTevColorCombiner == other.mTevColorCombiner && mTevAlphaCombiner == other.mTevAlphaCombiner;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer) const;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer) const;
 };
 
 struct TEVInfo {
@@ -382,8 +382,8 @@ struct TEVInfo {
 		    && mKonstColourD == other.mKonstColourD && mTevStages == other.mTevStages;
 	}
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 } // namespace mat
 
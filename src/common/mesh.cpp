@@ -1,24 +1,24 @@
 #include "mesh.hpp"
 
-void DisplayList::read(util::fstream_reader& reader)
+void DisplayList::read(util::span_reader& reader)
 {
 	mFlags         = static_cast<DLFlags>(reader.readU32());
 	mCommandCount  = reader.readU32();
 	mData.resize(reader.readU32());
 	reader.align();
-	reader.read(reinterpret_cast<char*>(mData.data()), mData.size());
+	reader.read_buffer(mData.data(), mData.size());
 }
 
-void DisplayList::write(util::fstream_writer& writer)
+void DisplayList::write(util::vector_writer& writer)
 {
 	writer.writeU32(static_cast<u32>(mFlags));
 	writer.writeU32(mCommandCount);
 	writer.writeU32(static_cast<u32>(mData.size()));
 	writer.align();
-	writer.write(reinterpret_cast<char*>(mData.data()), mData.size());
+	writer.write_buffer(mData.data(), mData.size());
 }
 
-void MeshPacket::read(util::fstream_reader& reader)
+void MeshPacket::read(util::span_reader& reader)
 {
 	mIndices.resize(reader.readU32());
 	for (s16& index : mIndices) {
@@ -31,7 +31,7 @@ void MeshPacket::read(util::fstream_reader& reader)
 	}
 }
 
-void MeshPacket::write(util::fstream_writer& writer)
+void MeshPacket::write(util::vector_writer& writer)
 {
 	writer.writeU32(static_cast<u32>(mIndices.size()));
 	for (s16& index : mIndices) {
@@ -44,7 +44,7 @@ void MeshPacket::write(util::fstream_writer& writer)
 	}
 }
 
-void Mesh::read(util::fstream_reader& reader)
+void Mesh::read(util::span_reader& reader)
 {
 	mBoneIndex     = reader.readU32();
 	mVtxDescriptor = reader.readU32();
@@ -54,7 +54,7 @@ void Mesh::read(util::fstream_reader& reader)
 	}
 }
 
-void Mesh::write(util::fstream_writer& writer)
+void Mesh::write(util::vector_writer& writer)
 {
 	writer.writeU32(mBoneIndex);
 	writer.writeU32(mVtxDescriptor);
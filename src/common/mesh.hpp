@@ -2,8 +2,8 @@
 #define MESH_HPP
 
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 enum class DLFlags : u32 {
 	Front            = 1 << 0,
@@ -18,16 +18,16 @@ struct DisplayList {
 	u32 mCommandCount = 0;
 	std::vector<u8> mData;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 struct MeshPacket {
 	std::vector<s16> mIndices;
 	std::vector<DisplayList> mDisplayLists;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 enum VCD : u32 {
@@ -49,8 +49,8 @@ struct Mesh {
 	u32 mVtxDescriptor = 0;
 	std::vector<MeshPacket> mPackets;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 #endif
\ No newline at end of file
@@ -1,13 +1,13 @@
 #include "nbt.hpp"
 
-void NBT::read(util::fstream_reader& reader)
+void NBT::read(util::span_reader& reader)
 {
 	mNormal.read(reader);
 	mBinormal.read(reader);
 	mTangent.read(reader);
 }
 
-void NBT::write(util::fstream_writer& writer)
+void NBT::write(util::vector_writer& writer)
 {
 	mNormal.write(writer);
 	mBinormal.write(writer);
@@ -3,16 +3,16 @@
 
 #include "vector3.hpp"
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 struct NBT {
 	Vector3f mNormal;
 	Vector3f mBinormal;
 	Vector3f mTangent;
 
-	void read(util::fstream_reader&);
-	void write(util::fstream_writer&);
+	void read(util::span_reader&);
+	void write(util::vector_writer&);
 };
 
 #endif
\ No newline at end of file
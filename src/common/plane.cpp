@@ -1,12 +1,12 @@
 #include "plane.hpp"
 
-void Plane::read(util::fstream_reader& reader)
+void Plane::read(util::span_reader& reader)
 {
 	mNormal.read(reader);
 	mDistance = reader.readF32();
 }
 
-void Plane::write(util::fstream_writer& writer)
+void Plane::write(util::vector_writer& writer)
 {
 	mNormal.write(writer);
 	writer.writeF32(mDistance);
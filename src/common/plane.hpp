@@ -3,15 +3,15 @@
 
 #include "vector3.hpp"
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 struct Plane {
 	Vector3f mNormal;
 	f32 mDistance = 0;
 
-	void read(util::fstream_reader& reader);
-	void write(util::fstream_writer& writer);
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 };
 
 #endif
\ No newline at end of file
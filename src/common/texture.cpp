@@ -1,6 +1,6 @@
 #include "texture.hpp"
 
-void Texture::read(util::fstream_reader& reader)
+void Texture::read(util::span_reader& reader)
 {
 	mWidth         = reader.readU16();
 	mHeight        = reader.readU16();
@@ -15,7 +15,7 @@ void Texture::read(util::fstream_reader& reader)
 	reader.read_buffer(reinterpret_cast<char*>(mImageData.data()), mImageData.size());
 }
 
-void Texture::write(util::fstream_writer& writer)
+void Texture::write(util::vector_writer& writer)
 {
 	writer.writeU16(mWidth);
 	writer.writeU16(mHeight);
@@ -27,10 +27,10 @@ void Texture::write(util::fstream_writer& writer)
 	}
 
 	writer.writeU32(static_cast<u32>(mImageData.size()));
-	writer.write(reinterpret_cast<char*>(mImageData.data()), mImageData.size());
+	writer.write_buffer(mImageData.data(), mImageData.size());
 }
 
-void TextureAttributes::read(util::fstream_reader& reader)
+void TextureAttributes::read(util::span_reader& reader)
 {
 	mIndex = reader.readS16();
 	reader.readU16();
@@ -39,7 +39,7 @@ void TextureAttributes::read(util::fstream_reader& reader)
 	mLODBias          = reader.readF32();
 }
 
-void TextureAttributes::write(util::fstream_writer& writer) const
+void TextureAttributes::write(util::vector_writer& writer) const
 {
 	writer.writeS16(mIndex);
 	writer.writeU16(0);
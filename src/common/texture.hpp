@@ -2,8 +2,8 @@
 #define TEXTURE_HPP
 
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 enum class TextureFormat {
 	RGB565 = 0,
@@ -23,8 +23,8 @@ struct Texture {
 	s32 mDataPtrOffset    = 0;
 	std::vector<u8> mImageData;
 
-	void read(util::fstream_reader&);
-	void write(util::fstream_writer&);
+	void read(util::span_reader&);
+	void write(util::vector_writer&);
 };
 
 enum class TextureTilingMode {
@@ -38,8 +38,8 @@ struct TextureAttributes {
 	u16 mUseOffsetImgData = 0;
 	f32 mLODBias          = 0;
 
-	void read(util::fstream_reader&);
-	void write(util::fstream_writer&) const;
+	void read(util::span_reader&);
+	void write(util::vector_writer&) const;
 };
 
 #endif
\ No newline at end of file
@@ -6,16 +6,15 @@
 #include <ostream>
 #include <type_traits>
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 template <typename T>
 struct Vector2 {
 	T x {};
 	T y {};
 
-	Vector2()          = default;
-	virtual ~Vector2() = default;
+	Vector2() = default;
 
 	constexpr Vector2(T x_, T y_) noexcept
 	    : x(x_)
@@ -39,16 +38,12 @@ struct Vector2 {
 	}
 
 	[[nodiscard]] bool operator!=(const Vector2& other) const noexcept { return !(*this == other); }
-
-	virtual void read(util::fstream_reader&)  = 0;
-	virtual void write(util::fstream_writer&) = 0;
 };
 
 struct Vector2f final : public Vector2<f32> {
 	using Base = Vector2<f32>;
 
-	Vector2f()           = default;
-	~Vector2f() override = default;
+	Vector2f() = default;
 
 	constexpr Vector2f(f32 x_, f32 y_) noexcept
 	    : Base(x_, y_)
@@ -60,8 +55,8 @@ struct Vector2f final : public Vector2<f32> {
 	Vector2f& operator=(const Vector2f&) = default;
 	Vector2f& operator=(Vector2f&&)      = default;
 
-	void read(util::fstream_reader& reader) override;
-	void write(util::fstream_writer& writer) override;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 
 	friend std::ostream& operator<<(std::ostream& os, const Vector2f& v) { return os << v.x << ' ' << v.y; }
 };
@@ -69,8 +64,7 @@ struct Vector2f final : public Vector2<f32> {
 struct Vector2i final : public Vector2<u32> {
 	using Base = Vector2<u32>;
 
-	Vector2i()           = default;
-	~Vector2i() override = default;
+	Vector2i() = default;
 
 	constexpr Vector2i(u32 x_, u32 y_) noexcept
 	    : Base(x_, y_)
@@ -82,8 +76,8 @@ struct Vector2i final : public Vector2<u32> {
 	Vector2i& operator=(const Vector2i&) = default;
 	Vector2i& operator=(Vector2i&&)      = default;
 
-	void read(util::fstream_reader& reader) override;
-	void write(util::fstream_writer& writer) override;
+	void read(util::span_reader& reader);
+	void write(util::vector_writer& writer);
 
 	friend std::ostream& operator<<(std::ostream& os, const Vector2i& v) { return os << v.x << ' ' << v.y; }
 };
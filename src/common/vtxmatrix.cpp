@@ -1,6 +1,6 @@
 #include "vtxmatrix.hpp"
 
-void VtxMatrix::read(util::fstream_reader& reader)
+void VtxMatrix::read(util::span_reader& reader)
 {
 	int weights        = reader.readS16();
 	mHasPartialWeights = weights >= 0;
@@ -11,7 +11,7 @@ void VtxMatrix::read(util::fstream_reader& reader)
 	}
 }
 
-void VtxMatrix::write(util::fstream_writer& writer) const
+void VtxMatrix::write(util::vector_writer& writer) const
 {
 	if (mHasPartialWeights) {
 		writer.writeS16(static_cast<s16>(mIndex));
@@ -2,15 +2,15 @@
 #define VTXMATRIX_HPP
 
 #include "../types.hpp"
-#include "../util/fstream_reader.hpp"
-#include "../util/fstream_writer.hpp"
+#include "../util/span_reader.hpp"
+#include "../util/vector_writer.hpp"
 
 struct VtxMatrix {
 	u32 mIndex              = 0;
 	bool mHasPartialWeights = false;
 
-	void read(util::fstream_reader&);
-	void write(util::fstream_writer&) const;
+	void read(util::span_reader&);
+	void write(util::vector_writer&) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,417 @@
+#include "generator.hpp"
+#include "common.hpp"
+#include "common/dlist_writer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace generator {
+namespace {
+// The standard distributions differ between standard libraries, the engine itself doesn't, so values are
+// derived from its raw output to keep models identical on every platform
+class Random {
+public:
+	explicit Random(u32 seed)
+	    : mEngine(seed)
+	{
+	}
+
+	u32 next() { return static_cast<u32>(mEngine()); }
+
+	// Uniform in [0, bound), 0 when bound is 0
+	u32 below(u32 bound) { return bound == 0 ? 0 : next() % bound; }
+
+	// Uniform in [min, max]
+	u32 between(u32 min, u32 max) { return min + below(max - min + 1); }
+
+	// Uniform in [min, max)
+	f32 range(f32 min, f32 max) { return min + (max - min) * static_cast<f32>(next() >> 8) / 16777216.0f; }
+
+	Vector3f direction()
+	{
+		const Vector3f v(range(-1, 1), range(-1, 1), range(-1, 1));
+		const f32 length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		return length < 1e-6f ? Vector3f(0, 1, 0) : Vector3f(v.x / length, v.y / length, v.z / length);
+	}
+
+	ColourU8 colour()
+	{
+		ColourU8 colour;
+		colour.r = static_cast<u8>(next());
+		colour.g = static_cast<u8>(next());
+		colour.b = static_cast<u8>(next());
+		return colour;
+	}
+
+private:
+	std::mt19937 mEngine;
+};
+
+// Size of the image data of a texture, dimensions are powers of two of at least 8 so every format's tiles fit exactly
+u32 imageSize(TextureFormat format, u32 width, u32 height)
+{
+	switch (format) {
+	case TextureFormat::CMPR:
+	case TextureFormat::I4:
+		return width * height / 2;
+	case TextureFormat::I8:
+	case TextureFormat::IA4:
+		return width * height;
+	case TextureFormat::RGBA32:
+		return width * height * 4;
+	case TextureFormat::RGB565:
+	case TextureFormat::RGB5A3:
+	case TextureFormat::IA8:
+	default:
+		return width * height * 2;
+	}
+}
+
+void generateVertices(MOD& mod, const Settings& settings, Random& random)
+{
+	const u32 count = std::clamp<u32>(settings.mVertices, 3, 0xFFFF);
+
+	for (u32 i = 0; i < count; ++i) {
+		mod.mVertices.emplace_back(random.range(-512, 512), random.range(-64, 64), random.range(-512, 512));
+	}
+
+	if (settings.mNormals) {
+		for (u32 i = 0; i < count; ++i) {
+			mod.mVertexNormals.push_back(random.direction());
+		}
+	}
+
+	if (settings.mNbt) {
+		mod.mHeader.mFlags |= static_cast<u32>(MODFlags::UseNBT);
+		for (u32 i = 0; i < count; ++i) {
+			mod.mVertexNbt.push_back({ random.direction(), random.direction(), random.direction() });
+		}
+	}
+
+	if (settings.mColours) {
+		for (u32 i = 0; i < count; ++i) {
+			mod.mVertexColours.push_back(random.colour());
+		}
+	}
+
+	for (u32 set = 0; set < std::min<u32>(settings.mTexCoordSets, 8); ++set) {
+		for (u32 i = 0; i < count; ++i) {
+			mod.mTextureCoords[set].emplace_back(random.range(0, 1), random.range(0, 1));
+		}
+	}
+}
+
+void generateTextures(MOD& mod, const Settings& settings, Random& random)
+{
+	u32 size = 8;
+	while (size * 2 <= std::min<u32>(settings.mTextureSize, 1024)) {
+		size *= 2;
+	}
+
+	for (u32 format = 0; format <= static_cast<u32>(TextureFormat::RGBA32); ++format) {
+		for (u32 i = 0; i < settings.mTexturesPerFormat; ++i) {
+			Texture texture;
+			texture.mWidth  = static_cast<u16>(size);
+			texture.mHeight = static_cast<u16>(size);
+			texture.mFormat = static_cast<TextureFormat>(format);
+			texture.mImageData.resize(imageSize(texture.mFormat, size, size));
+			for (u8& byte : texture.mImageData) {
+				byte = static_cast<u8>(random.next());
+			}
+
+			TextureAttributes attributes;
+			attributes.mIndex      = static_cast<s16>(mod.mTextures.size());
+			attributes.mTilingType = static_cast<s16>(random.below(2));
+			mod.mTextureAttributes.push_back(attributes);
+
+			mod.mTextures.push_back(std::move(texture));
+		}
+	}
+}
+
+void generateMaterials(MOD& mod, const Settings& settings, Random& random)
+{
+	for (u32 i = 0; i < settings.mTevInfos; ++i) {
+		mat::TEVInfo info;
+		info.mKonstColourA = random.colour();
+		info.mKonstColourB = random.colour();
+		info.mKonstColourC = random.colour();
+		info.mKonstColourD = random.colour();
+
+		info.mTevStages.resize(random.between(1, 4));
+		for (mat::TEVStage& stage : info.mTevStages) {
+			stage.mTexCoordID  = static_cast<u8>(random.below(std::max<u32>(settings.mTexCoordSets, 1)));
+			stage.mTexMapID    = static_cast<u8>(random.below(8));
+			stage.mGXChannelID = static_cast<u8>(random.below(2));
+		}
+
+		mod.mMaterials.mTevEnvironmentInfo.push_back(std::move(info));
+	}
+
+	// Materials without a TEV group to point at stay disabled, which leaves out everything after the diffuse colour
+	for (u32 i = 0; i < settings.mMaterials; ++i) {
+		const u32 textureCount = static_cast<u32>(mod.mTextures.size());
+
+		mat::Material material;
+		material.mTextureIndex              = textureCount == 0 ? -1 : static_cast<s32>(random.below(textureCount));
+		material.mColourInfo.mDiffuseColour = random.colour();
+		if (settings.mTevInfos != 0) {
+			material.mFlags      = static_cast<u32>(mat::MaterialFlags::IsEnabled) | static_cast<u32>(mat::MaterialFlags::Opaque);
+			material.mTevGroupId = random.below(settings.mTevInfos);
+		}
+
+		mod.mMaterials.mMaterials.push_back(material);
+	}
+}
+
+void generateSkeleton(MOD& mod, const Settings& settings, Random& random)
+{
+	for (u32 i = 0; i < settings.mJoints; ++i) {
+		Joint joint;
+		joint.mParentIndex  = i == 0 ? -1 : static_cast<s32>(random.below(i));
+		joint.mIsVisible    = 1;
+		joint.mMinBounds    = { -512, -64, -512 };
+		joint.mMaxBounds    = { 512, 64, 512 };
+		joint.mVolumeRadius = 730;
+		joint.mScale        = { 1, 1, 1 };
+		joint.mRotation     = { random.range(-3.14159f, 3.14159f), random.range(-3.14159f, 3.14159f), random.range(-3.14159f, 3.14159f) };
+		joint.mPosition     = { random.range(-64, 64), random.range(-64, 64), random.range(-64, 64) };
+
+		mod.mJoints.push_back(std::move(joint));
+		mod.mJointNames.push_back("joint_" + std::to_string(i));
+	}
+
+	// Every joint drives the vertices on its own, envelopes blend two to four of them
+	for (u32 i = 0; i < settings.mJoints; ++i) {
+		mod.mVertexMatrices.push_back({ i, true });
+	}
+
+	if (settings.mJoints == 0) {
+		return;
+	}
+
+	for (u32 i = 0; i < settings.mEnvelopes; ++i) {
+		Envelope envelope;
+		f32 total = 0;
+		for (u32 j = random.between(2, 4); j > 0; --j) {
+			envelope.mIndices.push_back(static_cast<s16>(random.below(settings.mJoints)));
+			envelope.mWeights.push_back(random.range(0.1f, 1));
+			total += envelope.mWeights.back();
+		}
+
+		for (f32& weight : envelope.mWeights) {
+			weight /= total;
+		}
+
+		mod.mVertexEnvelopes.push_back(std::move(envelope));
+		mod.mVertexMatrices.push_back({ i, false });
+	}
+}
+
+void generateMeshes(MOD& mod, const Settings& settings, Random& random)
+{
+	const u32 vertexCount = static_cast<u32>(mod.mVertices.size());
+	const u32 matrixCount = static_cast<u32>(mod.mVertexMatrices.size());
+
+	u32 descriptor = 0;
+	if (matrixCount != 0) {
+		descriptor |= VCD::MatrixIndex;
+	}
+	if (settings.mColours) {
+		descriptor |= VCD::Color0;
+	}
+	for (u32 set = 0; set < std::min<u32>(settings.mTexCoordSets, 8); ++set) {
+		descriptor |= VCD::Tex0 << set;
+	}
+
+	// Each mesh draws from its own window of the vertex pool
+	const u32 window = std::max<u32>(3, vertexCount / std::max<u32>(settings.mMeshes, 1));
+
+	for (u32 m = 0; m < settings.mMeshes; ++m) {
+		const u32 first = std::min(m * window, vertexCount - std::min(window, vertexCount));
+		const u32 last  = std::min(first + window, vertexCount);
+
+		Mesh mesh;
+		mesh.mBoneIndex     = settings.mJoints == 0 ? 0 : m % settings.mJoints;
+		mesh.mVtxDescriptor = descriptor;
+
+		for (u32 p = 0; p < settings.mPacketsPerMesh; ++p) {
+			MeshPacket packet;
+
+			// The hardware has room for 10 matrices per packet, display lists refer to them by slot
+			for (u32 slot = std::min<u32>(matrixCount, random.between(1, 10)); slot > 0; --slot) {
+				packet.mIndices.push_back(static_cast<s16>(random.below(matrixCount)));
+			}
+
+			for (u32 d = 0; d < settings.mDisplayListsPerPacket; ++d) {
+				DisplayList dlist;
+				dlist.mFlags = static_cast<DLFlags>(random.between(1, 3));
+
+				// Strips are at most 32 vertices long
+				util::vector_writer writer;
+				DisplayListWriter dlWriter(writer, descriptor);
+				writer.reserve(settings.mStripsPerDisplayList * dlWriter.getPrimitiveSize(32) + DisplayListWriter::Alignment);
+				std::vector<VertexAttrib> strip;
+				for (u32 s = 0; s < settings.mStripsPerDisplayList; ++s) {
+					strip.resize(random.between(3, 32));
+					for (VertexAttrib& vertex : strip) {
+						vertex           = {};
+						const u16 index  = static_cast<u16>(first + random.below(last - first));
+						vertex.mPosition = index;
+						vertex.mNormal   = settings.mNormals ? index : 0;
+						vertex.mColor    = index;
+						if (descriptor & VCD::MatrixIndex) {
+							vertex.mMatrixIndex = static_cast<u8>(random.below(static_cast<u32>(packet.mIndices.size())) * 3);
+						}
+						for (u32 set = 0; set < std::min<u32>(settings.mTexCoordSets, 8); ++set) {
+							vertex.mTexcoords[set] = index;
+						}
+					}
+					dlWriter.writeStrip(strip);
+				}
+				dlist.mCommandCount = dlWriter.finish();
+				dlist.mData         = writer.takeBuffer();
+
+				packet.mDisplayLists.push_back(std::move(dlist));
+			}
+
+			mesh.mPackets.push_back(std::move(packet));
+		}
+
+		if (!mod.mJoints.empty()) {
+			const s16 material = static_cast<s16>(settings.mMaterials == 0 ? 0 : m % settings.mMaterials);
+			mod.mJoints[mesh.mBoneIndex].mLinkedPolygons.push_back({ material, static_cast<s16>(m) });
+		}
+
+		mod.mMeshes.push_back(std::move(mesh));
+	}
+}
+
+void generateCollision(MOD& mod, const Settings& settings, Random& random)
+{
+	if (settings.mCollisionTriangles == 0) {
+		return;
+	}
+
+	const u32 vertexCount = static_cast<u32>(mod.mVertices.size());
+	mod.mCollisionTriangles.mRoomInfo.push_back({});
+
+	// Triangles are built from neighbouring pool vertices and filed under the grid cell holding their centroid
+	const u32 cellsPerSide = std::max<u32>(1, static_cast<u32>(std::ceil(std::sqrt(settings.mCollisionTriangles / 16.0))));
+	CollGrid& grid         = mod.mCollisionGridInfo;
+	grid.mAABBMin          = { -512, -64, -512 };
+	grid.mAABBMax          = { 512, 64, 512 };
+	grid.mCellSize         = 1024.0f / cellsPerSide;
+	grid.mCellCountX       = cellsPerSide;
+	grid.mCellCountY       = cellsPerSide;
+
+	std::vector<CollGroup> cells(cellsPerSide * cellsPerSide);
+	for (u32 i = 0; i < settings.mCollisionTriangles; ++i) {
+		const u32 a = random.below(vertexCount);
+		const u32 b = (a + 1) % vertexCount;
+		const u32 c = (a + 2) % vertexCount;
+
+		const Vector3f& pa = mod.mVertices[a];
+		const Vector3f& pb = mod.mVertices[b];
+		const Vector3f& pc = mod.mVertices[c];
+
+		const Vector3f ab(pb.x - pa.x, pb.y - pa.y, pb.z - pa.z);
+		const Vector3f ac(pc.x - pa.x, pc.y - pa.y, pc.z - pa.z);
+		Vector3f normal(ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x);
+		const f32 length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		normal           = length < 1e-6f ? Vector3f(0, 1, 0) : Vector3f(normal.x / length, normal.y / length, normal.z / length);
+
+		BaseCollTriInfo info;
+		info.mMapCode             = static_cast<MapAttributes>(random.below(static_cast<u32>(MapAttributes::Hole) + 1));
+		info.mVertexIndexA        = a;
+		info.mVertexIndexB        = b;
+		info.mVertexIndexC        = c;
+		info.mNeighbourIndices[0] = -1;
+		info.mNeighbourIndices[1] = -1;
+		info.mNeighbourIndices[2] = -1;
+		info.mPlane.mNormal       = normal;
+		info.mPlane.mDistance     = normal.x * pa.x + normal.y * pa.y + normal.z * pa.z;
+		mod.mCollisionTriangles.mCollInfo.push_back(info);
+
+		const f32 centreX = (pa.x + pb.x + pc.x) / 3;
+		const f32 centreZ = (pa.z + pb.z + pc.z) / 3;
+		const u32 cellX   = std::min(cellsPerSide - 1, static_cast<u32>(std::max(0.0f, (centreX + 512) / grid.mCellSize)));
+		const u32 cellY   = std::min(cellsPerSide - 1, static_cast<u32>(std::max(0.0f, (centreZ + 512) / grid.mCellSize)));
+
+		// Group sizes are stored in 16 bits
+		CollGroup& cell = cells[cellY * cellsPerSide + cellX];
+		if (cell.mTriangleIndices.size() < 0xFFFF) {
+			cell.mTriangleIndices.push_back(i);
+			cell.mFarCullDistances.push_back(static_cast<u8>(random.next()));
+		}
+	}
+
+	// Empty cells don't get a group
+	for (CollGroup& cell : cells) {
+		if (cell.mTriangleIndices.empty()) {
+			grid.mGroupIndices.push_back(-1);
+			continue;
+		}
+
+		grid.mGroupIndices.push_back(static_cast<s32>(grid.mGroups.size()));
+		grid.mGroups.push_back(std::move(cell));
+	}
+}
+} // namespace
+
+bool Settings::set(std::string_view name, u32 value)
+{
+	const std::pair<std::string_view, u32*> counts[] = {
+		{ "seed", &mSeed },
+		{ "vertices", &mVertices },
+		{ "texcoords", &mTexCoordSets },
+		{ "textures", &mTexturesPerFormat },
+		{ "texture_size", &mTextureSize },
+		{ "materials", &mMaterials },
+		{ "tev_infos", &mTevInfos },
+		{ "joints", &mJoints },
+		{ "envelopes", &mEnvelopes },
+		{ "meshes", &mMeshes },
+		{ "packets", &mPacketsPerMesh },
+		{ "display_lists", &mDisplayListsPerPacket },
+		{ "strips", &mStripsPerDisplayList },
+		{ "collision", &mCollisionTriangles },
+	};
+
+	for (const auto& [key, setting] : counts) {
+		if (key == name) {
+			*setting = value;
+			return true;
+		}
+	}
+
+	const std::pair<std::string_view, bool*> switches[] = {
+		{ "normals", &mNormals },
+		{ "nbt", &mNbt },
+		{ "colours", &mColours },
+	};
+
+	for (const auto& [key, setting] : switches) {
+		if (key == name) {
+			*setting = value != 0;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void generate(MOD& mod, const Settings& settings)
+{
+	mod.reset();
+
+	Random random(settings.mSeed);
+	generateVertices(mod, settings, random);
+	generateTextures(mod, settings, random);
+	generateMaterials(mod, settings, random);
+	generateSkeleton(mod, settings, random);
+	generateMeshes(mod, settings, random);
+	generateCollision(mod, settings, random);
+}
+
+} // namespace generator
@@ -0,0 +1,53 @@
+#ifndef _GENERATOR_HPP
+#define _GENERATOR_HPP
+
+#pragma once
+
+#include "MOD.hpp"
+#include <string_view>
+
+namespace generator {
+
+/**
+ * @brief How much of everything a generated model contains.
+ */
+struct Settings {
+	u32 mSeed                  = 1;
+	u32 mVertices              = 4096; // Shared by every mesh, display lists index them with 16 bits so at most 65535
+	u32 mTexCoordSets          = 1;    // 0 to 8
+	bool mNormals              = true;
+	bool mNbt                  = false;
+	bool mColours              = true;
+	u32 mTexturesPerFormat     = 1;  // Of each TextureFormat
+	u32 mTextureSize           = 64; // Width and height, rounded down to a power of two between 8 and 1024
+	u32 mMaterials             = 16;
+	u32 mTevInfos              = 4;
+	u32 mJoints                = 8;
+	u32 mEnvelopes             = 8; // Need at least one joint
+	u32 mMeshes                = 4;
+	u32 mPacketsPerMesh        = 4;
+	u32 mDisplayListsPerPacket = 4;
+	u32 mStripsPerDisplayList  = 8;
+	u32 mCollisionTriangles    = 4096; // Bucketed into a CollGrid of about 16 triangles per cell
+
+	/**
+	 * @brief Sets a setting by its name as used by the generate command, e.g. "vertices" or "seed".
+	 * @param name The name of the setting.
+	 * @param value The new value, non-zero for true.
+	 * @return False if there is no setting with that name.
+	 */
+	bool set(std::string_view name, u32 value);
+};
+
+/**
+ * @brief Fills a model with random but valid data, the same settings always produce the same model.
+ *
+ * Everything is decoded, so the model can be written straight away and reads back identically.
+ * @param mod The model to replace.
+ * @param settings The counts to generate and the seed.
+ */
+void generate(MOD& mod, const Settings& settings);
+
+} // namespace generator
+
+#endif
@@ -1,7 +1,15 @@
 #include "commands.hpp"
+#include "modconv.hpp"
+#include "server.hpp"
 #include <functional>
 #include <iostream>
 #include "util/misc.hpp"
+#include "util/parallel_for.hpp"
+#include "util/profiler.hpp"
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <string_view>
 #include <sstream>
 #include <iomanip>
@@ -17,29 +25,46 @@ void printUsage(const char* programName)
 	std::cout << "  --test [dir]      Run unit tests (silent by default, optional test directory)\n";
 	std::cout << "  --test-verbose    Enable verbose output for unit tests\n";
 	std::cout << "  --quiet, -q       Disable verbose output\n";
-	std::cout << "  --verbose, -v     Enable verbose output (default)\n\n";
+	std::cout << "  --verbose, -v     Enable verbose output (default)\n";
+	std::cout << "  --jobs, -j <n>    Threads used to decode and encode chunks (default 1, 0 = one per core)\n";
+	std::cout << "  --batch <glob>    Load every matching file and run the commands on it, --jobs files at a time\n";
+	std::cout << "                    (default 0 = one per core)\n";
+	std::cout << "  --serve [socket]  Answer JSON requests, one per line, on stdin/stdout or on a Unix socket\n";
+	std::cout << "  --cache <n>       Models the server keeps loaded between requests (default 8)\n";
+	std::cout << "  --profile         Print the time, bytes and elements of every phase, chunk and command on exit\n";
+	std::cout << "  --profile-json <file>\n";
+	std::cout << "                    Write the same profile as JSON to a file\n";
+	std::cout << "  --trace <file>    Write a Chrome trace (about://tracing, Perfetto) of every command, chunk,\n";
+	std::cout << "                    display list and batch file\n\n";
 
 	std::cout << "Commands can be chained together. For example:\n";
 	std::cout << "  " << fs::path(programName).filename() << " load input.mod export_obj output.obj write output.mod\n\n";
 
+	std::cout << "In batch mode {path}, {dir}, {name} and {stem} in the commands are replaced for each file. For example:\n";
+	std::cout << "  " << fs::path(programName).filename() << " --batch 'assets/**/*.mod' --jobs 16 export_obj {dir}/{stem}.obj\n\n";
+
 	std::cout << "Available commands:\n";
 
 	// Group commands by category
 	std::cout << "\nFile Operations:\n";
 	std::cout << "  load  <filename>             Load a MOD file\n";
-	std::cout << "  write <filename>             Write the MOD file\n";
+	std::cout << "  write <filename>             Write the MOD file ('-' writes to stdout)\n";
 	std::cout << "  close                        Resets the currently loaded MOD file\n";
+	std::cout << "  generate [setting=value...]  Generate a synthetic model (settings: seed, vertices, texcoords, normals,\n";
+	std::cout << "                               nbt, colours, textures, texture_size, materials, tev_infos, joints,\n";
+	std::cout << "                               envelopes, meshes, packets, display_lists, strips, collision)\n";
 
 	std::cout << "\nModification Operations:\n";
-	std::cout << "  list_chunks                  Lists all chunks in the currently loaded MOD file\n";
+	std::cout << "  list_chunks [full]           Lists all chunks in the currently loaded MOD file\n";
 	std::cout << "  delete_chunk <chunk_id>      Delete a chunk type (e.g., 0x10, 0x30)\n";
-	std::cout << "  edit_header                  Edit header information (interactive)\n";
+	std::cout << "  edit_header [date y m d | flags <value>]\n";
+	std::cout << "                               Edit header information (asks if not given)\n";
 
 	std::cout << "\nImport Operations:\n";
 	std::cout << "  import_mat <filename>        Import materials from an external file\n";
 	std::cout << "  import_obj <filename>        Import an external OBJ\n";
 	std::cout << "  import_ini <filename>        Import an external INI file\n";
-	std::cout << "  import_tex                   Swaps a texture with an external TXE file (interactive)\n";
+	std::cout << "  import_tex [index] [file]    Swaps a texture with an external TXE file (asks if not given)\n";
 
 	std::cout << "\nExport Operations:\n";
 	std::cout << "  export_mat <filename>        Export all materials to a file\n";
@@ -54,52 +79,220 @@ void printUsage(const char* programName)
 	std::cout << "When no commands are provided, the program starts in interactive mode.\n";
 }
 
-bool processCommand(const std::string& commandStr)
+bool processCommand(cmd::Session& session, const std::string& commandStr)
 {
-	// Parse the command string
-	cmd::gTokeniser.read(commandStr);
-
-	if (cmd::gTokeniser.isEnd()) {
-		return true; // Empty command, skip
+	const cmd::Status status = modconv::runCommand(session, commandStr);
+	if (!status.mMessage.empty()) {
+		(status ? session.out() : std::cerr) << status.mMessage << std::endl;
 	}
 
-	std::string token = cmd::gTokeniser.next();
+	return status.mSuccess;
+}
 
-	// Find and execute the command
-	for (const cmd::Command& cmd : cmd::gCommands) {
-		if (cmd.mCommand == "NEW_LINE") {
-			continue;
+// Groups the command line into one string per command, each followed by its parameters
+bool buildCommandStrings(const std::vector<std::string>& args, std::vector<std::string>& commandStrings)
+{
+	std::string currentCommand;
+
+	for (const auto& arg : args) {
+		// Check if this is a known command
+		bool isCommand = false;
+		for (const cmd::Command& cmd : cmd::gCommands) {
+			if (cmd.mCommand == arg && cmd.mCommand != "NEW_LINE") {
+				isCommand = true;
+				break;
+			}
 		}
 
-		if (cmd.mCommand == token) {
-			try {
-				cmd.mFunction();
-				return true;
-			} catch (const std::exception& e) {
-				std::cerr << "Error executing command '" << token << "': " << e.what() << std::endl;
+		if (isCommand) {
+			// If we have a previous command, save it
+			if (!currentCommand.empty()) {
+				commandStrings.push_back(currentCommand);
+			}
+			currentCommand = arg;
+		} else {
+			// It's a parameter, append to current command
+			if (!currentCommand.empty()) {
+				currentCommand += " " + arg;
+			} else {
+				std::cerr << "Error: Parameter '" << arg << "' without a command." << std::endl;
 				return false;
 			}
 		}
 	}
 
-	std::cerr << "Unknown command: " << token << std::endl;
-	return false;
+	// Don't forget the last command
+	if (!currentCommand.empty()) {
+		commandStrings.push_back(currentCommand);
+	}
+
+	return true;
 }
 
+// Substitutes the per-file placeholders of a batch argument, quoting the result if it has spaces
+std::string expandBatchArgument(const std::string& arg, const std::filesystem::path& input)
+{
+	const std::pair<std::string_view, std::string> placeholders[] = {
+		{ "{path}", input.generic_string() },
+		{ "{dir}", input.has_parent_path() ? input.parent_path().generic_string() : "." },
+		{ "{name}", input.filename().string() },
+		{ "{stem}", input.stem().string() },
+	};
+
+	std::string result = arg;
+	for (const auto& [key, value] : placeholders) {
+		for (std::size_t pos = result.find(key); pos != std::string::npos; pos = result.find(key, pos + value.size())) {
+			result.replace(pos, key.size(), value);
+		}
+	}
+
+	return result.find(' ') != std::string::npos ? '"' + result + '"' : result;
+}
+
+int runBatch(const std::string& pattern, const std::vector<std::string>& args, unsigned jobs, bool quietMode)
+{
+	namespace fs = std::filesystem;
+
+	const std::vector<fs::path> inputs = util::ExpandGlob(pattern);
+	if (inputs.empty()) {
+		std::cerr << "No files match " << pattern << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Start on the biggest models so a large one doesn't end up running on its own at the end
+	std::vector<std::size_t> order(inputs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::vector<std::uintmax_t> sizes(inputs.size());
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		std::error_code ec;
+		sizes[i] = fs::file_size(inputs[i], ec);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+	// The command that failed for each file, empty when it converted cleanly
+	std::vector<std::string> failures(inputs.size());
+	std::mutex printMutex;
+	util::parallel_for(order.size(), jobs, [&](std::size_t i) {
+		const fs::path& input = inputs[order[i]];
+
+		util::profiler::scope profile("file", input.generic_string());
+
+		// Every file gets its own session, the files themselves are what runs in parallel. What its commands
+		// print is gathered and printed in one piece once the file is done, so files don't interleave
+		std::ostringstream log;
+		cmd::Session session;
+		session.mModFile.mVerbosePrint = false;
+		session.mModFile.mJobs         = 1;
+		session.setOutput(log);
+
+		std::vector<std::string> fileArgs { "load", expandBatchArgument("{path}", input) };
+		for (const std::string& arg : args) {
+			fileArgs.push_back(expandBatchArgument(arg, input));
+		}
+
+		std::vector<std::string> commandStrings;
+		if (!buildCommandStrings(fileArgs, commandStrings)) {
+			failures[order[i]] = "invalid command chain";
+			return;
+		}
+
+		for (const std::string& commandString : commandStrings) {
+			const cmd::Status status = modconv::runCommand(session, commandString);
+			if (!status.mMessage.empty()) {
+				log << status.mMessage << '\n';
+			}
+
+			if (!status) {
+				failures[order[i]] = commandString;
+				break;
+			}
+		}
+
+		if (log.tellp() > 0) {
+			const std::lock_guard lock(printMutex);
+			(failures[order[i]].empty() ? std::cout : std::cerr) << log.str() << std::flush;
+		}
+	});
+
+	std::size_t failed = 0;
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		if (!failures[i].empty()) {
+			std::cerr << "Failed: " << inputs[i].generic_string() << " (" << failures[i] << ")" << std::endl;
+			failed++;
+		}
+	}
+
+	if (!quietMode || failed != 0) {
+		std::cout << "\nBatch processing converted " << (inputs.size() - failed) << "/" << inputs.size() << " files." << std::endl;
+	}
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Reports the --profile samples and --trace events when main returns, whichever way it leaves
+struct ProfileReport {
+	bool mPrintTable = false;
+	std::string mJsonPath;
+	std::string mTracePath;
+
+	~ProfileReport()
+	{
+		if (mPrintTable) {
+			util::profiler::printTable(std::cout);
+		}
+
+		if (!mJsonPath.empty()) {
+			std::ofstream os(mJsonPath);
+			if (os.is_open()) {
+				util::profiler::printJson(os);
+			} else {
+				std::cerr << "Unable to open " << mJsonPath << std::endl;
+			}
+		}
+
+		if (!mTracePath.empty()) {
+			std::ofstream os(mTracePath);
+			if (os.is_open()) {
+				util::profiler::printTrace(os);
+			} else {
+				std::cerr << "Unable to open " << mTracePath << std::endl;
+			}
+		}
+	}
+};
+
 int main(int argc, char** argv)
 {
+	// When the model is streamed to stdout ("write -") or it carries server responses, keep
+	// stdout clean for that and send everything else we print to stderr instead
+	std::streambuf* const stdoutBuffer = std::cout.rdbuf();
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if ((arg == "write" && i + 1 < argc && std::string_view(argv[i + 1]) == "-") || arg == "--serve") {
+			std::cout.rdbuf(std::cerr.rdbuf());
+			break;
+		}
+	}
+
 	std::cout << "\t----------------------------" << std::endl;
 	std::cout << "\t-- modconv by intns, 2025 --" << std::endl;
 	std::cout << "\t----------------------------" << std::endl << std::endl;
 
 	// Default to verbose mode
-	cmd::gModFile.mVerbosePrint = true;
+	cmd::Session session;
+	session.mModFile.mVerbosePrint = true;
+
+	ProfileReport profileReport;
 
 	if (argc > 1) {
 		// Parse command-line arguments
 		std::vector<std::string> args;
 		bool quietMode   = false;
 		bool testVerbose = false;
+		std::optional<unsigned> jobs;
+		std::optional<std::string> batchPattern;
+		std::optional<std::string> servePath;
+		std::size_t cacheSize = modconv::ServerOptions().mCacheSize;
 
 		for (int i = 1; i < argc; ++i) {
 			std::string arg = argv[i];
@@ -110,28 +303,81 @@ int main(int argc, char** argv)
 				return EXIT_SUCCESS;
 			} else if (arg == "--test") {
 				// Save current verbose state and set to silent for tests
-				bool savedVerbose           = cmd::gModFile.mVerbosePrint;
-				cmd::gModFile.mVerbosePrint = testVerbose;
+				bool savedVerbose              = session.mModFile.mVerbosePrint;
+				session.mModFile.mVerbosePrint = testVerbose;
 
 				// Check if there's an optional test directory argument
 				if (i + 1 < argc && !std::string(argv[i + 1]).starts_with("-")) {
-					test::UnitTest(argv[++i]);
+					test::UnitTest(session, argv[++i]);
 				} else {
-					test::UnitTest();
+					test::UnitTest(session);
 				}
 
 				// Restore verbose state
-				cmd::gModFile.mVerbosePrint = savedVerbose;
+				session.mModFile.mVerbosePrint = savedVerbose;
 				return EXIT_SUCCESS;
 			} else if (arg == "--test-verbose") {
 				testVerbose = true;
 			} else if (arg == "--quiet" || arg == "-q") {
-				quietMode                   = true;
-				cmd::gModFile.mVerbosePrint = false;
+				quietMode                      = true;
+				session.mModFile.mVerbosePrint = false;
 			} else if (arg == "--verbose" || arg == "-v") {
-				quietMode                   = false;
-				cmd::gModFile.mVerbosePrint = true;
-			} else if (arg.starts_with("--") || arg.starts_with("-")) {
+				quietMode                      = false;
+				session.mModFile.mVerbosePrint = true;
+			} else if (arg == "--jobs" || arg == "-j") {
+				if (i + 1 >= argc) {
+					std::cerr << "Missing thread count after " << arg << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				try {
+					jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+				} catch (...) {
+					std::cerr << "Invalid thread count: " << argv[i] << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else if (arg == "--batch") {
+				if (i + 1 >= argc) {
+					std::cerr << "Missing file pattern after " << arg << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				batchPattern = argv[++i];
+			} else if (arg == "--serve") {
+				// Without a socket path the requests come from stdin
+				servePath = (i + 1 < argc && !std::string(argv[i + 1]).starts_with("-")) ? argv[++i] : "";
+			} else if (arg == "--cache") {
+				if (i + 1 >= argc) {
+					std::cerr << "Missing model count after " << arg << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				try {
+					cacheSize = std::stoul(argv[++i]);
+				} catch (...) {
+					std::cerr << "Invalid model count: " << argv[i] << std::endl;
+					return EXIT_FAILURE;
+				}
+			} else if (arg == "--profile") {
+				profileReport.mPrintTable = true;
+				util::profiler::enable();
+			} else if (arg == "--profile-json") {
+				if (i + 1 >= argc) {
+					std::cerr << "Missing output filename after " << arg << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				profileReport.mJsonPath = argv[++i];
+				util::profiler::enable();
+			} else if (arg == "--trace") {
+				if (i + 1 >= argc) {
+					std::cerr << "Missing output filename after " << arg << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				profileReport.mTracePath = argv[++i];
+				util::profiler::enableTrace();
+			} else if (arg != "-" && (arg.starts_with("--") || arg.starts_with("-"))) {
 				std::cerr << "Unknown option: " << arg << std::endl;
 				std::cerr << "Use --help for usage information." << std::endl;
 				return EXIT_FAILURE;
@@ -141,52 +387,44 @@ int main(int argc, char** argv)
 			}
 		}
 
+		if (batchPattern.has_value()) {
+			util::profiler::scope profile("chain", "batch " + batchPattern.value());
+			return runBatch(batchPattern.value(), args, jobs.value_or(0), quietMode);
+		}
+
+		session.mModFile.mJobs = jobs.value_or(1);
+
+		if (servePath.has_value()) {
+			const modconv::ServerOptions options { cacheSize, jobs.value_or(1) };
+			if (!servePath->empty()) {
+				std::cerr << modconv::serveSocket(servePath.value(), options).mMessage << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			std::ostream responses(stdoutBuffer);
+			modconv::serve(std::cin, responses, options);
+			return EXIT_SUCCESS;
+		}
+
 		// If we have commands to process
 		if (!args.empty()) {
 			// Build command strings by grouping command with its parameters
 			std::vector<std::string> commandStrings;
-			std::string currentCommand;
-
-			for (const auto& arg : args) {
-				// Check if this is a known command
-				bool isCommand = false;
-				for (const cmd::Command& cmd : cmd::gCommands) {
-					if (cmd.mCommand == arg && cmd.mCommand != "NEW_LINE") {
-						isCommand = true;
-						break;
-					}
-				}
-
-				if (isCommand) {
-					// If we have a previous command, save it
-					if (!currentCommand.empty()) {
-						commandStrings.push_back(currentCommand);
-					}
-					currentCommand = arg;
-				} else {
-					// It's a parameter, append to current command
-					if (!currentCommand.empty()) {
-						currentCommand += " " + arg;
-					} else {
-						std::cerr << "Error: Parameter '" << arg << "' without a command." << std::endl;
-						return EXIT_FAILURE;
-					}
-				}
-			}
-
-			// Don't forget the last command
-			if (!currentCommand.empty()) {
-				commandStrings.push_back(currentCommand);
+			if (!buildCommandStrings(args, commandStrings)) {
+				return EXIT_FAILURE;
 			}
 
 			// Process all commands
+			util::profiler::scope profile("chain", "command chain");
+			profile.setElements(commandStrings.size());
+
 			bool success = true;
 			for (size_t i = 0; i < commandStrings.size(); ++i) {
 				if (!quietMode && commandStrings.size() > 1) {
 					std::cout << "\n[" << (i + 1) << "/" << commandStrings.size() << "] Executing: " << commandStrings[i] << std::endl;
 				}
 
-				if (!processCommand(commandStrings[i])) {
+				if (!processCommand(session, commandStrings[i])) {
 					std::cerr << "Command failed. Stopping execution." << std::endl;
 					success = false;
 					break;
@@ -220,7 +458,7 @@ int main(int argc, char** argv)
 			break;
 		}
 
-		processCommand(input);
+		processCommand(session, input);
 		std::cout << std::endl;
 	}
 
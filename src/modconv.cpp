@@ -0,0 +1,131 @@
+#include "modconv.hpp"
+#include "commands.hpp"
+#include "util/profiler.hpp"
+#include <exception>
+
+namespace modconv {
+namespace {
+// Runs a command with already split arguments, turning anything it throws into a failed status
+Status invoke(Session& session, std::string_view name, Status (*command)(Session&), std::vector<std::string> args)
+{
+	session.mTokeniser.assign(std::move(args));
+	util::profiler::scope profile("command", std::string(name));
+
+	try {
+		return command(session);
+	} catch (const std::exception& e) {
+		return Status::error(e.what());
+	}
+}
+
+// Finds the command in the command table and runs it on the arguments left in the session's tokeniser
+Status dispatch(Session& session, const std::string& token)
+{
+	for (const cmd::Command& cmd : cmd::gCommands) {
+		if (cmd.mCommand == "NEW_LINE" || cmd.mCommand != token) {
+			continue;
+		}
+
+		util::profiler::scope profile("command", token);
+
+		try {
+			return cmd.mFunction(session);
+		} catch (const std::exception& e) {
+			return Status::error("Error executing command '" + token + "': " + e.what());
+		}
+	}
+
+	return Status::error("Unknown command: " + token);
+}
+} // namespace
+
+Status runCommand(Session& session, const std::string& command)
+{
+	session.mTokeniser.read(command);
+	if (session.mTokeniser.isEnd()) {
+		return {}; // Empty command, skip
+	}
+
+	const std::string token = session.mTokeniser.next();
+	return dispatch(session, token);
+}
+
+Status runCommand(Session& session, const std::string& command, std::vector<std::string> args)
+{
+	session.mTokeniser.assign(std::move(args));
+	return dispatch(session, command);
+}
+
+Status loadFromMemory(Session& session, std::span<const u8> data, const std::string& name)
+{
+	try {
+		util::profiler::scope profile("command", "load (memory)");
+		session.mModFile.reset();
+		session.mModFileName.clear();
+
+		util::span_reader reader(data);
+		session.mModFile.read(reader);
+		session.mModFileName = name;
+	} catch (const std::exception& e) {
+		return Status::error(e.what());
+	}
+
+	return {};
+}
+
+Status writeToMemory(Session& session, std::vector<u8>& buffer)
+{
+	if (!session.isModFileOpen()) {
+		return Status::error("You haven't opened a MOD file!");
+	}
+
+	try {
+		util::profiler::scope profile("command", "write (memory)");
+		util::vector_writer writer;
+		session.mModFile.write(writer);
+		buffer = writer.takeBuffer();
+	} catch (const std::exception& e) {
+		return Status::error(e.what());
+	}
+
+	return {};
+}
+
+Status loadFromFile(Session& session, const std::string& filename) { return invoke(session, "load", cmd::mod::importMod, { filename }); }
+Status writeToFile(Session& session, const std::string& filename) { return invoke(session, "write", cmd::mod::exportMod, { filename }); }
+
+Status importObj(Session& session, const std::string& filename) { return invoke(session, "import_obj", cmd::mod::importObj, { filename }); }
+Status exportObj(Session& session, const std::string& filename) { return invoke(session, "export_obj", cmd::mod::exportObj, { filename }); }
+
+Status importMaterials(Session& session, const std::string& filename)
+{
+	return invoke(session, "import_mat", cmd::mod::importMaterials, { filename });
+}
+
+Status exportMaterials(Session& session, const std::string& filename)
+{
+	return invoke(session, "export_mat", cmd::mod::exportMaterials, { filename });
+}
+
+Status importCollision(Session& session, const std::string& filename)
+{
+	return invoke(session, "import_col", cmd::mod::importCollision, { filename });
+}
+
+Status exportCollision(Session& session, const std::string& filename)
+{
+	return invoke(session, "export_col", cmd::mod::exportCollision, { filename });
+}
+
+Status importTexture(Session& session, u32 index, const std::string& filename)
+{
+	return invoke(session, "import_tex", cmd::mod::importTexture, { std::to_string(index), filename });
+}
+
+Status exportTextures(Session& session, const std::string& directory)
+{
+	return invoke(session, "export_tex", cmd::mod::exportTextures, { directory });
+}
+
+Status exportDmd(Session& session, const std::string& filename) { return invoke(session, "export_dmd", cmd::mod::exportDmd, { filename }); }
+} // namespace modconv
@@ -0,0 +1,79 @@
+#ifndef _MODCONV_HPP
+#define _MODCONV_HPP
+
+#pragma once
+
+#include "session.hpp"
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief In-process interface of the modconv_core library.
+ *
+ * Every function works on the session it is given and reports the outcome as a Status instead of
+ * printing it; nothing throws. Reports and progress go to std::cout unless Session::setOutput() points
+ * them elsewhere, and set session.mModFile.mVerbosePrint to false to silence progress output. Separate
+ * sessions can be used from separate threads as long as they don't print to the same stream.
+ */
+namespace modconv {
+using cmd::Session;
+using cmd::Status;
+
+/**
+ * @brief Runs a single command line as typed in the interactive shell, e.g. "export_obj model.obj".
+ * @param session The session to run the command on.
+ * @param command The command followed by its parameters.
+ * @return The outcome of the command, or an error if it is unknown or threw.
+ */
+Status runCommand(Session& session, const std::string& command);
+
+/**
+ * @brief Runs a command with already split parameters, which may contain whitespace.
+ * @param session The session to run the command on.
+ * @param command The name of the command, e.g. "export_obj".
+ * @param args The parameters of the command.
+ * @return The outcome of the command, or an error if it is unknown or threw.
+ */
+Status runCommand(Session& session, const std::string& command, std::vector<std::string> args);
+
+/**
+ * @brief Loads a MOD file from memory. The bytes are copied, so they don't need to outlive the call.
+ * @param session The session to load the model into.
+ * @param data The contents of the MOD file.
+ * @param name The name the model is known by, used in place of a file name.
+ */
+Status loadFromMemory(Session& session, std::span<const u8> data, const std::string& name = "memory.mod");
+
+/**
+ * @brief Serializes the loaded model into memory.
+ * @param session The session holding the model.
+ * @param buffer Receives the contents of the MOD file.
+ */
+Status writeToMemory(Session& session, std::vector<u8>& buffer);
+
+Status loadFromFile(Session& session, const std::string& filename);
+Status writeToFile(Session& session, const std::string& filename);
+
+Status importObj(Session& session, const std::string& filename);
+Status exportObj(Session& session, const std::string& filename);
+
+Status importMaterials(Session& session, const std::string& filename);
+Status exportMaterials(Session& session, const std::string& filename);
+
+Status importCollision(Session& session, const std::string& filename);
+Status exportCollision(Session& session, const std::string& filename);
+
+/**
+ * @brief Replaces a texture with the contents of a TXE file.
+ * @param session The session holding the model.
+ * @param index The index of the texture to replace.
+ * @param filename The TXE file to read.
+ */
+Status importTexture(Session& session, u32 index, const std::string& filename);
+Status exportTextures(Session& session, const std::string& directory);
+
+Status exportDmd(Session& session, const std::string& filename);
+} // namespace modconv
+
+#endif
@@ -0,0 +1,288 @@
+#include "server.hpp"
+#include "modconv.hpp"
+#include "util/text_serializer.hpp"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace modconv {
+namespace {
+namespace fs = std::filesystem;
+
+class Server {
+public:
+	explicit Server(const ServerOptions& options)
+	    : mOptions(options)
+	{
+		mScratch.mModFile.mVerbosePrint = false;
+		mScratch.mIn                    = nullptr;
+	}
+
+	// Answers a single request line, the response is a single line too
+	std::string handle(const std::string& line)
+	{
+		std::optional<int64_t> numericId;
+		std::optional<std::string> stringId;
+		std::string file;
+		std::string command;
+		std::vector<std::string> args;
+
+		Status status;
+		try {
+			std::istringstream stream(line);
+			serialization::JsonTextDeserializer request(stream);
+
+			if (int64_t id = 0; request.read("id", id)) {
+				numericId = id;
+			} else if (std::string id; request.read("id", id)) {
+				stringId = id;
+			}
+
+			request.read("file", file);
+			if (!request.read("command", command)) {
+				status = Status::error("Request has no command");
+			}
+
+			if (request.enterArray("args")) {
+				for (std::size_t i = 0; i < request.getArraySize(); ++i) {
+					std::string arg;
+					request.readArrayValue(arg);
+					args.push_back(arg);
+					request.nextArrayElement();
+				}
+				request.exitArray();
+			}
+		} catch (const std::exception& e) {
+			status = Status::error(e.what());
+		}
+
+		std::ostringstream output;
+		bool cached = false;
+		if (status) {
+			// Every connection shares the cache, so requests are answered one at a time
+			const std::lock_guard lock(mMutex);
+
+			Session* session = &mScratch;
+			if (!file.empty()) {
+				status = replacesModel(command) ? Status::error("'" + command + "' would replace the cached model of " + file
+				                                                + ", send it without a file")
+				                                : acquire(file, session, cached);
+			}
+
+			if (status) {
+				session->setOutput(output);
+				status = runCommand(*session, command, std::move(args));
+				session->setOutput(std::cout);
+			}
+		}
+
+		std::ostringstream response;
+		serialization::JsonTextSerializer writer(response, true);
+		writer.beginDocument();
+		if (numericId.has_value()) {
+			writer.write("id", numericId.value());
+		} else if (stringId.has_value()) {
+			writer.write("id", stringId.value());
+		}
+		writer.write("ok", status.mSuccess);
+		writer.write("message", status.mMessage);
+		writer.write("output", output.str());
+		writer.write("cached", cached);
+		writer.endDocument();
+
+		return response.str();
+	}
+
+private:
+	struct CacheEntry {
+		std::string mPath;
+		fs::file_time_type mModified;
+		std::unique_ptr<Session> mSession;
+	};
+
+	// Cached sessions stay keyed by their file, so they must keep holding that file's model
+	static bool replacesModel(const std::string& command) { return command == "load" || command == "reset" || command == "generate"; }
+
+	// Finds the session for a file, loading it again if it isn't cached or changed on disk since
+	Status acquire(const std::string& file, Session*& session, bool& cached)
+	{
+		std::error_code ec;
+		std::string path = fs::weakly_canonical(file, ec).string();
+		if (ec) {
+			path = file;
+		}
+
+		const fs::file_time_type modified = fs::last_write_time(path, ec);
+		if (ec) {
+			return Status::error("Unable to open " + file);
+		}
+
+		const auto it = std::find_if(mCache.begin(), mCache.end(), [&](const CacheEntry& entry) { return entry.mPath == path; });
+		if (it != mCache.end() && it->mModified == modified) {
+			mCache.splice(mCache.begin(), mCache, it);
+			session = mCache.front().mSession.get();
+			cached  = true;
+			return {};
+		}
+
+		if (it != mCache.end()) {
+			mCache.erase(it);
+		}
+
+		auto loaded                    = std::make_unique<Session>();
+		loaded->mModFile.mVerbosePrint = false;
+		loaded->mModFile.mJobs         = mOptions.mJobs;
+		loaded->mIn                    = nullptr; // Stdin carries the requests, commands can't ask for anything
+		if (Status status = loadFromFile(*loaded, path); !status) {
+			return status;
+		}
+
+		// Cached models can outlive any number of edits to their file, which would pull a mapping out from
+		// under the chunks that haven't been decoded yet, so they keep a copy instead
+		loaded->mModFile.detachSource();
+
+		mCache.push_front({ path, modified, std::move(loaded) });
+		while (mCache.size() > std::max<std::size_t>(mOptions.mCacheSize, 1)) {
+			mCache.pop_back();
+		}
+
+		session = mCache.front().mSession.get();
+		return {};
+	}
+
+	ServerOptions mOptions;
+	std::list<CacheEntry> mCache; // Most recently used first
+	Session mScratch;             // For requests that don't name a file
+	std::mutex mMutex;
+};
+
+#ifndef _WIN32
+void serveConnection(Server& server, int connection)
+{
+	std::string pending;
+	std::array<char, 0x1000> block {};
+	while (true) {
+		const ssize_t received = ::recv(connection, block.data(), block.size(), 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (received <= 0) {
+			break;
+		}
+
+		pending.append(block.data(), static_cast<std::size_t>(received));
+		for (std::size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n')) {
+			const std::string line = pending.substr(0, end);
+			pending.erase(0, end + 1);
+			if (line.find_first_not_of(" \t\r") == std::string::npos) {
+				continue;
+			}
+
+			const std::string response = server.handle(line);
+			for (std::size_t sent = 0; sent < response.size();) {
+				const ssize_t written = ::send(connection, response.data() + sent, response.size() - sent, 0);
+				if (written < 0 && errno == EINTR) {
+					continue;
+				}
+
+				if (written <= 0) {
+					::close(connection);
+					return;
+				}
+				sent += static_cast<std::size_t>(written);
+			}
+		}
+	}
+
+	::close(connection);
+}
+#endif
+} // namespace
+
+void serve(std::istream& in, std::ostream& out, const ServerOptions& options)
+{
+	Server server(options);
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos) {
+			continue;
+		}
+
+		out << server.handle(line);
+		out.flush();
+	}
+}
+
+cmd::Status serveSocket(const std::string& path, const ServerOptions& options)
+{
+#ifdef _WIN32
+	(void)path;
+	(void)options;
+	return Status::error("Unix sockets aren't supported on this platform");
+#else
+	sockaddr_un address {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		return Status::error("Socket path is too long: " + path);
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		return Status::error("Unable to create a socket: " + std::string(std::strerror(errno)));
+	}
+
+	// A socket left behind by an earlier run would make bind fail, anything else at that path is left alone
+	std::error_code ec;
+	if (fs::is_socket(path, ec)) {
+		::unlink(path.c_str());
+	}
+
+	if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+		const std::string error = std::strerror(errno);
+		::close(listener);
+		return Status::error("Unable to listen on " + path + ": " + error);
+	}
+
+	// Clients that hang up early shouldn't take the whole server down
+	std::signal(SIGPIPE, SIG_IGN);
+
+	// Connection threads are detached, so they share ownership of the server
+	const auto server = std::make_shared<Server>(options);
+	while (true) {
+		const int connection = ::accept(listener, nullptr, nullptr);
+		if (connection < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		std::thread([server, connection]() { serveConnection(*server, connection); }).detach();
+	}
+
+	const std::string error = std::strerror(errno);
+	::close(listener);
+	return Status::error("Stopped accepting connections on " + path + ": " + error);
+#endif
+}
+
+} // namespace modconv
@@ -0,0 +1,41 @@
+#ifndef _SERVER_HPP
+#define _SERVER_HPP
+
+#pragma once
+
+#include "session.hpp"
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace modconv {
+
+struct ServerOptions {
+	std::size_t mCacheSize = 8; // Models kept loaded between requests, least recently used ones go first
+	unsigned mJobs         = 1; // Threads each model uses to decode and encode its chunks
+};
+
+/**
+ * @brief Answers line-delimited JSON requests until the input ends.
+ *
+ * Each request is an object such as {"id": 1, "file": "model.mod", "command": "export_obj", "args": ["model.obj"]}
+ * and gets exactly one response line: {"id": 1, "ok": true, "message": "", "output": "...", "cached": true}.
+ * "output" holds whatever the command printed. Models are loaded once and kept in an LRU cache keyed by
+ * path and modification time, so edits made by earlier requests stay visible until the file changes on disk.
+ * @param in The stream requests are read from.
+ * @param out The stream responses are written to.
+ * @param options The cache and threading settings.
+ */
+void serve(std::istream& in, std::ostream& out, const ServerOptions& options);
+
+/**
+ * @brief Same as serve(), over a Unix domain socket. Every connection is served on its own thread.
+ * @param path The path of the socket to create.
+ * @param options The cache and threading settings.
+ * @return An error if the socket couldn't be set up, otherwise it doesn't return.
+ */
+cmd::Status serveSocket(const std::string& path, const ServerOptions& options);
+
+} // namespace modconv
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _SESSION_HPP
+#define _SESSION_HPP
+
+#pragma once
+
+#include "util/tokeniser.hpp"
+#include "MOD.hpp"
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace cmd {
+
+/**
+ * @brief Outcome of a command.
+ *
+ * Failures describe what went wrong, successes may carry a note for the user (e.g. that there was
+ * nothing to export).
+ */
+struct Status {
+	bool mSuccess = true;
+	std::string mMessage;
+
+	static Status ok(std::string message = "") { return { true, std::move(message) }; }
+	static Status error(std::string message) { return { false, std::move(message) }; }
+
+	explicit operator bool() const { return mSuccess; }
+};
+
+/**
+ * @brief Everything a chain of commands works on: the loaded model, the file it came from and the
+ * arguments still to be consumed.
+ *
+ * Commands only ever touch the session they are given, their reports included, so separate sessions
+ * can run on separate threads.
+ */
+struct Session {
+	MOD mModFile;
+	std::string mModFileName;
+	util::tokeniser mTokeniser;
+	std::ostream* mOut = &std::cout; // Where commands print their reports, see setOutput()
+	std::istream* mIn  = &std::cin;  // Where commands ask for what wasn't given as arguments, null if nobody can answer
+
+	/**
+	 * @brief Redirects what commands print, the model's progress output included, to another stream.
+	 * @param out The stream to print to, it must outlive its use by this session.
+	 */
+	void setOutput(std::ostream& out)
+	{
+		mOut          = &out;
+		mModFile.mLog = &out;
+	}
+
+	[[nodiscard]] std::ostream& out() const { return *mOut; }
+
+	/**
+	 * @brief Checks if a MOD file has been loaded into this session.
+	 * @return True if a MOD file is open.
+	 */
+	[[nodiscard]] bool isModFileOpen() const { return !mModFileName.empty(); }
+};
+
+} // namespace cmd
+
+#endif
@@ -3,14 +3,29 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include "commands.hpp"
+#include "common/dlist_writer.hpp"
+#include "modconv.hpp"
 #include "util/misc.hpp"
 
 namespace test {
 namespace fs = std::filesystem;
 
+// Where the tests write their files, UnitTest removes it once they're done
+inline fs::path ScratchPath(const std::string& name = "")
+{
+	const fs::path directory = fs::temp_directory_path() / "modconv_test";
+	fs::create_directories(directory);
+	return directory / name;
+}
+
 inline std::vector<fs::path> BuildUnitPathList(const std::string& path = "unit")
 {
 	// Assume it's in unit/ folder
@@ -37,7 +52,7 @@ inline std::vector<fs::path> BuildUnitPathList(const std::string& path = "unit")
 	return pathList;
 }
 
-inline bool Unit_TestReadWrite(const fs::path& path)
+inline bool Unit_TestReadWrite(cmd::Session& session, const fs::path& path)
 {
 	std::error_code ec;
 	const auto relativePath = fs::relative(path, fs::current_path(), ec);
@@ -46,19 +61,22 @@ inline bool Unit_TestReadWrite(const fs::path& path)
 		return false;
 	}
 
-	cmd::gTokeniser.read(relativePath.string());
-	cmd::mod::importMod();
+	session.mTokeniser.read(relativePath.string());
+	cmd::mod::importMod(session);
+
+	// Untouched chunks are passed through as is, decode them so the chunk readers and writers are what gets tested
+	session.mModFile.decodeAll();
 
-	cmd::gTokeniser.read("out.mod");
-	cmd::mod::exportMod();
+	session.mTokeniser.read(ScratchPath("out.mod").string());
+	cmd::mod::exportMod(session);
 
-	cmd::mod::resetModel();
+	cmd::mod::resetModel(session);
 
 	// Ensure the file is the same, byte for byte
-	return util::AreFilesIdentical(path, "out.mod");
+	return util::AreFilesIdentical(path, ScratchPath("out.mod").string());
 }
 
-inline bool Unit_TestMaterialReadWrite(const fs::path& path)
+inline bool Unit_TestMaterialReadWrite(cmd::Session& session, const fs::path& path)
 {
 	// Build a list of
 	std::error_code ec;
@@ -69,28 +87,30 @@ inline bool Unit_TestMaterialReadWrite(const fs::path& path)
 	}
 
 	// Load relativePath
-	cmd::gTokeniser.read(relativePath.string());
-	cmd::mod::importMod();
+	session.mTokeniser.read(relativePath.string());
+	cmd::mod::importMod(session);
 
-	cmd::mod::exportMaterials();
+	session.mTokeniser.read(ScratchPath("materials.json").string());
+	cmd::mod::exportMaterials(session);
 
 	// Delete the material chunk and import our export (testing our export)
-	cmd::gTokeniser.read("0x30");
-	cmd::mod::deleteChunk();
+	session.mTokeniser.read("0x30");
+	cmd::mod::deleteChunk(session);
 
-	cmd::mod::importMaterials();
+	session.mTokeniser.read(ScratchPath("materials.json").string());
+	cmd::mod::importMaterials(session);
 
 	// Load out.mod
-	cmd::gTokeniser.read("out.mod");
-	cmd::mod::exportMod();
+	session.mTokeniser.read(ScratchPath("out.mod").string());
+	cmd::mod::exportMod(session);
 
 	// Cleanup and check parity
-	cmd::mod::resetModel();
+	cmd::mod::resetModel(session);
 
-	return util::AreFilesIdentical(path, "out.mod");
+	return util::AreFilesIdentical(path, ScratchPath("out.mod").string());
 }
 
-inline bool Unit_TestCollisionReadWrite(const fs::path& path)
+inline bool Unit_TestCollisionReadWrite(cmd::Session& session, const fs::path& path)
 {
 	// Build a list of
 	std::error_code ec;
@@ -101,47 +121,455 @@ inline bool Unit_TestCollisionReadWrite(const fs::path& path)
 	}
 
 	// Load relativePath
-	cmd::gTokeniser.read(relativePath.string());
-	cmd::mod::importMod();
+	session.mTokeniser.read(relativePath.string());
+	cmd::mod::importMod(session);
 
-	MOD& mod = cmd::gModFile;
+	MOD& mod = session.mModFile;
+	mod.decode({ MOD::EChunkType::CollisionPrism, MOD::EChunkType::CollisionGrid });
 
 	if (mod.mCollisionGridInfo.mGroups.empty() && mod.mCollisionTriangles.mCollInfo.empty()) {
 		return true;
 	}
 
-	cmd::mod::exportCollision();
+	session.mTokeniser.read(ScratchPath("collision.json").string());
+	cmd::mod::exportCollision(session);
 
 	// Delete the material chunk and import our export (testing our export)
-	cmd::gTokeniser.read("0x100");
-	cmd::mod::deleteChunk();
+	session.mTokeniser.read("0x100");
+	cmd::mod::deleteChunk(session);
 
-	cmd::gTokeniser.read("0x110");
-	cmd::mod::deleteChunk();
+	session.mTokeniser.read("0x110");
+	cmd::mod::deleteChunk(session);
 
-	cmd::mod::importCollision();
+	session.mTokeniser.read(ScratchPath("collision.json").string());
+	cmd::mod::importCollision(session);
 
 	// Load out.mod
-	cmd::gTokeniser.read("out.mod");
-	cmd::mod::exportMod();
+	session.mTokeniser.read(ScratchPath("out.mod").string());
+	cmd::mod::exportMod(session);
 
 	// Cleanup and check parity
-	cmd::mod::resetModel();
+	cmd::mod::resetModel(session);
+
+	return util::AreFilesIdentical(path, ScratchPath("out.mod").string());
+}
+
+// Exports DMD files from generated models without texcoords or normals, whose vertices are laid out differently
+inline bool Unit_TestDmdVertexLayouts(cmd::Session& session)
+{
+	for (const char* settings : { "seed=5 texcoords=0", "seed=5 normals=0", "seed=5 texcoords=0 normals=0", "seed=5" }) {
+		session.mTokeniser.read(settings);
+		cmd::mod::generateModel(session);
+
+		// Every vertex of every primitive becomes a vcd_dat line
+		std::size_t expectedVertices = 0;
+		for (const Mesh& mesh : session.mModFile.mMeshes) {
+			for (const MeshPacket& packet : mesh.mPackets) {
+				for (const DisplayList& dlist : packet.mDisplayLists) {
+					util::span_reader reader(dlist.mData);
+					DisplayListReader dlReader(reader, mesh.mVtxDescriptor);
+					dlReader.parse();
+					expectedVertices += dlReader.getStats().mTotalVertices;
+				}
+			}
+		}
+
+		session.mTokeniser.read(ScratchPath("out.dmd").string());
+		const bool exported = static_cast<bool>(cmd::mod::exportDmd(session));
+		cmd::mod::resetModel(session);
+		if (!exported) {
+			std::cout << "export_dmd failed on a model generated with " << settings << std::endl;
+			return false;
+		}
+
+		std::ifstream dmd(ScratchPath("out.dmd"));
+		std::size_t vertices = 0;
+		for (std::string line; std::getline(dmd, line);) {
+			vertices += line.starts_with("\tvcd_dat") ? 1 : 0;
+		}
+		if (vertices != expectedVertices) {
+			std::cout << "export_dmd wrote " << vertices << " of " << expectedVertices << " vertices of a model generated with "
+			          << settings << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Runs a command with its output captured, for commands that print their results
+inline cmd::Status RunCaptured(cmd::Session& session, cmd::Status (*command)(cmd::Session&), const std::string& args, std::string& output)
+{
+	std::ostringstream captured;
+	session.setOutput(captured);
+
+	session.mTokeniser.read(args);
+	cmd::Status status;
+	try {
+		status = command(session);
+	} catch (const std::exception& e) {
+		status = cmd::Status::error(e.what());
+	}
+
+	session.setOutput(std::cout);
+	output = captured.str();
+	return status;
+}
+
+// Generated models have never been on disk and have no chunk directory, list_chunks lists their decoded chunks
+inline bool Unit_TestListGeneratedChunks(cmd::Session& session)
+{
+	session.mTokeniser.read("seed=5");
+	cmd::mod::generateModel(session);
+
+	std::string summary, full;
+	const cmd::Status summaryStatus = RunCaptured(session, cmd::mod::listChunks, "", summary);
+	const cmd::Status fullStatus    = RunCaptured(session, cmd::mod::listChunks, "full", full);
+	cmd::mod::resetModel(session);
+
+	if (!summaryStatus || !fullStatus) {
+		std::cout << "list_chunks failed on a generated model: " << summaryStatus.mMessage << fullStatus.mMessage << std::endl;
+		return false;
+	}
+	if (summary.find("Vertices") == std::string::npos) {
+		std::cout << "list_chunks left the vertices out of a generated model's chunks" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Library callers load from memory under a name that isn't a file, commands must not go looking for it on disk
+inline bool Unit_TestLoadFromMemory(cmd::Session& session)
+{
+	session.mTokeniser.read("seed=9");
+	cmd::mod::generateModel(session);
+
+	std::vector<u8> bytes;
+	if (!modconv::writeToMemory(session, bytes) || !modconv::loadFromMemory(session, bytes)) {
+		std::cout << "Couldn't round trip a generated model through memory" << std::endl;
+		return false;
+	}
+
+	std::ostringstream captured;
+	session.setOutput(captured);
+	const cmd::Status listed = modconv::runCommand(session, "list_chunks");
+	session.setOutput(std::cout);
+
+	std::vector<u8> rewritten;
+	const bool written = static_cast<bool>(modconv::writeToMemory(session, rewritten));
+	cmd::mod::resetModel(session);
+
+	if (!listed) {
+		std::cout << "list_chunks failed on a model loaded from memory: " << listed.mMessage << std::endl;
+		return false;
+	}
+	if (captured.str().find(std::to_string(bytes.size()) + " bytes") == std::string::npos) {
+		std::cout << "list_chunks didn't report the " << bytes.size() << " bytes loaded from memory" << std::endl;
+		return false;
+	}
+	if (!written || rewritten != bytes) {
+		std::cout << "A model loaded from memory didn't write back the same bytes" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Loaded files stay mapped until every chunk is decoded, so overwriting the file mustn't pull the bytes out from under them
+inline bool Unit_TestOverwriteMappedFile(cmd::Session& session)
+{
+	const std::string mapped = ScratchPath("mapped.mod").string();
+	session.mTokeniser.read("seed=11");
+	cmd::mod::generateModel(session);
+	modconv::writeToFile(session, mapped);
+
+	// Dropping the vertex colours moves every later chunk, so stale bytes can't pass for the right ones
+	std::vector<u8> expected;
+	modconv::runCommand(session, "delete_chunk", { "0x13" });
+	modconv::writeToMemory(session, expected);
+
+	std::vector<u8> actual;
+	bool ok = modconv::loadFromFile(session, mapped) && modconv::runCommand(session, "delete_chunk", { "0x13" })
+	       && modconv::writeToFile(session, mapped);
+	if (ok) {
+		session.mModFile.decodeAll();
+		ok = static_cast<bool>(modconv::writeToMemory(session, actual));
+	}
+	cmd::mod::resetModel(session);
+
+	if (!ok || actual != expected) {
+		std::cout << "Overwriting the loaded file changed the model" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Vertices are welded byte for byte, so tests compare them the same way
+inline bool SameVertex(const VertexAttrib& a, const VertexAttrib& b) { return std::memcmp(&a, &b, sizeof(VertexAttrib)) == 0; }
+
+// A vertex with every attribute the descriptor stores derived from n, so different n give different vertices
+inline VertexAttrib MakeVertex(u32 n, u32 vcd)
+{
+	VertexAttrib vertex;
+	vertex.mPosition    = static_cast<u16>(n);
+	vertex.mNormal      = static_cast<u16>(n * 7);
+	vertex.mMatrixIndex = (vcd & VCD::MatrixIndex) ? static_cast<u8>(n % 10 * 3) : 0;
+	vertex.mColor       = (vcd & VCD::Color0) ? static_cast<u16>(n * 3) : 0;
+	for (u32 i = 0; i < 8; ++i) {
+		vertex.mTexcoords[i] = (vcd & (VCD::Tex0 << i)) ? static_cast<u16>(n + i) : 0;
+	}
+	return vertex;
+}
+
+// Two triangles per cell of a size x size vertex grid, every inner vertex is shared by six of them
+inline std::vector<u32> GridIndices(u32 size)
+{
+	std::vector<u32> indices;
+	for (u32 y = 0; y + 1 < size; ++y) {
+		for (u32 x = 0; x + 1 < size; ++x) {
+			const u32 c = y * size + x;
+			indices.insert(indices.end(), { c, c + size, c + 1, c + 1, c + size, c + size + 1 });
+		}
+	}
+	return indices;
+}
+
+// Whatever DisplayListWriter writes, DisplayListReader must read back as the same primitives and vertices
+inline bool Unit_TestDisplayListRoundTrip()
+{
+	for (const u32 vcd : { 0u, VCD::MatrixIndex | VCD::Color0 | VCD::Tex0 | (VCD::Tex0 << 7) }) {
+		std::vector<VertexAttrib> vertices;
+		for (u32 n = 0; n < 16; ++n) {
+			vertices.push_back(MakeVertex(n * 997, vcd));
+		}
+
+		util::vector_writer writer;
+		DisplayListWriter dlWriter(writer, vcd);
+		dlWriter.writeStrip(std::span(vertices).first(7));
+		dlWriter.writeTriangles(std::span(vertices).last(9));
+		if (dlWriter.finish() != 2 || writer.getPosition() % DisplayListWriter::Alignment != 0) {
+			std::cout << "DisplayListWriter miscounted or misaligned a display list" << std::endl;
+			return false;
+		}
+
+		const std::vector<u8> data = writer.takeBuffer();
+		util::span_reader reader(data);
+		const std::vector<FaceBatch> batches = DisplayListReader(reader, vcd).parse();
+		if (batches.size() != 2 || batches[0].mPrimType != PrimitiveType::TriangleStrip || batches[1].mPrimType != PrimitiveType::Triangles
+		    || !std::equal(vertices.begin(), vertices.begin() + 7, batches[0].mVertices.begin(), batches[0].mVertices.end(), SameVertex)
+		    || !std::equal(vertices.end() - 9, vertices.end(), batches[1].mVertices.begin(), batches[1].mVertices.end(), SameVertex)) {
+			std::cout << "DisplayListReader didn't read back what DisplayListWriter wrote" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// forEachTriangle must give the triangles parse() does, in the same order and winding, and convertToIndexed
+// must weld them into the same mesh either way
+inline bool Unit_TestTriangleVisitor()
+{
+	const u32 vcd = VCD::MatrixIndex | VCD::Tex0;
+	std::vector<VertexAttrib> vertices;
+	for (u32 n = 0; n < 15; ++n) {
+		vertices.push_back(MakeVertex(n % 7, vcd));
+	}
+
+	// Strips of odd and even length around a triangle list
+	util::vector_writer writer;
+	DisplayListWriter dlWriter(writer, vcd);
+	dlWriter.writeStrip(std::span(vertices).subspan(0, 5));
+	dlWriter.writeTriangles(std::span(vertices).subspan(5, 6));
+	dlWriter.writeStrip(std::span(vertices).subspan(11, 4));
+	dlWriter.finish();
+	const std::vector<u8> data = writer.takeBuffer();
+
+	util::span_reader parseReader(data), visitReader(data), indexReader(data);
+	const std::vector<FaceBatch> batches = DisplayListReader(parseReader, vcd).parse();
+
+	std::vector<VertexAttrib> visited;
+	DisplayListReader(visitReader, vcd).forEachTriangle([&](const Triangle& tri) {
+		visited.insert(visited.end(), tri.mVertices, tri.mVertices + 3);
+	});
+
+	std::vector<VertexAttrib> parsed;
+	for (const FaceBatch& batch : batches) {
+		for (const Triangle& tri : batch.getTriangles()) {
+			parsed.insert(parsed.end(), tri.mVertices, tri.mVertices + 3);
+		}
+	}
+
+	DisplayListReader indexer(indexReader, vcd);
+	const DListUtils::IndexedMesh fromBatches = DListUtils::convertToIndexed(batches);
+	const DListUtils::IndexedMesh fromReader  = DListUtils::convertToIndexed(indexer);
+
+	return parsed.size() == 7 * 3 && std::equal(parsed.begin(), parsed.end(), visited.begin(), visited.end(), SameVertex)
+	    && fromBatches.indices == fromReader.indices
+	    && std::equal(fromBatches.vertices.begin(), fromBatches.vertices.end(), fromReader.vertices.begin(), fromReader.vertices.end(),
+	                  SameVertex);
+}
+
+// Identical vertices must share an index, numbered in the order they first appear, and vertices that differ in
+// any attribute must not be merged
+inline bool Unit_TestWelding()
+{
+	const u32 vcd = VCD::MatrixIndex | VCD::Color0 | VCD::Tex0;
+	const VertexAttrib a = MakeVertex(1, vcd), b = MakeVertex(2, vcd), c = MakeVertex(3, vcd), d = MakeVertex(4, vcd);
+	VertexAttrib almostA  = a;
+	almostA.mTexcoords[7] = 1;
+
+	// A quad sharing an edge and a triangle that only differs from the first in its last texcoord
+	DListUtils::IndexedMeshBuilder shared;
+	shared.add(Triangle { a, b, c });
+	shared.add(Triangle { c, b, d });
+	shared.add(Triangle { almostA, b, c });
+	const DListUtils::IndexedMesh quad = shared.take();
+	if (quad.vertices.size() != 5 || quad.indices != std::vector<u32> { 0, 1, 2, 2, 1, 3, 4, 1, 2 }) {
+		std::cout << "Welding merged the wrong vertices" << std::endl;
+		return false;
+	}
+
+	for (const bool reserve : { false, true }) {
+		// No duplicates, enough of them that an unreserved table has to grow
+		DListUtils::IndexedMeshBuilder unique;
+		if (reserve) {
+			unique.reserve(300, 100);
+		}
+		for (u32 n = 0; n < 300; n += 3) {
+			unique.add(Triangle { MakeVertex(n, vcd), MakeVertex(n + 1, vcd), MakeVertex(n + 2, vcd) });
+		}
+		const DListUtils::IndexedMesh mesh = unique.take();
+		for (u32 n = 0; n < 300; ++n) {
+			if (mesh.indices.size() != 300 || mesh.indices[n] != n || !SameVertex(mesh.vertices[n], MakeVertex(n, vcd))) {
+				std::cout << "Welding changed a mesh without duplicate vertices" << std::endl;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
 
-	return util::AreFilesIdentical(path, "out.mod");
+// Rotates every non-degenerate triangle so its smallest index comes first, which keeps its winding, and sorts them
+inline std::vector<std::array<u32, 3>> TriangleSet(const std::vector<u32>& indices)
+{
+	std::vector<std::array<u32, 3>> triangles;
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+		std::array<u32, 3> tri = { indices[i], indices[i + 1], indices[i + 2] };
+		if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]) {
+			std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+			triangles.push_back(tri);
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// The strips must draw every triangle of the index buffer once with its winding, degenerate ones left out
+inline bool Unit_TestStripify()
+{
+	std::vector<u32> indices = GridIndices(9);
+	indices.insert(indices.end(), { 3, 3, 4 });
+
+	for (const std::size_t maxVertices : { std::size_t { 65535 }, std::size_t { 8 } }) {
+		std::vector<u32> drawn;
+		for (const DListUtils::IndexedPrimitive& primitive : DListUtils::stripify(indices, 2, maxVertices)) {
+			const std::vector<u32>& v = primitive.mIndices;
+			if (v.size() > maxVertices) {
+				return false;
+			}
+
+			if (primitive.mType == PrimitiveType::Triangles) {
+				drawn.insert(drawn.end(), v.begin(), v.end());
+				continue;
+			}
+
+			// Every odd triangle of a strip is drawn reversed
+			for (std::size_t j = 2; j < v.size(); ++j) {
+				drawn.insert(drawn.end(), { v[j - 2 + (j & 1)], v[j - 1 - (j & 1)], v[j] });
+			}
+		}
+
+		if (TriangleSet(drawn) != TriangleSet(indices)) {
+			std::cout << "stripify changed the triangles or their winding" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// No packet may load more than the 10 matrices the hardware has room for, or use one it didn't load
+inline bool Unit_TestMatrixPalette()
+{
+	const std::vector<u32> indices = GridIndices(16);
+	std::vector<u32> vertexMatrices(16 * 16);
+	for (u32 v = 0; v < vertexMatrices.size(); ++v) {
+		vertexMatrices[v] = (v * 7919) % 25;
+	}
+
+	std::size_t triangles = 0;
+	for (const DListUtils::PalettePacket& packet : DListUtils::splitByMatrixPalette(indices, vertexMatrices, 10)) {
+		const auto& palette = packet.mMatrices;
+		bool loaded         = palette.size() <= 10;
+		for (const u32 index : packet.mIndices) {
+			loaded = loaded && std::find(palette.begin(), palette.end(), vertexMatrices[index]) != palette.end();
+		}
+		if (!loaded) {
+			std::cout << "A packet uses " << palette.size() << " matrix slots or a matrix it didn't load" << std::endl;
+			return false;
+		}
+		triangles += packet.mIndices.size() / 3;
+	}
+
+	return triangles == indices.size() / 3;
 }
 
 //
-inline void UnitTest(const std::string& path = "unit")
+inline void UnitTest(cmd::Session& session, const std::string& path = "unit")
 {
 	// Run some unit tests before we can allow the user to destroy their files
+	if (!Unit_TestDmdVertexLayouts(session)) {
+		throw std::runtime_error("DMD export test failed");
+	}
+	if (!Unit_TestListGeneratedChunks(session)) {
+		throw std::runtime_error("list_chunks test failed");
+	}
+	if (!Unit_TestLoadFromMemory(session)) {
+		throw std::runtime_error("Load from memory test failed");
+	}
+	if (!Unit_TestOverwriteMappedFile(session)) {
+		throw std::runtime_error("Mapped file test failed");
+	}
+	if (!Unit_TestTriangleVisitor()) {
+		throw std::runtime_error("Triangle visitor test failed");
+	}
+	if (!Unit_TestWelding()) {
+		throw std::runtime_error("Welding test failed");
+	}
+	if (!Unit_TestStripify()) {
+		throw std::runtime_error("Stripify test failed");
+	}
+	if (!Unit_TestDisplayListRoundTrip()) {
+		throw std::runtime_error("Display list round trip test failed");
+	}
+	if (!Unit_TestMatrixPalette()) {
+		throw std::runtime_error("Matrix palette test failed");
+	}
+
 	auto pathList = BuildUnitPathList(path);
 	for (const auto& p : pathList) {
-		if (!Unit_TestReadWrite(p) || !Unit_TestMaterialReadWrite(p) || !Unit_TestCollisionReadWrite(p)) {
+		if (!Unit_TestReadWrite(session, p) || !Unit_TestMaterialReadWrite(session, p) || !Unit_TestCollisionReadWrite(session, p)) {
 			std::cout << p << std::endl;
 			throw std::runtime_error("Fuck");
 		}
 	}
+
+	std::error_code ec;
+	fs::remove_all(ScratchPath(), ec);
 }
 } // namespace test
 
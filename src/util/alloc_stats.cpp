@@ -0,0 +1,132 @@
+#include "alloc_stats.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace util::alloc_stats {
+namespace {
+struct ThreadCounters {
+	u64 mAllocations    = 0;
+	u64 mAllocatedBytes = 0;
+	s64 mLiveBytes      = 0; // Goes negative on threads that free what another thread allocated
+	s64 mPeakBytes      = 0;
+};
+
+// Constant initialised, so operator new can use it before any constructor has run
+thread_local ThreadCounters tCounters;
+} // namespace
+
+void watch::start()
+{
+	mAllocations    = tCounters.mAllocations;
+	mAllocatedBytes = tCounters.mAllocatedBytes;
+	mLiveBytes      = tCounters.mLiveBytes;
+	mOuterPeak      = tCounters.mPeakBytes;
+
+	tCounters.mPeakBytes = tCounters.mLiveBytes;
+}
+
+usage watch::stop()
+{
+	usage result;
+	result.mAllocations    = tCounters.mAllocations - mAllocations;
+	result.mAllocatedBytes = tCounters.mAllocatedBytes - mAllocatedBytes;
+	result.mPeakBytes      = static_cast<u64>(std::max<s64>(tCounters.mPeakBytes - mLiveBytes, 0));
+	result.mRetainedBytes  = tCounters.mLiveBytes - mLiveBytes;
+
+	// Hand the peak back to any watch this one is nested in
+	tCounters.mPeakBytes = std::max(tCounters.mPeakBytes, mOuterPeak);
+	return result;
+}
+
+bool available()
+{
+#ifdef MODCONV_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+u64 peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+
+#ifdef __APPLE__
+	return static_cast<u64>(usage.ru_maxrss); // Already in bytes
+#else
+	return static_cast<u64>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace util::alloc_stats
+
+#ifdef MODCONV_TRACK_ALLOCATIONS
+
+// Every block starts with its requested size so operator delete knows how much is going away,
+// the header keeps the default new alignment
+static constexpr std::size_t gHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+// The standard routes the array and nothrow forms through these, so they are all that's needed
+void* operator new(std::size_t size)
+{
+	void* block = std::malloc(size + gHeaderSize);
+	while (block == nullptr) {
+		const std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr) {
+			throw std::bad_alloc();
+		}
+
+		handler();
+		block = std::malloc(size + gHeaderSize);
+	}
+
+	*static_cast<std::size_t*>(block) = size;
+
+	auto& counters = util::alloc_stats::tCounters;
+	counters.mAllocations++;
+	counters.mAllocatedBytes += size;
+	counters.mLiveBytes += static_cast<s64>(size);
+	counters.mPeakBytes = std::max(counters.mPeakBytes, counters.mLiveBytes);
+
+	return static_cast<char*>(block) + gHeaderSize;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr == nullptr) {
+		return;
+	}
+
+	void* block = static_cast<char*>(ptr) - gHeaderSize;
+	util::alloc_stats::tCounters.mLiveBytes -= static_cast<s64>(*static_cast<std::size_t*>(block));
+	std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept { ::operator delete(ptr); }
+
+#endif
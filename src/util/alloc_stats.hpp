@@ -0,0 +1,54 @@
+#ifndef UTIL_ALLOC_STATS_HPP
+#define UTIL_ALLOC_STATS_HPP
+
+#include "../types.hpp"
+
+/**
+ * @brief Heap allocation counting for --profile and list_chunks.
+ *
+ * Only builds configured with -DMODCONV_TRACK_ALLOCATIONS=ON replace the global operator new and
+ * delete; everywhere else available() is false and every count stays 0. Counts are kept per thread,
+ * so a watch sees the allocations made on the thread that started it and nothing else.
+ */
+namespace util::alloc_stats {
+
+/**
+ * @brief What a thread allocated between watch::start() and watch::stop().
+ */
+struct usage {
+	u64 mAllocations    = 0; // Calls to operator new
+	u64 mAllocatedBytes = 0; // Bytes requested by those calls, including ones freed again
+	u64 mPeakBytes      = 0; // Highest the thread's live heap got above where it started
+	s64 mRetainedBytes  = 0; // Live heap at the end minus at the start, negative if more was freed
+};
+
+/**
+ * @brief Measures the current thread's heap use over a stretch of code, watches can be nested.
+ */
+class watch {
+public:
+	void start();
+	usage stop();
+
+private:
+	u64 mAllocations    = 0;
+	u64 mAllocatedBytes = 0;
+	s64 mLiveBytes      = 0;
+	s64 mOuterPeak      = 0;
+};
+
+/**
+ * @brief Checks if this build counts allocations.
+ * @return True when built with MODCONV_TRACK_ALLOCATIONS.
+ */
+bool available();
+
+/**
+ * @brief Gets the most memory the process has had resident so far, as reported by the OS.
+ * @return The peak resident set size in bytes, 0 if the platform can't tell.
+ */
+u64 peakResidentBytes();
+
+} // namespace util::alloc_stats
+
+#endif
@@ -0,0 +1,169 @@
+#include "byteswap.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTIL_BYTESWAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(UTIL_BYTESWAP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define UTIL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UTIL_TARGET_AVX2
+#endif
+
+namespace util {
+namespace {
+
+using KernelFn = void (*)(u8*, std::size_t);
+
+struct Kernels {
+	KernelFn swap16;
+	KernelFn swap32;
+	const char* name;
+};
+
+// memcpy keeps the loads and stores legal for unaligned buffers, compilers fold it into a mov
+void scalarSwap16(u8* data, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, data += 2) {
+		u16 val;
+		std::memcpy(&val, data, 2);
+		val = byteswap(val);
+		std::memcpy(data, &val, 2);
+	}
+}
+
+void scalarSwap32(u8* data, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, data += 4) {
+		u32 val;
+		std::memcpy(&val, data, 4);
+		val = byteswap(val);
+		std::memcpy(data, &val, 4);
+	}
+}
+
+#ifdef UTIL_BYTESWAP_X86
+// SSE2 has no byte shuffle, so swap the bytes of each 16-bit lane with shifts and then (for 32-bit
+// words) exchange the two halves with the word shuffles
+inline __m128i sse2Swap16(__m128i v) { return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+
+void sse2Swap16(u8* data, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8, data += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data), sse2Swap16(v));
+	}
+
+	scalarSwap16(data, count - i);
+}
+
+void sse2Swap32(u8* data, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4, data += 16) {
+		__m128i v = sse2Swap16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+		v         = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v         = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data), v);
+	}
+
+	scalarSwap32(data, count - i);
+}
+
+UTIL_TARGET_AVX2 void avx2Swap(u8* data, std::size_t size, __m256i mask)
+{
+	std::size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_shuffle_epi8(a, mask));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), _mm256_shuffle_epi8(b, mask));
+	}
+
+	for (; i + 32 <= size; i += 32) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_shuffle_epi8(v, mask));
+	}
+}
+
+UTIL_TARGET_AVX2 void avx2Swap16(u8* data, std::size_t count)
+{
+	const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, //
+	                                      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	const std::size_t vectorCount = count & ~std::size_t(15);
+	avx2Swap(data, vectorCount * 2, mask);
+	scalarSwap16(data + vectorCount * 2, count - vectorCount);
+}
+
+UTIL_TARGET_AVX2 void avx2Swap32(u8* data, std::size_t count)
+{
+	const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, //
+	                                      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	const std::size_t vectorCount = count & ~std::size_t(7);
+	avx2Swap(data, vectorCount * 4, mask);
+	scalarSwap32(data + vectorCount * 4, count - vectorCount);
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4] {};
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+
+	// AVX2 also needs the OS to save the YMM registers on context switches
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx     = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+Kernels selectKernels()
+{
+#ifdef UTIL_BYTESWAP_X86
+	if (cpuHasAvx2()) {
+		return { avx2Swap16, avx2Swap32, "avx2" };
+	}
+
+	// SSE2 is part of the x86-64 baseline
+	return { sse2Swap16, sse2Swap32, "sse2" };
+#else
+	return { scalarSwap16, scalarSwap32, "scalar" };
+#endif
+}
+
+const Kernels& kernels()
+{
+	static const Kernels sKernels = selectKernels();
+	return sKernels;
+}
+
+} // namespace
+
+void byteswap16(void* data, std::size_t count) { kernels().swap16(static_cast<u8*>(data), count); }
+void byteswap32(void* data, std::size_t count) { kernels().swap32(static_cast<u8*>(data), count); }
+
+const char* byteswap_kernel_name() { return kernels().name; }
+
+} // namespace util
@@ -0,0 +1,61 @@
+#ifndef UTIL_BYTESWAP_HPP
+#define UTIL_BYTESWAP_HPP
+
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+#include "../types.hpp"
+
+namespace util {
+
+// Stand-in for C++23's std::byteswap, compilers lower the shifts to a single bswap/rev
+template <typename T>
+    requires std::is_unsigned_v<T>
+constexpr T byteswap(T val)
+{
+	if constexpr (sizeof(T) == 1) {
+		return val;
+	} else if constexpr (sizeof(T) == 2) {
+		return static_cast<T>((val << 8) | (val >> 8));
+	} else if constexpr (sizeof(T) == 4) {
+		return ((val & 0x000000FFu) << 24) | ((val & 0x0000FF00u) << 8) | ((val & 0x00FF0000u) >> 8) | ((val & 0xFF000000u) >> 24);
+	} else {
+		static_assert(sizeof(T) == 8, "unsupported integer width");
+		return (static_cast<T>(byteswap(static_cast<u32>(val))) << 32) | byteswap(static_cast<u32>(val >> 32));
+	}
+}
+
+static_assert(byteswap<u16>(0x1234) == 0x3412);
+static_assert(byteswap<u32>(0x12345678) == 0x78563412);
+static_assert(byteswap<u64>(0x0102030405060708) == 0x0807060504030201);
+
+/**
+ * @brief In-place byte swapping of whole arrays of 16/32-bit words.
+ *
+ * The kernel is picked once at runtime: AVX2 or SSE2 on x86 when the CPU supports it, a scalar
+ * loop everywhere else. Buffers don't need to be aligned and any trailing words are handled.
+ */
+void byteswap16(void* data, std::size_t count);
+void byteswap32(void* data, std::size_t count);
+
+// Name of the kernel byteswap16/32 dispatch to ("avx2", "sse2" or "scalar")
+const char* byteswap_kernel_name();
+
+// Converts an array of big-endian words to host order (and back), a no-op on big-endian hosts
+inline void swap_big_endian16(void* data, std::size_t count)
+{
+	if constexpr (std::endian::native == std::endian::little) {
+		byteswap16(data, count);
+	}
+}
+
+inline void swap_big_endian32(void* data, std::size_t count)
+{
+	if constexpr (std::endian::native == std::endian::little) {
+		byteswap32(data, count);
+	}
+}
+
+} // namespace util
+
+#endif
@@ -0,0 +1,133 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::filesystem::path& path)
+{
+	close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size {};
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileHandle = file;
+	m_size       = static_cast<std::size_t>(size.QuadPart);
+	m_isOpen     = true;
+
+	// Zero-length files can't be mapped, but are still valid (and empty)
+	if (m_size == 0) {
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+
+	m_mappingHandle = mapping;
+	m_data          = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void mapped_file::close()
+{
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mappingHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+	}
+	if (m_fileHandle != nullptr) {
+		CloseHandle(static_cast<HANDLE>(m_fileHandle));
+	}
+
+	m_data          = nullptr;
+	m_size          = 0;
+	m_isOpen        = false;
+	m_fileHandle    = nullptr;
+	m_mappingHandle = nullptr;
+}
+
+#else
+
+bool mapped_file::open(const std::filesystem::path& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st {};
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	m_size   = static_cast<std::size_t>(st.st_size);
+	m_isOpen = true;
+
+	// Zero-length files can't be mapped, but are still valid (and empty)
+	if (m_size != 0) {
+		void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			::close(fd);
+			m_size   = 0;
+			m_isOpen = false;
+			return false;
+		}
+
+		m_data = static_cast<const u8*>(mapping);
+		madvise(mapping, m_size, MADV_SEQUENTIAL);
+	}
+
+	// The mapping keeps its own reference to the file
+	::close(fd);
+	return true;
+}
+
+void mapped_file::close()
+{
+	if (m_data != nullptr) {
+		munmap(const_cast<u8*>(m_data), m_size);
+	}
+
+	m_data   = nullptr;
+	m_size   = 0;
+	m_isOpen = false;
+}
+
+#endif
+
+} // namespace util
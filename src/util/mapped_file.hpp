@@ -0,0 +1,45 @@
+#ifndef UTIL_MAPPED_FILE_HPP
+#define UTIL_MAPPED_FILE_HPP
+
+#include <filesystem>
+#include <span>
+#include "../types.hpp"
+
+namespace util {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * Only regular files can be mapped; open() returns false for pipes, character devices and
+ * anything else the OS refuses to map, so callers can fall back to util::fstream_reader.
+ */
+class mapped_file {
+public:
+	mapped_file() = default;
+	explicit mapped_file(const std::filesystem::path& path) { open(path); }
+	~mapped_file() { close(); }
+
+	mapped_file(const mapped_file&)            = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	bool open(const std::filesystem::path& path);
+	void close();
+
+	[[nodiscard]] bool is_open() const { return m_isOpen; }
+	[[nodiscard]] std::span<const u8> data() const { return { m_data, m_size }; }
+	[[nodiscard]] std::size_t size() const { return m_size; }
+
+private:
+	const u8* m_data   = nullptr;
+	std::size_t m_size = 0;
+	bool m_isOpen      = false;
+
+#ifdef _WIN32
+	void* m_fileHandle    = nullptr;
+	void* m_mappingHandle = nullptr;
+#endif
+};
+
+} // namespace util
+
+#endif
@@ -10,6 +10,7 @@
 #include <sstream>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include "../types.hpp"
 #include <vector>
 
@@ -79,6 +80,100 @@ inline u32 CalculateTxeSize(u32 format, u32 x, u32 y)
 	}
 }
 
+// Matches a '/' separated relative path against a glob pattern. '*' and '?' never cross a '/',
+// while '**/' matches any number of whole directories (including none)
+inline bool MatchesGlob(std::string_view pattern, std::string_view path)
+{
+	if (pattern.empty()) {
+		return path.empty();
+	}
+
+	if (pattern.starts_with("**")) {
+		std::string_view rest = pattern.substr(2);
+		if (rest.empty()) {
+			return true;
+		}
+
+		if (rest.front() == '/') {
+			rest.remove_prefix(1);
+		}
+
+		for (std::size_t i = 0; i <= path.size(); ++i) {
+			if ((i == 0 || path[i - 1] == '/') && MatchesGlob(rest, path.substr(i))) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	if (pattern.front() == '*') {
+		for (std::size_t i = 0; i <= path.size(); ++i) {
+			if (MatchesGlob(pattern.substr(1), path.substr(i))) {
+				return true;
+			}
+
+			if (i < path.size() && path[i] == '/') {
+				break;
+			}
+		}
+		return false;
+	}
+
+	if (path.empty() || (pattern.front() == '?' ? path.front() == '/' : pattern.front() != path.front())) {
+		return false;
+	}
+
+	return MatchesGlob(pattern.substr(1), path.substr(1));
+}
+
+// Lists the regular files matching a glob pattern such as "assets/**/*.mod", sorted by path
+inline std::vector<fs::path> ExpandGlob(const std::string& pattern)
+{
+	std::string generic = pattern;
+	std::replace(generic.begin(), generic.end(), '\\', '/');
+
+	// Everything up to the last directory without wildcards is a plain path to start the search from
+	const std::size_t wildcard = generic.find_first_of("*?");
+	if (wildcard == std::string::npos) {
+		return fs::is_regular_file(generic) ? std::vector<fs::path> { generic } : std::vector<fs::path> {};
+	}
+
+	const std::size_t split = generic.rfind('/', wildcard);
+	const std::string base  = split == std::string::npos ? "" : generic.substr(0, split + 1);
+	const std::string rest  = generic.substr(base.size());
+
+	std::error_code ec;
+	const fs::path root = base.empty() ? fs::path(".") : fs::path(base);
+	if (!fs::is_directory(root, ec)) {
+		return {};
+	}
+
+	std::vector<fs::path> matches;
+	auto visit = [&](const fs::directory_entry& entry) {
+		if (!entry.is_regular_file(ec)) {
+			return;
+		}
+
+		const std::string relative = entry.path().lexically_relative(root).generic_string();
+		if (MatchesGlob(rest, relative)) {
+			matches.push_back(fs::path(base) / relative);
+		}
+	};
+
+	if (rest.find('/') == std::string::npos && rest.find("**") == std::string::npos) {
+		for (const auto& entry : fs::directory_iterator(root, fs::directory_options::skip_permission_denied, ec)) {
+			visit(entry);
+		}
+	} else {
+		for (const auto& entry : fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec)) {
+			visit(entry);
+		}
+	}
+
+	std::sort(matches.begin(), matches.end());
+	return matches;
+}
+
 } // namespace util
 
 #endif
\ No newline at end of file
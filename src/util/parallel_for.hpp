@@ -0,0 +1,78 @@
+#ifndef UTIL_PARALLEL_FOR_HPP
+#define UTIL_PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// Number of threads to use for a requested job count, 0 meaning one per hardware thread
+inline unsigned resolve_jobs(unsigned jobs)
+{
+	if (jobs == 0) {
+		jobs = std::thread::hardware_concurrency();
+	}
+
+	return std::max(jobs, 1u);
+}
+
+/**
+ * @brief Runs fn(i) for every i in [0, count) on up to `jobs` threads, the calling thread included.
+ *
+ * Indices are handed out one at a time from a shared counter, so a few large tasks don't leave the
+ * other threads idle. The first exception thrown by fn stops any further indices from being handed
+ * out and is rethrown on the calling thread once every worker has finished.
+ */
+template <typename Fn>
+void parallel_for(std::size_t count, unsigned jobs, Fn&& fn)
+{
+	const std::size_t threadCount = std::min<std::size_t>(resolve_jobs(jobs), count);
+	if (threadCount <= 1) {
+		for (std::size_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<std::size_t> cursor { 0 };
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto worker = [&]() {
+		for (std::size_t i = cursor++; i < count; i = cursor++) {
+			try {
+				fn(i);
+			} catch (...) {
+				const std::lock_guard lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+				cursor = count;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (std::size_t i = 1; i < threadCount; ++i) {
+		threads.emplace_back(worker);
+	}
+
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+} // namespace util
+
+#endif
@@ -0,0 +1,278 @@
+#include "profiler.hpp"
+#include "text_serializer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util::profiler {
+namespace {
+struct Totals {
+	u64 mCalls          = 0;
+	double mSeconds     = 0;
+	u64 mBytes          = 0;
+	u64 mElements       = 0;
+	u64 mAllocations    = 0;
+	u64 mAllocatedBytes = 0;
+	u64 mPeakHeap       = 0; // Highest of any single call
+	s64 mRetainedBytes  = 0;
+};
+
+struct Entry {
+	std::string mCategory;
+	std::string mName;
+	Totals mTotals;
+};
+
+struct TraceEvent {
+	std::string mCategory;
+	std::string mName;
+	u32 mThread      = 0;
+	double mStart    = 0; // Microseconds since enableTrace()
+	double mDuration = 0;
+	u64 mBytes       = 0;
+	u64 mElements    = 0;
+	alloc_stats::usage mHeap;
+};
+
+std::atomic<bool> gEnabled { false };
+std::atomic<bool> gTracing { false };
+std::mutex gMutex;
+std::map<std::pair<std::string, std::string>, Totals> gTotals;
+std::vector<std::string> gCategoryOrder; // Categories in the order they were first recorded
+
+std::chrono::steady_clock::time_point gTraceStart;
+std::vector<TraceEvent> gTraceEvents;
+std::map<std::thread::id, u32> gThreadIds; // Small numbers for the trace viewer, the main thread is 0
+
+u32 threadIdLocked()
+{
+	return gThreadIds.try_emplace(std::this_thread::get_id(), static_cast<u32>(gThreadIds.size())).first->second;
+}
+
+// Every sample, grouped by category in recording order with the slowest first
+std::vector<Entry> collect()
+{
+	const std::lock_guard lock(gMutex);
+
+	std::vector<Entry> entries;
+	for (const auto& [key, totals] : gTotals) {
+		entries.push_back({ key.first, key.second, totals });
+	}
+
+	auto categoryRank = [](const std::string& category) {
+		return std::find(gCategoryOrder.begin(), gCategoryOrder.end(), category) - gCategoryOrder.begin();
+	};
+
+	std::stable_sort(entries.begin(), entries.end(), [&](const Entry& a, const Entry& b) {
+		if (a.mCategory != b.mCategory) {
+			return categoryRank(a.mCategory) < categoryRank(b.mCategory);
+		}
+		return a.mTotals.mSeconds > b.mTotals.mSeconds;
+	});
+
+	return entries;
+}
+} // namespace
+
+void enable() { gEnabled = true; }
+bool enabled() { return gEnabled.load(std::memory_order_relaxed); }
+
+void enableTrace()
+{
+	{
+		const std::lock_guard lock(gMutex);
+		gTraceStart = std::chrono::steady_clock::now();
+		threadIdLocked();
+	}
+
+	gTracing = true;
+	gEnabled = true;
+}
+
+bool tracing() { return gTracing.load(std::memory_order_relaxed); }
+
+void record(std::string_view category, std::string_view name, double seconds, u64 bytes, u64 elements, const alloc_stats::usage& heap)
+{
+	const std::lock_guard lock(gMutex);
+
+	if (std::find(gCategoryOrder.begin(), gCategoryOrder.end(), category) == gCategoryOrder.end()) {
+		gCategoryOrder.emplace_back(category);
+	}
+
+	Totals& totals = gTotals[{ std::string(category), std::string(name) }];
+	totals.mCalls++;
+	totals.mSeconds += seconds;
+	totals.mBytes += bytes;
+	totals.mElements += elements;
+	totals.mAllocations += heap.mAllocations;
+	totals.mAllocatedBytes += heap.mAllocatedBytes;
+	totals.mPeakHeap = std::max(totals.mPeakHeap, heap.mPeakBytes);
+	totals.mRetainedBytes += heap.mRetainedBytes;
+}
+
+void trace(std::string_view category, std::string_view name, std::chrono::steady_clock::time_point start,
+           std::chrono::steady_clock::time_point end, u64 bytes, u64 elements, const alloc_stats::usage& heap)
+{
+	if (!tracing()) {
+		return;
+	}
+
+	using Microseconds = std::chrono::duration<double, std::micro>;
+
+	const std::lock_guard lock(gMutex);
+	gTraceEvents.push_back({ std::string(category), std::string(name), threadIdLocked(), Microseconds(start - gTraceStart).count(),
+	                         Microseconds(end - start).count(), bytes, elements, heap });
+}
+
+void printTable(std::ostream& out)
+{
+	const std::vector<Entry> entries = collect();
+	if (entries.empty()) {
+		return;
+	}
+
+	const std::ios_base::fmtflags flags = out.flags();
+	const std::streamsize precision     = out.precision();
+	const bool heapColumns              = alloc_stats::available();
+
+	out << "\n--- Profile ---\n";
+	out << std::left << std::setw(10) << "Category" << std::setw(36) << "Name" << std::right << std::setw(8) << "Calls" << std::setw(12)
+	    << "Total ms" << std::setw(14) << "Bytes" << std::setw(10) << "MB/s" << std::setw(12) << "Elements" << std::setw(14) << "Elements/s";
+	if (heapColumns) {
+		out << std::setw(12) << "Allocs" << std::setw(12) << "Alloc KB" << std::setw(12) << "Peak KB" << std::setw(12) << "Kept KB"
+		    << std::setw(10) << "Kept/B";
+	}
+	out << '\n';
+
+	for (const Entry& entry : entries) {
+		const Totals& totals = entry.mTotals;
+		out << std::left << std::setw(10) << entry.mCategory << std::setw(36) << entry.mName.substr(0, 35) << std::right << std::setw(8)
+		    << totals.mCalls << std::fixed << std::setprecision(3) << std::setw(12) << totals.mSeconds * 1000.0;
+
+		if (totals.mBytes != 0) {
+			out << std::setw(14) << totals.mBytes << std::setprecision(1) << std::setw(10)
+			    << (totals.mSeconds > 0 ? totals.mBytes / totals.mSeconds / (1024.0 * 1024.0) : 0.0);
+		} else {
+			out << std::setw(14) << "-" << std::setw(10) << "-";
+		}
+
+		if (totals.mElements != 0) {
+			out << std::setw(12) << totals.mElements << std::setprecision(0) << std::setw(14)
+			    << (totals.mSeconds > 0 ? totals.mElements / totals.mSeconds : 0.0);
+		} else {
+			out << std::setw(12) << "-" << std::setw(14) << "-";
+		}
+
+		// Kept/B is the heap a chunk still holds per byte it took up in the file
+		if (heapColumns) {
+			out << std::setprecision(1) << std::setw(12) << totals.mAllocations << std::setw(12) << totals.mAllocatedBytes / 1024.0
+			    << std::setw(12) << totals.mPeakHeap / 1024.0 << std::setw(12) << totals.mRetainedBytes / 1024.0;
+			if (totals.mBytes != 0) {
+				out << std::setprecision(2) << std::setw(10) << static_cast<double>(totals.mRetainedBytes) / totals.mBytes;
+			} else {
+				out << std::setw(10) << "-";
+			}
+		}
+
+		out << '\n';
+	}
+
+	out << "Peak resident memory: " << std::setprecision(1) << alloc_stats::peakResidentBytes() / (1024.0 * 1024.0) << " MB";
+	if (!heapColumns) {
+		out << " (configure with -DMODCONV_TRACK_ALLOCATIONS=ON to count allocations)";
+	}
+	out << '\n';
+
+	out.flags(flags);
+	out.precision(precision);
+	out.flush();
+}
+
+void printJson(std::ostream& out)
+{
+	serialization::JsonTextSerializer serializer(out);
+	serializer.beginDocument();
+	serializer.beginArray("entries");
+	for (const Entry& entry : collect()) {
+		serializer.beginObject("");
+		serializer.write("category", entry.mCategory);
+		serializer.write("name", entry.mName);
+		serializer.write("calls", static_cast<int64_t>(entry.mTotals.mCalls));
+		serializer.write("seconds", entry.mTotals.mSeconds);
+		serializer.write("bytes", static_cast<int64_t>(entry.mTotals.mBytes));
+		serializer.write("elements", static_cast<int64_t>(entry.mTotals.mElements));
+		if (alloc_stats::available()) {
+			serializer.write("allocations", static_cast<int64_t>(entry.mTotals.mAllocations));
+			serializer.write("allocated_bytes", static_cast<int64_t>(entry.mTotals.mAllocatedBytes));
+			serializer.write("peak_heap_bytes", static_cast<int64_t>(entry.mTotals.mPeakHeap));
+			serializer.write("retained_bytes", static_cast<int64_t>(entry.mTotals.mRetainedBytes));
+		}
+		serializer.endObject();
+	}
+	serializer.endArray();
+	serializer.write("peak_resident_bytes", static_cast<int64_t>(alloc_stats::peakResidentBytes()));
+	serializer.endDocument();
+}
+
+void printTrace(std::ostream& out)
+{
+	std::vector<TraceEvent> events;
+	u32 threadCount = 0;
+	{
+		const std::lock_guard lock(gMutex);
+		events      = gTraceEvents;
+		threadCount = static_cast<u32>(gThreadIds.size());
+	}
+
+	// Complete ("X") events nest by time on each thread, so the viewer needs no begin/end pairs
+	serialization::JsonTextSerializer serializer(out, true);
+	serializer.beginDocument();
+	serializer.write("displayTimeUnit", std::string("ms"));
+	serializer.beginArray("traceEvents");
+
+	for (u32 thread = 0; thread < threadCount; ++thread) {
+		serializer.beginObject("");
+		serializer.write("name", std::string("thread_name"));
+		serializer.write("ph", std::string("M"));
+		serializer.write("pid", 1);
+		serializer.write("tid", static_cast<int64_t>(thread));
+		serializer.beginObject("args");
+		serializer.write("name", thread == 0 ? std::string("main") : "worker " + std::to_string(thread));
+		serializer.endObject();
+		serializer.endObject();
+	}
+
+	for (const TraceEvent& event : events) {
+		serializer.beginObject("");
+		serializer.write("name", event.mName);
+		serializer.write("cat", event.mCategory);
+		serializer.write("ph", std::string("X"));
+		serializer.write("ts", event.mStart);
+		serializer.write("dur", event.mDuration);
+		serializer.write("pid", 1);
+		serializer.write("tid", static_cast<int64_t>(event.mThread));
+		if (event.mBytes != 0 || event.mElements != 0 || event.mHeap.mAllocations != 0) {
+			serializer.beginObject("args");
+			serializer.write("bytes", static_cast<int64_t>(event.mBytes));
+			serializer.write("elements", static_cast<int64_t>(event.mElements));
+			if (event.mHeap.mAllocations != 0) {
+				serializer.write("allocations", static_cast<int64_t>(event.mHeap.mAllocations));
+				serializer.write("allocated_bytes", static_cast<int64_t>(event.mHeap.mAllocatedBytes));
+				serializer.write("retained_bytes", event.mHeap.mRetainedBytes);
+			}
+			serializer.endObject();
+		}
+		serializer.endObject();
+	}
+
+	serializer.endArray();
+	serializer.endDocument();
+}
+
+} // namespace util::profiler
@@ -0,0 +1,123 @@
+#ifndef UTIL_PROFILER_HPP
+#define UTIL_PROFILER_HPP
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include "../types.hpp"
+#include "alloc_stats.hpp"
+
+/**
+ * @brief Process-wide timing of read/write phases, chunks and commands for --profile and --trace.
+ *
+ * Recording is off until enable() or enableTrace() is called, so the scopes sprinkled through the code
+ * only cost a flag check. Samples with the same category and name are summed; samples taken on several
+ * threads at once each count their own wall time, so a category can add up to more than the phase around it.
+ * With tracing on every scope is also kept as its own event, tagged with the thread it ran on.
+ * Builds that track allocations also report the heap each scope used on its own thread.
+ */
+namespace util::profiler {
+
+void enable();
+bool enabled();
+
+/**
+ * @brief Starts keeping every scope as a trace event, timestamps count from this call.
+ *
+ * The calling thread is reported as the main thread, every other thread gets a worker number
+ * in the order it first records something.
+ */
+void enableTrace();
+bool tracing();
+
+/**
+ * @brief Adds a sample to the profile. Safe to call from any thread.
+ * @param category The group the sample is reported under, e.g. "decode" or "command".
+ * @param name What was measured, e.g. "0x30 Materials" or "export_obj".
+ * @param seconds The wall time it took.
+ * @param bytes The bytes it read or wrote, 0 if that doesn't apply.
+ * @param elements The elements it processed (vertices, materials, triangles...), 0 if that doesn't apply.
+ * @param heap The heap it used, all 0 when allocations aren't tracked.
+ */
+void record(std::string_view category, std::string_view name, double seconds, u64 bytes = 0, u64 elements = 0,
+            const alloc_stats::usage& heap = {});
+
+/**
+ * @brief Adds a span to the trace, does nothing unless tracing is enabled. Safe to call from any thread.
+ * @param category The group the span is shown under, e.g. "decode" or "command".
+ * @param name What ran, e.g. "0x30 Materials" or "export_obj".
+ * @param start When it started.
+ * @param end When it finished.
+ * @param bytes The bytes it read or wrote, 0 if that doesn't apply.
+ * @param elements The elements it processed, 0 if that doesn't apply.
+ * @param heap The heap it used, all 0 when allocations aren't tracked.
+ */
+void trace(std::string_view category, std::string_view name, std::chrono::steady_clock::time_point start,
+           std::chrono::steady_clock::time_point end, u64 bytes = 0, u64 elements = 0, const alloc_stats::usage& heap = {});
+
+/**
+ * @brief Prints every sample as a table, grouped by category with the slowest first, followed by the peak resident memory.
+ * @param out The stream to print to.
+ */
+void printTable(std::ostream& out);
+
+/**
+ * @brief Writes every sample as a JSON document with an "entries" array.
+ * @param out The stream to write to.
+ */
+void printJson(std::ostream& out);
+
+/**
+ * @brief Writes the trace events in the Chrome trace event format, for about://tracing and Perfetto.
+ * @param out The stream to write to.
+ */
+void printTrace(std::ostream& out);
+
+/**
+ * @brief Times the rest of the enclosing block and records it on destruction if profiling is enabled.
+ */
+class scope {
+public:
+	scope(std::string_view category, std::string name)
+	    : mCategory(category)
+	    , mName(enabled() ? std::move(name) : std::string())
+	    , mActive(enabled())
+	{
+		if (mActive) {
+			mHeap.start();
+			mStart = std::chrono::steady_clock::now();
+		}
+	}
+
+	~scope()
+	{
+		if (mActive) {
+			const auto end                = std::chrono::steady_clock::now();
+			const alloc_stats::usage heap = mHeap.stop();
+			record(mCategory, mName, std::chrono::duration<double>(end - mStart).count(), mBytes, mElements, heap);
+			trace(mCategory, mName, mStart, end, mBytes, mElements, heap);
+		}
+	}
+
+	scope(const scope&)            = delete;
+	scope& operator=(const scope&) = delete;
+
+	[[nodiscard]] bool active() const { return mActive; }
+
+	void setBytes(u64 bytes) { mBytes = bytes; }
+	void setElements(u64 elements) { mElements = elements; }
+
+private:
+	std::string_view mCategory;
+	std::string mName;
+	bool mActive  = false;
+	u64 mBytes    = 0;
+	u64 mElements = 0;
+	std::chrono::steady_clock::time_point mStart;
+	alloc_stats::watch mHeap;
+};
+
+} // namespace util::profiler
+
+#endif
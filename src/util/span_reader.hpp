@@ -0,0 +1,162 @@
+#ifndef UTIL_SPAN_READER_HPP
+#define UTIL_SPAN_READER_HPP
+
+#include <bit>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "../types.hpp"
+#include "byteswap.hpp"
+
+namespace util {
+
+/**
+ * @brief Reader over a contiguous block of memory, with the byte order fixed at compile time.
+ *
+ * Every read is bounds-checked against the underlying span and throws std::out_of_range
+ * on an overrun, so truncated or corrupt files fail loudly instead of yielding zeroes.
+ * Multi-byte values are a single unaligned load plus a byteswap when E differs from the host,
+ * there is no per-read endianness branch. The reader does not own the memory it reads from.
+ */
+template <std::endian E>
+class basic_span_reader {
+public:
+	basic_span_reader() = default;
+	explicit basic_span_reader(std::span<const u8> bytes, std::size_t position = 0)
+	    : m_buffer(bytes)
+	{
+		setPosition(position);
+	}
+	~basic_span_reader()                                   = default;
+	basic_span_reader(const basic_span_reader&)            = delete;
+	basic_span_reader& operator=(const basic_span_reader&) = delete;
+
+	[[nodiscard]] std::span<const u8> getBuffer() const { return m_buffer; }
+	[[nodiscard]] std::size_t getSize() const { return m_buffer.size(); }
+	[[nodiscard]] std::size_t getRemaining() const { return m_buffer.size() - m_position; }
+	[[nodiscard]] std::size_t getPosition() const { return m_position; }
+
+	void setPosition(std::size_t position)
+	{
+		if (position > m_buffer.size()) {
+			throw std::out_of_range("span_reader: position " + std::to_string(position) + " is past the end of the buffer ("
+			                        + std::to_string(m_buffer.size()) + " bytes)");
+		}
+		m_position = position;
+	}
+
+	void skip(std::size_t amt) { take(amt); }
+
+	void align(std::size_t amt = cfg::MOD_ALIGNMENT_AMT)
+	{
+		if (amt == 0) {
+			return;
+		}
+
+		const std::size_t offs = m_position % amt;
+		if (offs != 0) {
+			skip(amt - offs);
+		}
+	}
+
+	// Decodes a T stored in E byte order at `data`, without any bounds checking. Meant for
+	// records that were fetched in one go with readSpan()
+	template <typename T>
+	[[nodiscard]] static T load(const u8* data)
+	{
+		static_assert(std::is_arithmetic_v<T>, "only plain numbers can be loaded");
+
+		using Word = std::conditional_t<sizeof(T) == 1, u8, std::conditional_t<sizeof(T) == 2, u16, std::conditional_t<sizeof(T) == 4, u32, u64>>>;
+		Word word;
+		std::memcpy(&word, data, sizeof(T));
+		if constexpr (E != std::endian::native) {
+			word = byteswap(word);
+		}
+		return std::bit_cast<T>(word);
+	}
+
+	template <typename T>
+	T read()
+	{
+		return load<T>(take(sizeof(T)));
+	}
+
+	// Reads `count` consecutive values with a single bounds check
+	template <typename T>
+	void readN(T* buffer, std::size_t count)
+	{
+		static_assert(std::is_arithmetic_v<T>, "only plain numbers can be read in bulk");
+
+		if constexpr (sizeof(T) == 2) {
+			read_array16(buffer, count);
+		} else if constexpr (sizeof(T) == 4) {
+			read_array32(buffer, count);
+		} else {
+			const u8* data = take(count * sizeof(T));
+			for (std::size_t i = 0; i < count; ++i) {
+				buffer[i] = load<T>(data + i * sizeof(T));
+			}
+		}
+	}
+
+	// Returns a view of the next `size` bytes without copying them
+	std::span<const u8> readSpan(std::size_t size) { return { take(size), size }; }
+	void read_buffer(void* buffer, std::size_t size)
+	{
+		if (size != 0) {
+			std::memcpy(buffer, take(size), size);
+		}
+	}
+
+	// Bulk reads of `count` words straight into host-order storage
+	void read_array16(void* buffer, std::size_t count)
+	{
+		read_buffer(buffer, count * 2);
+		if constexpr (E != std::endian::native) {
+			byteswap16(buffer, count);
+		}
+	}
+	void read_array32(void* buffer, std::size_t count)
+	{
+		read_buffer(buffer, count * 4);
+		if constexpr (E != std::endian::native) {
+			byteswap32(buffer, count);
+		}
+	}
+
+	u8 readU8() { return *take(1); }
+	u16 readU16() { return read<u16>(); }
+	u32 readU32() { return read<u32>(); }
+
+	s8 readS8() { return read<s8>(); }
+	s16 readS16() { return read<s16>(); }
+	s32 readS32() { return read<s32>(); }
+
+	f32 readF32() { return read<f32>(); }
+
+private:
+	const u8* take(std::size_t size)
+	{
+		if (size > getRemaining()) {
+			throw std::out_of_range("span_reader: tried to read " + std::to_string(size) + " bytes at offset " + std::to_string(m_position)
+			                        + ", only " + std::to_string(getRemaining()) + " remain");
+		}
+
+		const u8* data = m_buffer.data() + m_position;
+		m_position += size;
+		return data;
+	}
+
+	std::span<const u8> m_buffer;
+	std::size_t m_position = 0;
+};
+
+// MOD files and the display lists inside them are big-endian (GameCube)
+using span_reader    = basic_span_reader<std::endian::big>;
+using span_reader_le = basic_span_reader<std::endian::little>;
+
+} // namespace util
+
+#endif
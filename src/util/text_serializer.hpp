@@ -4,9 +4,11 @@
 #pragma once
 
 #include "serialization_base.hpp"
+#include "text_writer.hpp"
 #include "../types.hpp"
 #include <fstream>
 #include <stack>
+#include <string_view>
 #include <algorithm>
 #include <cctype>
 #include <utility>
@@ -15,12 +17,18 @@
 namespace serialization {
 class JsonTextSerializer : public ISerializer {
 private:
-	std::ostream& m_out;
+	std::ostream& m_stream;
+	util::text_writer m_out;
+	bool m_compact    = false; // Everything on one line, for line-delimited protocols
 	int m_indentLevel = 0;
 	std::stack<bool> m_needsComma; // Tracks if a comma is needed before the next element.
 
+	const char* newline() const { return m_compact ? "" : "\n"; }
+
 	void indent()
 	{
+		if (m_compact)
+			return;
 		for (int i = 0; i < m_indentLevel; ++i)
 			m_out << "    ";
 	}
@@ -30,9 +38,9 @@ private:
 		if (m_needsComma.empty())
 			return;
 		if (m_needsComma.top()) {
-			m_out << ",\n";
+			m_out << "," << newline();
 		} else {
-			m_out << "\n";
+			m_out << newline();
 			m_needsComma.top() = true;
 		}
 	}
@@ -42,65 +50,79 @@ private:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(key) << "\": " << value;
+		writeString(key);
+		m_out << ": " << value;
 	}
 
-	// Helper function to escape JSON strings
-	std::string escapeString(const std::string& str)
+	// Writes a quoted JSON string, the runs between characters that need escaping are copied in one go
+	void writeString(std::string_view str)
 	{
-		std::string escaped;
-		for (char c : str) {
+		static constexpr char HexDigits[] = "0123456789abcdef";
+
+		m_out << '"';
+		std::size_t runStart = 0;
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			const char c       = str[i];
+			const char* escape = nullptr;
 			switch (c) {
 			case '"':
-				escaped += "\\\"";
+				escape = "\\\"";
 				break;
 			case '\\':
-				escaped += "\\\\";
+				escape = "\\\\";
 				break;
 			case '\b':
-				escaped += "\\b";
+				escape = "\\b";
 				break;
 			case '\f':
-				escaped += "\\f";
+				escape = "\\f";
 				break;
 			case '\n':
-				escaped += "\\n";
+				escape = "\\n";
 				break;
 			case '\r':
-				escaped += "\\r";
+				escape = "\\r";
 				break;
 			case '\t':
-				escaped += "\\t";
+				escape = "\\t";
 				break;
 			default:
 				if (c >= 0 && c < 32) {
-					escaped += "\\u" + std::to_string(static_cast<int>(c));
-				} else {
-					escaped += c;
+					break;
 				}
-				break;
+				continue;
+			}
+
+			m_out << str.substr(runStart, i - runStart);
+			if (escape != nullptr) {
+				m_out << escape;
+			} else {
+				m_out << "\\u00" << HexDigits[c >> 4] << HexDigits[c & 0xF];
 			}
+			runStart = i + 1;
 		}
-		return escaped;
+		m_out << str.substr(runStart) << '"';
 	}
 
 public:
-	explicit JsonTextSerializer(std::ostream& out)
-	    : m_out(out)
+	explicit JsonTextSerializer(std::ostream& out, bool compact = false)
+	    : m_stream(out)
+	    , m_out(out)
+	    , m_compact(compact)
 	{
-		m_out << std::setprecision(std::numeric_limits<double>::max_digits10);
 	}
 
 	void beginDocument() override
 	{
-		m_out << "{\n";
+		m_out << "{" << newline();
 		m_indentLevel++;
 		m_needsComma.push(false);
 	}
 	void endDocument() override
 	{
-		m_out << "\n}\n";
+		m_out << newline() << "}\n";
 		m_out.flush();
+		m_stream.flush();
 	}
 
 	void beginObject(const std::string& name = "") override
@@ -108,7 +130,8 @@ public:
 		writeElementSeparator();
 		indent();
 		if (!name.empty()) {
-			m_out << "\"" << escapeString(name) << "\": {";
+			writeString(name);
+			m_out << ": {";
 		} else {
 			m_out << "{";
 		}
@@ -119,7 +142,7 @@ public:
 	void endObject() override
 	{
 		m_indentLevel--;
-		m_out << "\n";
+		m_out << newline();
 		indent();
 		m_out << "}";
 		m_needsComma.pop();
@@ -129,7 +152,8 @@ public:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(name) << "\": [";
+		writeString(name);
+		m_out << ": [";
 		m_indentLevel++;
 		m_needsComma.push(false);
 	}
@@ -137,7 +161,7 @@ public:
 	void endArray() override
 	{
 		m_indentLevel--;
-		m_out << "\n";
+		m_out << newline();
 		indent();
 		m_out << "]";
 		m_needsComma.pop();
@@ -151,7 +175,8 @@ public:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(key) << "\": ";
+		writeString(key);
+		m_out << ": ";
 
 		if (value == 0.0f && std::signbit(value)) {
 			m_out << "-0.0"; // Explicit string for negative zero
@@ -165,7 +190,8 @@ public:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(key) << "\": ";
+		writeString(key);
+		m_out << ": ";
 
 		if (value == 0.0f && std::signbit(value)) {
 			m_out << "-0.0"; // Explicit string for negative zero
@@ -179,7 +205,9 @@ public:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(key) << "\": \"" << escapeString(value) << "\"";
+		writeString(key);
+		m_out << ": ";
+		writeString(value);
 	}
 
 	void writeValue(bool value) override
@@ -216,7 +244,7 @@ public:
 	{
 		writeElementSeparator();
 		indent();
-		m_out << "\"" << escapeString(value) << "\"";
+		writeString(value);
 	}
 
 	void writeComment(const std::string& comment) override
@@ -0,0 +1,128 @@
+#ifndef UTIL_TEXT_WRITER_HPP
+#define UTIL_TEXT_WRITER_HPP
+
+#include <charconv>
+#include <concepts>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "../types.hpp"
+
+namespace util {
+
+/**
+ * @brief Text counterpart of vector_writer, formats numbers with std::to_chars into a reusable buffer.
+ *
+ * Bound to a stream, the buffer is handed over in blocks of at least blockSize bytes and the memory is kept
+ * for the next block. Without a stream everything stays in memory until takeBuffer(), for text that is
+ * formatted on one thread and written out on another. Unlike an ostream there are no locales or flags to
+ * go through, integers are always decimal and char types are written as characters.
+ */
+class text_writer {
+public:
+	static constexpr std::size_t DefaultBlockSize = 1 << 16;
+
+	text_writer() = default;
+	explicit text_writer(std::ostream& out, std::size_t blockSize = DefaultBlockSize)
+	    : m_out(&out)
+	    , m_blockSize(blockSize)
+	{
+		m_buffer.reserve(blockSize + MaxNumberLength);
+	}
+	~text_writer() { flush(); }
+	text_writer(const text_writer&)            = delete;
+	text_writer& operator=(const text_writer&) = delete;
+
+	[[nodiscard]] std::string takeBuffer() { return std::move(m_buffer); }
+	[[nodiscard]] std::size_t getSize() const { return m_buffer.size(); }
+
+	// Hands whatever is buffered to the stream, a no-op for writers without one
+	void flush()
+	{
+		if (m_out != nullptr && !m_buffer.empty()) {
+			m_out->write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_buffer.clear();
+		}
+	}
+
+	// Floats are written in the shortest form that reads back to the same value, until a fixed or
+	// general (printf's %f and %g) format with a number of digits is set
+	void setFloatFormat(std::chars_format format, int precision)
+	{
+		if (precision < 0 || precision > MaxPrecision) {
+			throw std::out_of_range("text_writer: float precision must be between 0 and " + std::to_string(MaxPrecision));
+		}
+
+		m_floatFormat = format;
+		m_precision   = precision;
+	}
+	void setShortestFloats() { m_precision = -1; }
+
+	text_writer& operator<<(std::string_view text)
+	{
+		m_buffer.append(text);
+		return maybeFlush();
+	}
+	text_writer& operator<<(char c)
+	{
+		m_buffer.push_back(c);
+		return maybeFlush();
+	}
+
+	template <std::integral T>
+	    requires(!std::same_as<T, bool> && !std::same_as<T, char>)
+	text_writer& operator<<(T value)
+	{
+		char digits[MaxNumberLength];
+		return append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+	}
+
+	text_writer& operator<<(f32 value) { return writeFloat(value); }
+	text_writer& operator<<(f64 value) { return writeFloat(value); }
+
+	text_writer& writeHex(u64 value)
+	{
+		char digits[MaxNumberLength];
+		return append(digits, std::to_chars(digits, digits + sizeof(digits), value, 16).ptr);
+	}
+
+private:
+	// Room for a fixed double at the largest precision, 309 digits before the point
+	static constexpr int MaxPrecision            = 100;
+	static constexpr std::size_t MaxNumberLength = 512;
+
+	template <typename T>
+	text_writer& writeFloat(T value)
+	{
+		char digits[MaxNumberLength];
+		const char* end = m_precision < 0 ? std::to_chars(digits, digits + sizeof(digits), value).ptr
+		                                  : std::to_chars(digits, digits + sizeof(digits), value, m_floatFormat, m_precision).ptr;
+		return append(digits, end);
+	}
+
+	text_writer& append(const char* begin, const char* end)
+	{
+		m_buffer.append(begin, end);
+		return maybeFlush();
+	}
+
+	text_writer& maybeFlush()
+	{
+		if (m_out != nullptr && m_buffer.size() >= m_blockSize) {
+			flush();
+		}
+		return *this;
+	}
+
+	std::ostream* m_out     = nullptr;
+	std::size_t m_blockSize = DefaultBlockSize;
+	std::string m_buffer;
+	std::chars_format m_floatFormat = std::chars_format::general;
+	int m_precision                 = -1;
+};
+
+} // namespace util
+
+#endif
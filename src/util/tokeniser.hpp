@@ -52,6 +52,13 @@ public:
 		m_tokenList.shrink_to_fit();
 	}
 
+	// Uses already split tokens as is, so they may contain whitespace or quotes
+	void assign(std::vector<std::string> tokens)
+	{
+		m_tokenIdx  = 0;
+		m_tokenList = std::move(tokens);
+	}
+
 	[[nodiscard]] bool atWhiteSpace() const
 	{
 		if (isEnd()) {
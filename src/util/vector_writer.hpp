@@ -0,0 +1,121 @@
+#ifndef UTIL_VECTOR_WRITER_HPP
+#define UTIL_VECTOR_WRITER_HPP
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "../types.hpp"
+#include "byteswap.hpp"
+
+namespace util {
+
+/**
+ * @brief Big-endian writer that serializes into a growable, contiguous buffer.
+ *
+ * Nothing touches the disk until the caller flushes getBuffer() in one go, which also means the
+ * output never has to be seekable: chunk lengths are patched in memory with patchU32().
+ */
+class vector_writer {
+public:
+	vector_writer()                                = default;
+	~vector_writer()                               = default;
+	vector_writer(const vector_writer&)            = delete;
+	vector_writer& operator=(const vector_writer&) = delete;
+
+	[[nodiscard]] const std::vector<u8>& getBuffer() const { return m_buffer; }
+	[[nodiscard]] std::vector<u8> takeBuffer() { return std::move(m_buffer); }
+	[[nodiscard]] std::size_t getPosition() const { return m_buffer.size(); }
+
+	void reserve(std::size_t size) { m_buffer.reserve(size); }
+	void clear() { m_buffer.clear(); }
+
+	void align(std::size_t amt = cfg::MOD_ALIGNMENT_AMT)
+	{
+		if (amt == 0) {
+			return;
+		}
+
+		const std::size_t padding = (amt - (m_buffer.size() % amt)) % amt;
+		m_buffer.resize(m_buffer.size() + padding, 0);
+	}
+
+	// Overwrites a previously written big-endian u32, used to backpatch chunk lengths
+	void patchU32(std::size_t position, u32 val)
+	{
+		if (position + 4 > m_buffer.size()) {
+			throw std::out_of_range("vector_writer: patch position is past the end of the buffer");
+		}
+
+		m_buffer[position + 0] = static_cast<u8>(val >> 24);
+		m_buffer[position + 1] = static_cast<u8>(val >> 16);
+		m_buffer[position + 2] = static_cast<u8>(val >> 8);
+		m_buffer[position + 3] = static_cast<u8>(val);
+	}
+
+	void write_buffer(const void* buffer, std::size_t size)
+	{
+		if (size != 0) {
+			std::memcpy(grow(size), buffer, size);
+		}
+	}
+
+	// Bulk writes of `count` host-order words, swapped to big-endian in the output buffer
+	void write_array16(const void* buffer, std::size_t count)
+	{
+		if (count != 0) {
+			u8* dst = grow(count * 2);
+			std::memcpy(dst, buffer, count * 2);
+			swap_big_endian16(dst, count);
+		}
+	}
+	void write_array32(const void* buffer, std::size_t count)
+	{
+		if (count != 0) {
+			u8* dst = grow(count * 4);
+			std::memcpy(dst, buffer, count * 4);
+			swap_big_endian32(dst, count);
+		}
+	}
+
+	void writeU8(u8 val) { m_buffer.push_back(val); }
+	void writeU16(u16 val)
+	{
+		u8* p = grow(2);
+		p[0]  = static_cast<u8>(val >> 8);
+		p[1]  = static_cast<u8>(val);
+	}
+	void writeU32(u32 val)
+	{
+		u8* p = grow(4);
+		p[0]  = static_cast<u8>(val >> 24);
+		p[1]  = static_cast<u8>(val >> 16);
+		p[2]  = static_cast<u8>(val >> 8);
+		p[3]  = static_cast<u8>(val);
+	}
+
+	void writeS8(s8 val) { writeU8(static_cast<u8>(val)); }
+	void writeS16(s16 val) { writeU16(static_cast<u16>(val)); }
+	void writeS32(s32 val) { writeU32(static_cast<u32>(val)); }
+
+	void writeF32(f32 val)
+	{
+		u32 intVal = 0;
+		std::memcpy(&intVal, &val, sizeof(f32)); // Safe bit-exact copy
+		writeU32(intVal);
+	}
+
+private:
+	u8* grow(std::size_t size)
+	{
+		const std::size_t offset = m_buffer.size();
+		m_buffer.resize(offset + size);
+		return m_buffer.data() + offset;
+	}
+
+	std::vector<u8> m_buffer;
+};
+
+} // namespace util
+
+#endif